@@ -1,8 +1,27 @@
 #ifndef FIND_MIN_MAX_H
 #define FIND_MIN_MAX_H
 
+#include <stdbool.h>
+
 #include "utils.h"
 
+// Поиск минимума и максимума на [begin; end): лучшая реализация,
+// которую поддерживает процессор, выбирается при первом вызове
 struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end);
 
+// Реализации GetMinMax, для сравнения в бенчмарке
+enum MinMaxImpl {
+  MINMAX_BRANCHY,   // Два сравнения с переходом на элемент
+  MINMAX_SCALAR,    // Без переходов (cmov)
+  MINMAX_SSE41,     // pminsd/pmaxsd, 4 числа за раз
+  MINMAX_AVX2,      // vpminsd/vpmaxsd, 8 чисел за раз
+  MINMAX_AVX512,    // vpminsd/vpmaxsd, 16 чисел за раз
+  MINMAX_IMPL_COUNT
+};
+
+const char *MinMaxImplName(enum MinMaxImpl impl);
+bool MinMaxImplSupported(enum MinMaxImpl impl);
+struct MinMax GetMinMaxImpl(enum MinMaxImpl impl, int *array, unsigned int begin,
+                            unsigned int end);
+
 #endif
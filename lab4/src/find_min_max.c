@@ -1,14 +1,28 @@
 #include "find_min_max.h"
 #include <limits.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
 // Функция, которая ищет минимальный и максимальный элементы массива, на заданном промежутке ( по индексам [begin; end) )
+//
+// На случайных данных из GenerateArray переходы в простом цикле плохо
+// предсказываются, поэтому основной вариант - векторный: в каждой из
+// 4/8/16 дорожек регистра копится свой минимум и максимум, в конце дорожки
+// сводятся в одно число. Хвост короче вектора досчитывается без переходов.
 
-struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end) {
+static const char *impl_names[MINMAX_IMPL_COUNT] = {
+  "branchy", "scalar", "sse4.1", "avx2", "avx512"
+};
+
+// Исходный вариант: два сравнения с условным переходом на элемент
+static struct MinMax GetMinMaxBranchy(int *array, unsigned int begin, unsigned int end) {
   struct MinMax min_max;
   min_max.min = INT_MAX;
   min_max.max = INT_MIN;
 
-  // your code here
   for (unsigned int i = begin; i < end; i++) {
     if (array[i] < min_max.min) {
       min_max.min = array[i];
@@ -21,7 +35,169 @@ struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end) {
   return min_max;
 }
 
+// Без переходов: тернарный оператор компилируется в cmov
+static struct MinMax ScalarTail(int *array, unsigned int begin, unsigned int end,
+                                struct MinMax min_max) {
+  for (unsigned int i = begin; i < end; i++) {
+    int v = array[i];
+    min_max.min = v < min_max.min ? v : min_max.min;
+    min_max.max = v > min_max.max ? v : min_max.max;
+  }
+  return min_max;
+}
 
+static struct MinMax GetMinMaxScalar(int *array, unsigned int begin, unsigned int end) {
+  struct MinMax min_max = {INT_MAX, INT_MIN};
+  return ScalarTail(array, begin, end, min_max);
+}
 
+#ifdef HAVE_X86_SIMD
 
+__attribute__((target("sse4.1")))
+static struct MinMax GetMinMaxSse41(int *array, unsigned int begin, unsigned int end) {
+  __m128i vmin = _mm_set1_epi32(INT_MAX), vmax = _mm_set1_epi32(INT_MIN);
+  unsigned int i = begin;
+  for (; end - i >= 4; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(array + i));
+    vmin = _mm_min_epi32(vmin, v);
+    vmax = _mm_max_epi32(vmax, v);
+  }
+  // Сведение дорожек: попарно, сдвигая половины регистра
+  vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+  vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+  vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+  vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+  struct MinMax min_max = {_mm_cvtsi128_si32(vmin), _mm_cvtsi128_si32(vmax)};
+  return ScalarTail(array, i, end, min_max);
+}
+
+__attribute__((target("avx2")))
+static struct MinMax GetMinMaxAvx2(int *array, unsigned int begin, unsigned int end) {
+  // Два независимых накопителя: сравнения соседних итераций не ждут друг друга
+  __m256i vmin0 = _mm256_set1_epi32(INT_MAX), vmax0 = _mm256_set1_epi32(INT_MIN);
+  __m256i vmin1 = vmin0, vmax1 = vmax0;
+  unsigned int i = begin;
+  for (; end - i >= 16; i += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(array + i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(array + i + 8));
+    vmin0 = _mm256_min_epi32(vmin0, a);
+    vmax0 = _mm256_max_epi32(vmax0, a);
+    vmin1 = _mm256_min_epi32(vmin1, b);
+    vmax1 = _mm256_max_epi32(vmax1, b);
+  }
+  vmin0 = _mm256_min_epi32(vmin0, vmin1);
+  vmax0 = _mm256_max_epi32(vmax0, vmax1);
+  for (; end - i >= 8; i += 8) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(array + i));
+    vmin0 = _mm256_min_epi32(vmin0, a);
+    vmax0 = _mm256_max_epi32(vmax0, a);
+  }
+  __m128i vmin = _mm_min_epi32(_mm256_castsi256_si128(vmin0), _mm256_extracti128_si256(vmin0, 1));
+  __m128i vmax = _mm_max_epi32(_mm256_castsi256_si128(vmax0), _mm256_extracti128_si256(vmax0, 1));
+  vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+  vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+  vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+  vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+  struct MinMax min_max = {_mm_cvtsi128_si32(vmin), _mm_cvtsi128_si32(vmax)};
+  return ScalarTail(array, i, end, min_max);
+}
 
+__attribute__((target("avx512f")))
+static struct MinMax GetMinMaxAvx512(int *array, unsigned int begin, unsigned int end) {
+  __m512i vmin0 = _mm512_set1_epi32(INT_MAX), vmax0 = _mm512_set1_epi32(INT_MIN);
+  __m512i vmin1 = vmin0, vmax1 = vmax0;
+  unsigned int i = begin;
+  for (; end - i >= 32; i += 32) {
+    __m512i a = _mm512_loadu_si512((const void *)(array + i));
+    __m512i b = _mm512_loadu_si512((const void *)(array + i + 16));
+    vmin0 = _mm512_min_epi32(vmin0, a);
+    vmax0 = _mm512_max_epi32(vmax0, a);
+    vmin1 = _mm512_min_epi32(vmin1, b);
+    vmax1 = _mm512_max_epi32(vmax1, b);
+  }
+  vmin0 = _mm512_min_epi32(vmin0, vmin1);
+  vmax0 = _mm512_max_epi32(vmax0, vmax1);
+  for (; end - i >= 16; i += 16) {
+    __m512i a = _mm512_loadu_si512((const void *)(array + i));
+    vmin0 = _mm512_min_epi32(vmin0, a);
+    vmax0 = _mm512_max_epi32(vmax0, a);
+  }
+  // Хвост короче вектора читается по маске: незагруженные дорожки не меняются
+  if (end > i) {
+    __mmask16 mask = (__mmask16)((1u << (end - i)) - 1);
+    __m512i a = _mm512_maskz_loadu_epi32(mask, array + i);
+    vmin0 = _mm512_mask_min_epi32(vmin0, mask, vmin0, a);
+    vmax0 = _mm512_mask_max_epi32(vmax0, mask, vmax0, a);
+  }
+  struct MinMax min_max = {_mm512_reduce_min_epi32(vmin0), _mm512_reduce_max_epi32(vmax0)};
+  return min_max;
+}
+
+#endif
+
+const char *MinMaxImplName(enum MinMaxImpl impl) {
+  return impl < MINMAX_IMPL_COUNT ? impl_names[impl] : "?";
+}
+
+bool MinMaxImplSupported(enum MinMaxImpl impl) {
+  switch (impl) {
+  case MINMAX_BRANCHY:
+  case MINMAX_SCALAR:
+    return true;
+#ifdef HAVE_X86_SIMD
+  case MINMAX_SSE41:
+    return __builtin_cpu_supports("sse4.1");
+  case MINMAX_AVX2:
+    return __builtin_cpu_supports("avx2");
+  case MINMAX_AVX512:
+    return __builtin_cpu_supports("avx512f");
+#endif
+  default:
+    return false;
+  }
+}
+
+struct MinMax GetMinMaxImpl(enum MinMaxImpl impl, int *array, unsigned int begin,
+                            unsigned int end) {
+  // Векторные циклы считают остаток как end - i: пустой промежуток - пустой
+  if (end < begin)
+    end = begin;
+  switch (impl) {
+#ifdef HAVE_X86_SIMD
+  case MINMAX_SSE41:
+    return GetMinMaxSse41(array, begin, end);
+  case MINMAX_AVX2:
+    return GetMinMaxAvx2(array, begin, end);
+  case MINMAX_AVX512:
+    return GetMinMaxAvx512(array, begin, end);
+#endif
+  case MINMAX_BRANCHY:
+    return GetMinMaxBranchy(array, begin, end);
+  default:
+    return GetMinMaxScalar(array, begin, end);
+  }
+}
+
+// Реализация, выбранная при первом вызове; гонка потоков безвредна -
+// все они запишут одно и то же
+static struct MinMax (*min_max_impl)(int *, unsigned int, unsigned int) = NULL;
+
+struct MinMax GetMinMax(int *array, unsigned int begin, unsigned int end) {
+  struct MinMax (*impl)(int *, unsigned int, unsigned int) =
+      __atomic_load_n(&min_max_impl, __ATOMIC_RELAXED);
+  if (impl == NULL) {
+    impl = GetMinMaxScalar;
+#ifdef HAVE_X86_SIMD
+    if (MinMaxImplSupported(MINMAX_AVX512))
+      impl = GetMinMaxAvx512;
+    else if (MinMaxImplSupported(MINMAX_AVX2))
+      impl = GetMinMaxAvx2;
+    else if (MinMaxImplSupported(MINMAX_SSE41))
+      impl = GetMinMaxSse41;
+#endif
+    __atomic_store_n(&min_max_impl, impl, __ATOMIC_RELAXED);
+  }
+  if (end < begin)
+    end = begin;
+  return impl(array, begin, end);
+}
@@ -0,0 +1,104 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "find_min_max.h"
+#include "utils.h"
+
+// Бенчмарк реализаций GetMinMax на массивах от размера кэша L1
+// до нескольких гигабайт: пока массив в кэше, видна скорость вычислений,
+// дальше - пропускная способность памяти
+
+// Минимальное время замера одного размера одной реализацией
+#define BENCH_MIN_SEC 0.2
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+int main(int argc, char **argv) {
+  uint64_t max_mb = 1024;
+  uint32_t seed = 1;
+  enum Distribution dist = DIST_UNIFORM;
+
+  // Анализ аргументов командной строки
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--max_mb") == 0 && i + 1 < argc) {
+      max_mb = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc &&
+               ParseDistribution(argv[i + 1], &dist)) {
+      i++;
+    } else {
+      printf("Usage: %s [--max_mb N] [--seed N] [--dist uniform|full|normal|ascending]\n",
+             argv[0]);
+      return 1;
+    }
+  }
+  uint64_t max_size = max_mb * 1024 * 1024 / sizeof(int);
+  if (max_size == 0 || max_size > UINT_MAX) {
+    printf("max_mb must be from 1 to %u\n", (unsigned)(UINT_MAX / (1024 * 1024 / sizeof(int))));
+    return 1;
+  }
+
+  // Один массив на все замеры: меньшие размеры - его начало
+  int *array = malloc(max_size * sizeof(int));
+  if (array == NULL) {
+    printf("Memory allocation failed\n");
+    return 1;
+  }
+  GenerateArrayParallel(array, (unsigned int)max_size, seed, dist,
+                        (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+  printf("%12s %10s %10s %10s\n", "size", "impl", "GB/s", "ns/elem");
+  for (uint64_t size = 1024;; size *= 8) {
+    if (size > max_size)
+      size = max_size;
+    struct MinMax expected = GetMinMaxImpl(MINMAX_BRANCHY, array, 0, (unsigned int)size);
+    for (int impl = 0; impl < MINMAX_IMPL_COUNT; impl++) {
+      if (!MinMaxImplSupported(impl))
+        continue;
+
+      // Время меряется пачкой вызовов, пачка удваивается, пока не наберется
+      // BENCH_MIN_SEC: на размере L1 вызов идет десятки наносекунд, и часы
+      // на каждом повторе исказили бы замер. Первый проход прогревает кэш
+      struct MinMax result = GetMinMaxImpl(impl, array, 0, (unsigned int)size);
+      unsigned int diff = 0;  // Отличия от ожидаемого: результат используется и проверяется
+      long reps = 1;
+      double elapsed;
+      while (1) {
+        double start = NowSec();
+        for (long k = 0; k < reps; k++) {
+          struct MinMax r = GetMinMaxImpl(impl, array, 0, (unsigned int)size);
+          diff |= (unsigned int)(r.min ^ expected.min) | (unsigned int)(r.max ^ expected.max);
+        }
+        elapsed = NowSec() - start;
+        if (elapsed >= BENCH_MIN_SEC)
+          break;
+        reps *= 2;
+      }
+
+      if (diff != 0 || result.min != expected.min || result.max != expected.max) {
+        printf("%s: wrong result %d %d, expected %d %d\n", MinMaxImplName(impl),
+               result.min, result.max, expected.min, expected.max);
+        free(array);
+        return 1;
+      }
+      double per_call = elapsed / reps;
+      printf("%10lluKB %10s %10.2f %10.3f\n", (unsigned long long)(size * sizeof(int) / 1024),
+             MinMaxImplName(impl), size * sizeof(int) / per_call / 1e9, per_call * 1e9 / size);
+    }
+    if (size == max_size)
+      break;
+  }
+
+  free(array);
+  return 0;
+}
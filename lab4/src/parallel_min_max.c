@@ -1,22 +1,247 @@
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <string.h>
 #include <signal.h>
 
+#include <linux/futex.h>
+#include <pthread.h>
+
 #include "find_min_max.h"
 #include "utils.h"
 
-// Глобальная переменная для хранения PID дочернего процесса
-pid_t child_pid = 0;
+// Размер строки кэша: границы частей массива и ячейки результатов
+// выравниваются по ней, чтобы исполнители не делили строки
+#define CACHE_LINE 64
+
+// Пауза между проверками, жив ли дочерний процесс, который еще не отчитался
+#define CHILD_POLL_MS 100
+
+// PID дочерних процессов; 0 - процесс уже завершен
+pid_t *worker_pids = NULL;
+int worker_pids_num = 0;
 
 // Обработчик сигнала SIGALRM
 void timeout_handler(int sig) {
-    if (child_pid > 0) {
-        printf("Timeout reached! Killing child process %d\n", child_pid);
-        kill(child_pid, SIGKILL);
+    for (int i = 0; i < worker_pids_num; i++) {
+        if (worker_pids[i] > 0) {
+            printf("Timeout reached! Killing child process %d\n", worker_pids[i]);
+            kill(worker_pids[i], SIGKILL);
+        }
+    }
+}
+
+// Ячейка результата исполнителя: каждая занимает свои строки кэша,
+// так что запись результата одним не сбрасывает кэш соседей.
+// В режиме процессов ячейки лежат в общей памяти (mmap MAP_SHARED):
+// процесс пишет результат и поднимает флаг done, родитель ждет флаг на futex
+struct WorkerSlot {
+    struct MinMax min_max;
+    unsigned int done;
+    int *array;
+    unsigned int begin;
+    unsigned int end;
+    int id;
+    int pnum;
+    struct WorkerSlot *slots;
+    pthread_t thread;
+} __attribute__((aligned(CACHE_LINE)));
+
+// Нейтральный результат: пустая часть или упавший исполнитель
+static struct MinMax EmptyMinMax(void) {
+    struct MinMax min_max = {INT_MAX, INT_MIN};
+    return min_max;
+}
+
+static void MergeMinMax(struct MinMax *to, struct MinMax from) {
+    to->min = from.min < to->min ? from.min : to->min;
+    to->max = from.max > to->max ? from.max : to->max;
+}
+
+// futex без FUTEX_PRIVATE_FLAG: флаг общий для разных процессов
+static void FutexWake(unsigned int *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void FutexWait(unsigned int *addr, unsigned int value, int timeout_ms) {
+    struct timespec ts = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, &ts, NULL, 0);
+}
+
+// Результат дочернего процесса: ждем флаг done, а если процесс завершился,
+// так и не подняв его (убит по таймауту или упал), - нейтральный результат.
+// Забранный процесс сразу вычеркивается из pid, чтобы обработчик таймаута
+// не послал сигнал уже чужому процессу с тем же номером
+static int WaitChild(struct WorkerSlot *slot, pid_t *pid) {
+    while (!__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE)) {
+        FutexWait(&slot->done, 0, CHILD_POLL_MS);
+        int status;
+        if (!__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE) &&
+            waitpid(*pid, &status, WNOHANG) == *pid) {
+            __atomic_store_n(pid, 0, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Поток-исполнитель: своя часть массива, затем объединение деревом.
+// Поток i на шаге s ждет поток i + s (если i кратно 2s) и забирает его
+// результат; поток j ждет ровно один поток j - lowbit(j), так что все
+// потоки, кроме нулевого, присоединяются своими соседями за log2(N) шагов
+static void *ThreadWorker(void *arg) {
+    struct WorkerSlot *slot = arg;
+    slot->min_max = GetMinMax(slot->array, slot->begin, slot->end);
+    for (int step = 1; slot->id % (2 * step) == 0 && slot->id + step < slot->pnum; step *= 2) {
+        struct WorkerSlot *other = &slot->slots[slot->id + step];
+        pthread_join(other->thread, NULL);
+        MergeMinMax(&slot->min_max, other->min_max);
+    }
+    return NULL;
+}
+
+// Объединение деревом в родителе (процессы не могут ждать друг друга):
+// на шаге s ячейка i забирает ячейку i + s
+static struct MinMax TreeCombine(struct WorkerSlot *slots, int pnum) {
+    for (int step = 1; step < pnum; step *= 2) {
+        for (int i = 0; i + step < pnum; i += 2 * step)
+            MergeMinMax(&slots[i].min_max, slots[i + step].min_max);
+    }
+    return slots[0].min_max;
+}
+
+// Режим --pnum N: массив делится на N частей с границами по строкам кэша,
+// каждую считает поток (по умолчанию) или дочерний процесс (--processes)
+static int RunWorkers(int *array, unsigned int array_size, int pnum, int use_processes,
+                      int use_files, struct MinMax *result) {
+    // Для процессов ячейки в общей анонимной памяти: mmap выравнивает по странице
+    size_t slots_bytes = pnum * sizeof(struct WorkerSlot);
+    struct WorkerSlot *slots;
+    if (use_processes) {
+        slots = mmap(NULL, slots_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (slots == MAP_FAILED)
+            slots = NULL;
+    } else {
+        slots = aligned_alloc(CACHE_LINE, slots_bytes);
+    }
+    if (slots == NULL) {
+        printf("Memory allocation failed\n");
+        return 1;
+    }
+    const unsigned int per_line = CACHE_LINE / sizeof(int);
+    unsigned long long chunk = ((unsigned long long)array_size + pnum - 1) / pnum;
+    chunk = (chunk + per_line - 1) / per_line * per_line;
+    for (int i = 0; i < pnum; i++) {
+        unsigned long long begin = i * chunk, end = begin + chunk;
+        slots[i].min_max = EmptyMinMax();
+        slots[i].done = 0;
+        slots[i].array = array;
+        slots[i].begin = begin < array_size ? (unsigned int)begin : array_size;
+        slots[i].end = end < array_size ? (unsigned int)end : array_size;
+        slots[i].id = i;
+        slots[i].pnum = pnum;
+        slots[i].slots = slots;
+    }
+
+    if (!use_processes) {
+        // С конца: поток i присоединяет только потоки с большими номерами,
+        // их идентификаторы к его запуску уже записаны
+        for (int i = pnum - 1; i >= 0; i--) {
+            if (pthread_create(&slots[i].thread, NULL, ThreadWorker, &slots[i]) != 0) {
+                perror("pthread_create");
+                exit(1);
+            }
+        }
+        // Поток 0 присоединяет остальные, главный поток ждет только его
+        pthread_join(slots[0].thread, NULL);
+        *result = slots[0].min_max;
+        free(slots);
+        return 0;
+    }
+
+    // Процессы: результат пишется прямо в ячейку общей памяти, с --by_files -
+    // в файл child_result_<i>.txt, а в ячейке только флаг готовности
+    worker_pids = calloc(pnum, sizeof(pid_t));
+    if (worker_pids == NULL) {
+        printf("Memory allocation failed\n");
+        return 1;
+    }
+    fflush(stdout);  // Иначе буфер stdout выведут и дочерние процессы
+    for (int i = 0; i < pnum; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork failed");
+            exit(1);
+        }
+        if (pid == 0) {
+            // ДОЧЕРНИЙ ПРОЦЕСС - обрабатывает свою часть массива
+            struct MinMax min_max = GetMinMax(array, slots[i].begin, slots[i].end);
+            if (use_files) {
+                char name[64];
+                snprintf(name, sizeof(name), "child_result_%d.txt", i);
+                FILE *file = fopen(name, "w");
+                if (file == NULL)
+                    exit(1);
+                fprintf(file, "%d %d", min_max.min, min_max.max);
+                fclose(file);
+            } else {
+                slots[i].min_max = min_max;
+            }
+            __atomic_store_n(&slots[i].done, 1, __ATOMIC_RELEASE);
+            FutexWake(&slots[i].done);
+            exit(0);
+        }
+        worker_pids[i] = pid;
+        worker_pids_num = i + 1;
+    }
+
+    // РОДИТЕЛЬСКИЙ ПРОЦЕСС - собирает результаты; упавший или убитый по
+    // таймауту процесс дает нейтральный результат
+    for (int i = 0; i < pnum; i++) {
+        int ok = WaitChild(&slots[i], &worker_pids[i]);
+        if (ok && use_files) {
+            char name[64];
+            snprintf(name, sizeof(name), "child_result_%d.txt", i);
+            FILE *file = fopen(name, "r");
+            ok = file != NULL &&
+                 fscanf(file, "%d %d", &slots[i].min_max.min, &slots[i].min_max.max) == 2;
+            if (file != NULL)
+                fclose(file);
+            remove(name);
+        }
+        if (!ok) {
+            printf("Child process %d terminated abnormally\n", i);
+            slots[i].min_max = EmptyMinMax();
+        }
     }
+    // Завершенные процессы забираются после подсчета, чтобы не ждать
+    // каждого по очереди до выхода
+    for (int i = 0; i < pnum; i++) {
+        if (worker_pids[i] == 0)
+            continue;
+        while (waitpid(worker_pids[i], NULL, 0) < 0 && errno == EINTR) {
+        }
+        worker_pids[i] = 0;
+    }
+    worker_pids_num = 0;
+    free(worker_pids);
+    worker_pids = NULL;
+    *result = TreeCombine(slots, pnum);
+    munmap(slots, slots_bytes);
+    return 0;
+}
+
+static void PrintUsage(const char *name) {
+    printf("Usage: %s seed arraysize [--dist NAME] [--by_files] [--timeout N] "
+           "[--pnum N [--processes]]\n", name);
+    printf("       %s --input FILE [--populate] [--by_files] [--timeout N] "
+           "[--pnum N [--processes]]\n", name);
 }
 
 int main(int argc, char **argv) {
@@ -24,145 +249,133 @@ int main(int argc, char **argv) {
     int seed = 0;
     int array_size = 0;
     int use_files = 0;
-    
-    // Анализ аргументов командной строки
-    if (argc < 3) {
-        printf("Usage: %s seed arraysize [--by_files] [--timeout N]\n", argv[0]);
-        return 1;
-    }
+    int pnum = 0;          // 0 - две половины в двух процессах, как раньше
+    int use_processes = 0;
+    const char *input = NULL;  // Файл с массивом вместо GenerateArray
+    enum Distribution dist = DIST_UNIFORM;
+    int populate = 0;
+    int positional = 0;
 
-    // Первые два аргумента - seed и arraysize (позиционные)
-    seed = atoi(argv[1]);
-    array_size = atoi(argv[2]);
-
-    // Обработка остальных аргументов (опциональные флаги)
-    for (int i = 3; i < argc; i++) {
+    // Анализ аргументов командной строки: seed и arraysize (позиционные)
+    // или --input FILE, остальное - необязательные флаги
+    for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--by_files") == 0) {
             use_files = 1;
         } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
             timeout = atoi(argv[i + 1]);
             i++; // Пропускаем следующий аргумент (значение таймаута)
+        } else if (strcmp(argv[i], "--pnum") == 0 && i + 1 < argc) {
+            pnum = atoi(argv[i + 1]);
+            i++;
+            if (pnum <= 0) {
+                printf("pnum is a positive number\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--processes") == 0) {
+            use_processes = 1;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--populate") == 0) {
+            populate = 1;
+        } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc) {
+            if (!ParseDistribution(argv[i + 1], &dist)) {
+                printf("Distribution must be uniform, full, normal or ascending\n");
+                return 1;
+            }
+            i++;
+        } else if (strncmp(argv[i], "--", 2) != 0 && positional < 2) {
+            if (positional++ == 0)
+                seed = atoi(argv[i]);
+            else
+                array_size = atoi(argv[i]);
         } else {
             printf("Unknown parameter: %s\n", argv[i]);
-            printf("Usage: %s seed arraysize [--by_files] [--timeout N]\n", argv[0]);
+            PrintUsage(argv[0]);
             return 1;
         }
     }
+    if ((input == NULL && positional != 2) || (input != NULL && positional != 0)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
 
     // Проверка валидности seed
-    if (seed <= 0) {
+    if (input == NULL && seed <= 0) {
         printf("seed is a positive number\n");
         return 1;
     }
 
     // Проверка валидности размера массива
-    if (array_size <= 0) {
+    if (input == NULL && array_size <= 0) {
         printf("array_size is a positive number\n");
         return 1;
     }
 
+    if (use_processes && pnum == 0) {
+        printf("--processes needs --pnum N\n");
+        return 1;
+    }
+    if (use_files && !use_processes && pnum > 0) {
+        printf("--by_files needs --processes\n");
+        return 1;
+    }
+    // Таймаут убивает дочерние процессы, потоки им не прервать
+    if (timeout > 0 && !use_processes && pnum > 0) {
+        printf("--timeout needs --processes\n");
+        return 1;
+    }
+
     // Устанавливаем обработчик сигнала SIGALRM, если таймаут задан
     if (timeout > 0) {
         signal(SIGALRM, timeout_handler);
         alarm(timeout); // Устанавливаем будильник
         printf("Timeout set to %d seconds\n", timeout);
     }
-
-    // Выделение памяти и генерация массива
-    int *array = malloc(array_size * sizeof(int));
-    if (array == NULL) {
-        printf("Memory allocation failed\n");
-        return 1;
+    // Без --pnum массив, как и раньше, делится на две половины между процессами
+    if (pnum == 0) {
+        pnum = 2;
+        use_processes = 1;
     }
-    GenerateArray(array, array_size, seed);
-
-    // Разделяем массив на две части
-    unsigned int mid = array_size / 2;
-    
-    // Создаем дочерний процесс
-    pid_t pid = fork();
-    child_pid = pid; // Сохраняем PID дочернего процесса
-    
-    if (pid == 0) {
-        // ДОЧЕРНИЙ ПРОЦЕСС - обрабатывает первую половину массива
-        struct MinMax min_max = GetMinMax(array, 0, mid);
-        
-        if (use_files) {
-            // Режим файлов: записываем результаты в файл
-            FILE *file = fopen("child_result.txt", "w");
-            if (file != NULL) {
-                fprintf(file, "%d %d", min_max.min, min_max.max);
-                fclose(file);
-            }
-        } else {
-            // Режим pipe: передаем результаты через канал
-            int fd[2];
-            if (pipe(fd) == 0) {
-                write(fd[1], &min_max.min, sizeof(int));
-                write(fd[1], &min_max.max, sizeof(int));
-                close(fd[1]);
-            }
-        }
-        
-        free(array);
-        exit(0);
-    } else if (pid > 0) {
-        // РОДИТЕЛЬСКИЙ ПРОЦЕСС - обрабатывает вторую половину массива
-        struct MinMax parent_min_max = GetMinMax(array, mid, array_size);
-        struct MinMax child_min_max;
-        int status;
-        
-        if (use_files) {
-            // Режим файлов: ждем завершения дочернего процесса
-            waitpid(pid, &status, 0);
-            
-            if (WIFEXITED(status)) {
-                // Дочерний процесс завершился нормально
-                FILE *file = fopen("child_result.txt", "r");
-                if (file != NULL) {
-                    fscanf(file, "%d %d", &child_min_max.min, &child_min_max.max);
-                    fclose(file);
-                    remove("child_result.txt"); // Удаляем временный файл
-                }
-            } else {
-                // Дочерний процесс был завершен по таймауту
-                printf("Child process terminated by timeout\n");
-                child_min_max = parent_min_max; // Используем только результаты родителя
-            }
-        } else {
-            // Режим pipe: создаем pipe и читаем результаты
-            int fd[2];
-            if (pipe(fd) == 0) {
-                waitpid(pid, &status, 0);
-                
-                if (WIFEXITED(status)) {
-                    read(fd[0], &child_min_max.min, sizeof(int));
-                    read(fd[0], &child_min_max.max, sizeof(int));
-                } else {
-                    printf("Child process terminated abnormally\n");
-                    child_min_max = parent_min_max;
-                }
-                close(fd[0]);
-            }
+
+    // Массив из файла: отображение начинается с границы страницы, части
+    // исполнителям отдаются прямо из него, процессы делят его страницы
+    int *array;
+    unsigned long long mapped_size = 0;
+    if (input != NULL) {
+        array = MapArrayFile(input, populate, &mapped_size);
+        if (array == NULL)
+            return 1;
+        if (mapped_size > UINT_MAX) {
+            printf("%s: more than %u numbers\n", input, UINT_MAX);
+            UnmapArray(array, mapped_size);
+            return 1;
         }
-        
-        // Объединяем результаты
-        struct MinMax final_min_max;
-        final_min_max.min = (parent_min_max.min < child_min_max.min) ? 
-                           parent_min_max.min : child_min_max.min;
-        final_min_max.max = (parent_min_max.max > child_min_max.max) ? 
-                           parent_min_max.max : child_min_max.max;
-        
-        // Выводим результаты
-        printf("min: %d\n", final_min_max.min);
-        printf("max: %d\n", final_min_max.max);
-        
-        free(array);
-        return 0;
     } else {
-        // ОШИБКА при создании процесса
-        perror("fork failed");
+        // Выделение памяти и генерация массива; начало по строке кэша,
+        // чтобы части исполнителей --pnum не делили строки
+        size_t array_bytes = ((size_t)array_size * sizeof(int) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+        array = aligned_alloc(CACHE_LINE, array_bytes);
+        if (array == NULL) {
+            printf("Memory allocation failed\n");
+            return 1;
+        }
+        // Генерация pnum потоками; массив от их числа не зависит
+        GenerateArrayParallel(array, array_size, seed, dist, pnum);
+    }
+    unsigned int size = input != NULL ? (unsigned int)mapped_size : (unsigned int)array_size;
+
+    struct MinMax min_max;
+    int err = RunWorkers(array, size, pnum, use_processes, use_files, &min_max);
+    if (input != NULL)
+        UnmapArray(array, mapped_size);
+    else
         free(array);
+    if (err != 0)
         return 1;
-    }
-}
\ No newline at end of file
+
+    // Выводим результаты
+    printf("min: %d\n", min_max.min);
+    printf("max: %d\n", min_max.max);
+    return 0;
+}
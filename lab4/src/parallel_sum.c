@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,6 +14,9 @@ int main(int argc, char **argv) {
   uint32_t threads_num = 0;
   uint32_t array_size = 0;
   uint32_t seed = 0;
+  const char *input = NULL;  // Файл с массивом вместо GenerateArray
+  enum Distribution dist = DIST_UNIFORM;
+  int populate = 0;
   
   // Анализ аргументов командной строки
   for (int i = 1; i < argc; i++) {
@@ -22,19 +26,56 @@ int main(int argc, char **argv) {
       seed = atoi(argv[++i]);
     } else if (strcmp(argv[i], "--array_size") == 0 && i + 1 < argc) {
       array_size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+      input = argv[++i];
+    } else if (strcmp(argv[i], "--populate") == 0) {
+      populate = 1;
+    } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc) {
+      if (!ParseDistribution(argv[++i], &dist)) {
+        printf("Distribution must be uniform, full, normal or ascending\n");
+        return 1;
+      }
     }
   }
   
   // Проверка корректности аргументов
-  if (threads_num <= 0 || array_size <= 0 || seed <= 0) {
-    printf("Usage: %s --threads_num <num> --seed <num> --array_size <num>\n", argv[0]);
+  if (threads_num <= 0 || (input == NULL && (array_size <= 0 || seed <= 0))) {
+    printf("Usage: %s --threads_num <num> --seed <num> --array_size <num> [--dist NAME]\n",
+           argv[0]);
+    printf("       %s --threads_num <num> --input FILE [--populate]\n", argv[0]);
     printf("All parameters must be positive numbers\n");
     return 1;
   }
   
-  // Выделение памяти и генерация массива (не входит в замер времени)
-  int *array = malloc(sizeof(int) * array_size);
-  GenerateArray(array, array_size, seed);
+  // Выделение памяти и генерация массива или отображение файла
+  // (не входит в замер времени); потоки читают свои части прямо из файла
+  int *array;
+  unsigned long long mapped_size = 0;
+  if (input != NULL) {
+    array = MapArrayFile(input, populate, &mapped_size);
+    if (array == NULL)
+      return 1;
+    // ParallelSum считает индексы в int
+    if (mapped_size > INT_MAX) {
+      printf("%s: more than %d numbers\n", input, INT_MAX);
+      UnmapArray(array, mapped_size);
+      return 1;
+    }
+    array_size = (uint32_t)mapped_size;
+  } else {
+    // Генерация теми же threads_num потоками; массив от их числа не зависит
+    array = malloc(sizeof(int) * array_size);
+    if (array == NULL) {
+      printf("Memory allocation failed\n");
+      return 1;
+    }
+    struct timespec gen_start, gen_end;
+    clock_gettime(CLOCK_MONOTONIC, &gen_start);
+    GenerateArrayParallel(array, array_size, seed, dist, threads_num);
+    clock_gettime(CLOCK_MONOTONIC, &gen_end);
+    printf("Generated in %.6f seconds\n", (gen_end.tv_sec - gen_start.tv_sec) +
+           (gen_end.tv_nsec - gen_start.tv_nsec) / 1000000000.0);
+  }
   
   // Замер времени выполнения только суммирования
   struct timespec start, end;
@@ -53,10 +94,16 @@ int main(int argc, char **argv) {
   printf("=== Parallel Sum Results ===\n");
   printf("Threads number: %u\n", threads_num);
   printf("Array size: %u\n", array_size);
-  printf("Seed: %u\n", seed);
+  if (input != NULL)
+    printf("Input: %s\n", input);
+  else
+    printf("Seed: %u\n", seed);
   printf("Total sum: %lld\n", total_sum);
   printf("Time taken: %.6f seconds\n", time_taken);
   
-  free(array);
+  if (input != NULL)
+    UnmapArray(array, mapped_size);
+  else
+    free(array);
   return 0;
 }
\ No newline at end of file
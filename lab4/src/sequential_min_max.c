@@ -1,14 +1,44 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "find_min_max.h"
 #include "utils.h"
 
 int main(int argc, char **argv) {
+  // Массив из файла: --input FILE [--populate] вместо seed и размера
+  if (argc >= 3 && strcmp(argv[1], "--input") == 0) {
+    int populate = argc == 4 && strcmp(argv[3], "--populate") == 0;
+    if (argc > 4 || (argc == 4 && !populate)) {
+      printf("Usage: %s --input FILE [--populate]\n", argv[0]);
+      return 1;
+    }
+    unsigned long long array_size;
+    int *array = MapArrayFile(argv[2], populate, &array_size);
+    if (array == NULL)
+      return 1;
+    if (array_size > UINT_MAX) {
+      printf("%s: more than %u numbers\n", argv[2], UINT_MAX);
+      UnmapArray(array, array_size);
+      return 1;
+    }
+    struct MinMax min_max = GetMinMax(array, 0, (unsigned int)array_size);
+    UnmapArray(array, array_size);
+
+    printf("min: %d\n", min_max.min);
+    printf("max: %d\n", min_max.max);
+    return 0;
+  }
+
   // Проверяем, что количество аргументов равно 3: имя программы, seed и размер массива
   // argc содержит количество переданных аргументов командной строки
+  enum Distribution dist = DIST_UNIFORM;
+  if (argc == 5 && strcmp(argv[3], "--dist") == 0 && ParseDistribution(argv[4], &dist))
+    argc = 3;
   if (argc != 3) {
-    printf("Usage: %s seed arraysize\n", argv[0]);
+    printf("Usage: %s seed arraysize [--dist uniform|full|normal|ascending]\n", argv[0]);
+    printf("       %s --input FILE [--populate]\n", argv[0]);
     return 1;
   }
 
@@ -27,8 +57,8 @@ int main(int argc, char **argv) {
   // Выделяем динамическую память под массив целых чисел заданного размера
   int *array = malloc(array_size * sizeof(int));
   
-  // GenerateArray (utils.h) заполняет массив псевдослучайными числами
-  GenerateArray(array, array_size, seed);
+  // GenerateArrayRange (utils.h) заполняет массив псевдослучайными числами
+  GenerateArrayRange(array, array_size, 0, array_size, seed, dist);
 
   // GetMinMax проходит по массиву от индекса 0 до array_size и находит min/max
   struct MinMax min_max = GetMinMax(array, 0, array_size);
@@ -2,8 +2,9 @@
 #include <pthread.h>
 
 // Функция для вычисления суммы элементов массива в заданном диапазоне
-int Sum(const struct SumArgs *args) {
-  int sum = 0;
+// Сумма копится в long long: сумма int32 переполняет int уже на паре элементов
+long long Sum(const struct SumArgs *args) {
+  long long sum = 0;
   for (int i = args->begin; i < args->end; i++) {
     sum += args->array[i];
   }
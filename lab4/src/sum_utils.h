@@ -11,7 +11,7 @@ struct SumArgs {
 };
 
 // Функция для вычисления суммы части массива
-int Sum(const struct SumArgs *args);
+long long Sum(const struct SumArgs *args);
 
 // Функция для параллельного суммирования
 long long ParallelSum(int *array, int array_size, int threads_num);
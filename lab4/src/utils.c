@@ -1,10 +1,158 @@
 #include "utils.h"
 
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *dist_names[DIST_COUNT] = {"uniform", "full", "normal", "ascending"};
+
+int ParseDistribution(const char *name, enum Distribution *dist) {
+  for (int i = 0; i < DIST_COUNT; i++) {
+    if (strcmp(name, dist_names[i]) == 0) {
+      *dist = (enum Distribution)i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// splitmix64: перемешивание 64-битного счетчика (Steele, Lea, Flood, 2014)
+static uint64_t SplitMix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// Шаг счетчика splitmix64 - дробная часть золотого сечения
+#define GOLDEN_GAMMA 0x9e3779b97f4a7c15ull
+
+static int GenerateValue(uint64_t key, unsigned int i, unsigned int array_size,
+                         enum Distribution dist) {
+  uint64_t r = SplitMix64(key + (i + 1ull) * GOLDEN_GAMMA);
+  switch (dist) {
+  case DIST_FULL:
+    return (int)(uint32_t)r;
+  case DIST_NORMAL: {
+    // Сумма 4 равномерных по 16 бит: среднее 2 * 65535, отклонение ~37837;
+    // масштаб дает отклонение около INT_MAX / 8 без выхода за int
+    int64_t sum = (int64_t)(r & 0xffff) + ((r >> 16) & 0xffff) + ((r >> 32) & 0xffff) + (r >> 48);
+    return (int)((sum - 2 * 65535) * 7094);
+  }
+  case DIST_ASCENDING:
+    return (int)(INT_MIN + (int64_t)((double)i / array_size * ((double)INT_MAX - INT_MIN)));
+  default:
+    return (int)(r % ((uint64_t)RAND_MAX + 1));
+  }
+}
+
+void GenerateArrayRange(int *array, unsigned int array_size, unsigned int begin,
+                        unsigned int end, unsigned int seed, enum Distribution dist) {
+  uint64_t key = SplitMix64(seed);
+  for (unsigned int i = begin; i < end; i++) {
+    array[i] = GenerateValue(key, i, array_size, dist);
+  }
+}
+
 void GenerateArray(int *array, unsigned int array_size, unsigned int seed) {
-  srand(seed);
-  for (int i = 0; i < array_size; i++) {
-    array[i] = rand();
+  GenerateArrayRange(array, array_size, 0, array_size, seed, DIST_UNIFORM);
+}
+
+// Аргументы потока генерации
+struct GenerateArgs {
+  int *array;
+  unsigned int array_size;
+  unsigned int begin;
+  unsigned int end;
+  unsigned int seed;
+  enum Distribution dist;
+};
+
+static void *GenerateThread(void *arg) {
+  struct GenerateArgs *args = arg;
+  GenerateArrayRange(args->array, args->array_size, args->begin, args->end, args->seed,
+                     args->dist);
+  return NULL;
+}
+
+void GenerateArrayParallel(int *array, unsigned int array_size, unsigned int seed,
+                           enum Distribution dist, int threads) {
+  if (threads < 1)
+    threads = 1;
+  pthread_t *ids = malloc(threads * sizeof(pthread_t));
+  struct GenerateArgs *args = malloc(threads * sizeof(struct GenerateArgs));
+  if (ids == NULL || args == NULL) {
+    free(ids);
+    free(args);
+    GenerateArrayRange(array, array_size, 0, array_size, seed, dist);
+    return;
+  }
+  unsigned long long chunk = ((unsigned long long)array_size + threads - 1) / threads;
+  for (int i = 0; i < threads; i++) {
+    unsigned long long begin = i * chunk, end = begin + chunk;
+    args[i].array = array;
+    args[i].array_size = array_size;
+    args[i].begin = begin < array_size ? (unsigned int)begin : array_size;
+    args[i].end = end < array_size ? (unsigned int)end : array_size;
+    args[i].seed = seed;
+    args[i].dist = dist;
+    // Поток не создался - его часть заполняется здесь же
+    if (pthread_create(&ids[i], NULL, GenerateThread, &args[i]) != 0) {
+      GenerateThread(&args[i]);
+      args[i].array = NULL;
+    }
+  }
+  for (int i = 0; i < threads; i++) {
+    if (args[i].array != NULL)
+      pthread_join(ids[i], NULL);
+  }
+  free(ids);
+  free(args);
+}
+
+int *MapArrayFile(const char *path, int populate, unsigned long long *array_size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size == 0 || st.st_size % sizeof(int) != 0) {
+    printf("%s: size %lld is not a positive multiple of %d bytes\n", path,
+           (long long)st.st_size, (int)sizeof(int));
+    close(fd);
+    return NULL;
+  }
+
+  int flags = MAP_PRIVATE | (populate ? MAP_POPULATE : 0);
+  int *array = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+  close(fd);  // Отображение держит файл само
+  if (array == MAP_FAILED) {
+    perror("mmap");
+    return NULL;
   }
+  // Подсказки ядру: читать с опережением и, где файловая система умеет,
+  // большими страницами; ошибки подсказок не мешают работе
+  madvise(array, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise(array, st.st_size, MADV_HUGEPAGE);
+#endif
+
+  *array_size = st.st_size / sizeof(int);
+  return array;
+}
+
+void UnmapArray(int *array, unsigned long long array_size) {
+  munmap(array, array_size * sizeof(int));
 }
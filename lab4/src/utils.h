@@ -6,6 +6,33 @@ struct MinMax {
   int max;
 };
 
+// Распределение значений генерируемого массива
+enum Distribution {
+  DIST_UNIFORM,    // Равномерно на [0; RAND_MAX], как rand()
+  DIST_FULL,       // Равномерно на всем диапазоне int
+  DIST_NORMAL,     // Около нуля, приближенно нормальное (сумма 4 равномерных)
+  DIST_ASCENDING,  // По возрастанию от INT_MIN до INT_MAX, без случайности
+  DIST_COUNT
+};
+
+// Имя распределения (uniform, full, normal, ascending) -> значение; 0 - неизвестное
+int ParseDistribution(const char *name, enum Distribution *dist);
+
+// Генератор со счетчиком: элемент i зависит только от seed и i (splitmix64
+// от seed + i), поэтому любую часть массива можно заполнить независимо
+// от остальных, и результат не зависит от того, как массив поделен
 void GenerateArray(int *array, unsigned int array_size, unsigned int seed);
+void GenerateArrayRange(int *array, unsigned int array_size, unsigned int begin,
+                        unsigned int end, unsigned int seed, enum Distribution dist);
+// Заполнение массива threads потоками, каждый - свою часть
+void GenerateArrayParallel(int *array, unsigned int array_size, unsigned int seed,
+                           enum Distribution dist, int threads);
+
+// Массив из файла с сырыми int32 (порядок байт машины) без копирования:
+// файл отображается в память только для чтения, дочерние процессы после
+// fork видят те же страницы. populate - прочитать весь файл сразу
+// (MAP_POPULATE), а не по первому обращению к странице
+int *MapArrayFile(const char *path, int populate, unsigned long long *array_size);
+void UnmapArray(int *array, unsigned long long array_size);
 
 #endif
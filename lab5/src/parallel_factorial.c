@@ -36,7 +36,8 @@ void* calculate_partial_factorial(void* arg) {
            data->thread_id, data->start, data->end, data->mod);
     
     // Вычисление частичного факториала для диапазона [start, end]
-    for (int i = data->start; i <= data->end; i++) {
+    // Как только произведение стало 0, дальше оно не изменится
+    for (int i = data->start; i <= data->end && partial_result != 0; i++) {
         partial_result = (partial_result * i) % data->mod;
     }
     
@@ -57,6 +58,65 @@ void* calculate_partial_factorial(void* arg) {
     return NULL;
 }
 
+/**
+ * Возведение в степень по модулю (mod < 2^31, произведения помещаются в long long)
+ */
+long long pow_mod(long long base, long long exp, long long mod) {
+    long long result = 1 % mod;
+    base %= mod;
+    while (exp > 0) {
+        if (exp & 1) {
+            result = (result * base) % mod;
+        }
+        base = (base * base) % mod;
+        exp >>= 1;
+    }
+    return result;
+}
+
+/**
+ * Детерминированный тест Миллера-Рабина: основания 2, 7, 61
+ * дают верный ответ для всех n < 4 759 123 141, то есть для любого int
+ */
+int is_prime(int n) {
+    static const int bases[] = {2, 7, 61};
+    if (n < 2) {
+        return 0;
+    }
+    if (n % 2 == 0) {
+        return n == 2;
+    }
+
+    // n - 1 = d * 2^s, d нечетное
+    long long d = n - 1;
+    int s = 0;
+    while (d % 2 == 0) {
+        d /= 2;
+        s++;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (bases[i] % n == 0) {
+            continue;
+        }
+        long long x = pow_mod(bases[i], d, n);
+        if (x == 1 || x == n - 1) {
+            continue;
+        }
+        int composite = 1;
+        for (int r = 1; r < s && composite; r++) {
+            x = (x * x) % n;
+            if (x == n - 1) {
+                composite = 0;
+            }
+        }
+        if (composite) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
 /**
  * Функция для вывода справки по использованию
  */
@@ -131,12 +191,29 @@ int main(int argc, char* argv[]) {
     
     // Особые случаи для факториала
     if (k == 0 || k == 1) {
-        printf("Результат: %d! mod %d = 1\n", k, mod);
+        printf("Результат: %d! mod %d = %d\n", k, mod, 1 % mod);
+        return 0;
+    }
+    
+    // Среди 1..k есть само число mod, поэтому k! делится на mod
+    if (k >= mod) {
+        printf("Результат: %d! mod %d = 0 (k >= mod)\n", k, mod);
         return 0;
     }
     
+    // Для простого mod = p по теореме Вильсона (p-1)! = -1 (mod p), откуда
+    // k! * (p-1-k)! = (-1)^(k+1) (mod p). Если p-1-k < k, потоки считают
+    // более короткий факториал (p-1-k)!, а k! получается обратным элементом
+    int n = k;
+    int wilson = 0;
+    if (is_prime(mod) && mod - 1 - k < k) {
+        n = mod - 1 - k;
+        wilson = 1;
+        printf("mod простой: по теореме Вильсона вычисляю %d! вместо %d!\n", n, k);
+    }
+    
     // Общий результат (инициализируется 1, так как 1 - нейтральный элемент для умножения)
-    long long result = 1;
+    long long result = 1 % mod;
     
     // Инициализация мьютекса для синхронизации
     pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -146,8 +223,8 @@ int main(int argc, char* argv[]) {
     thread_data_t thread_data[pnum];
     
     // Распределение работы между потоками
-    int numbers_per_thread = k / pnum;
-    int remainder = k % pnum;
+    int numbers_per_thread = n / pnum;
+    int remainder = n % pnum;
     int current_start = 1;  // Факториал начинается с 1
     
     printf("Распределение работы:\n");
@@ -189,6 +266,14 @@ int main(int argc, char* argv[]) {
     // Уничтожение мьютекса
     pthread_mutex_destroy(&mutex);
     
+    // k! = (-1)^(k+1) * ((p-1-k)!)^-1 (mod p); (p-1-k)! не делится на простое p
+    if (wilson) {
+        result = pow_mod(result, mod - 2, mod);
+        if (k % 2 == 0) {
+            result = (mod - result) % mod;
+        }
+    }
+    
     // Вывод финального результата
     printf("\n=== Результат ===\n");
     printf("%d! mod %d = %lld\n", k, mod, result);
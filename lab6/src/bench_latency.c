@@ -0,0 +1,278 @@
+/**
+ * bench_latency.c - Замер задержки сервера при N одновременных клиентах
+ * Использование: ./bench_latency --port 20001 --clients 100 --requests 50
+ *                                [--host 127.0.0.1] [--range 1000] [--mod 1000000007]
+ *                                [--pipeline 8]
+ *
+ * Каждый клиент - отдельный поток с собственным соединением, который
+ * последовательно отправляет запросы старого формата (begin, end, mod)
+ * и замеряет время до получения ответа. С --pipeline N клиент говорит
+ * кадровым протоколом и держит в полете до N запросов, задержка
+ * считается от отправки запроса до ответа с его request_id.
+ * В конце печатаются перцентили задержки по всем запросам
+ * и общая пропускная способность.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime при -std=c99
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "protocol.h"
+
+/**
+ * Параметры и результаты одного клиента
+ */
+struct BenchClient {
+  struct sockaddr_in addr;  // Адрес сервера
+  int requests;             // Количество запросов
+  uint64_t range;           // Длина диапазона в запросе
+  uint64_t mod;             // Модуль
+  int pipeline;             // Запросов в полете (0 - старый протокол)
+  uint64_t *latencies;      // Задержки запросов в наносекундах
+  int done;                 // Количество успешно выполненных запросов
+};
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void MakeTask(const struct BenchClient *client, int i, struct FactorialArgs *task) {
+  task->begin = 1 + (uint64_t)i * client->range;
+  task->end = task->begin + client->range - 1;
+  task->mod = client->mod;
+}
+
+/**
+ * Конвейер кадрового протокола: до pipeline запросов в полете,
+ * новый запрос уходит на место каждого полученного ответа
+ */
+static void RunPipelined(struct BenchClient *client, int sck) {
+  uint64_t *start = calloc((size_t)client->requests, sizeof(uint64_t));
+  if (start == NULL)
+    return;
+  int sent = 0;
+  while (client->done < client->requests) {
+    while (sent < client->requests && sent - client->done < client->pipeline) {
+      struct FactorialArgs task;
+      MakeTask(client, sent, &task);
+      uint8_t frame[FRAME_HEADER_SIZE + RANGE_PAYLOAD_SIZE];
+      size_t size = EncodeRangeRequest(frame, (uint64_t)sent, &task);
+      start[sent] = NowNs();
+      if (!SendAll(sck, frame, size)) {
+        fprintf(stderr, "Request %d failed\n", sent);
+        free(start);
+        return;
+      }
+      sent++;
+    }
+
+    struct FrameHeader header;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    if (!RecvFrame(sck, &header, payload, sizeof(payload)) || header.opcode != OP_RESULT ||
+        header.request_id >= (uint64_t)sent) {
+      fprintf(stderr, "Response %d failed\n", client->done);
+      break;
+    }
+    client->latencies[client->done++] = NowNs() - start[header.request_id];
+  }
+  free(start);
+}
+
+static void *RunClient(void *arg) {
+  struct BenchClient *client = (struct BenchClient *)arg;
+
+  int sck = socket(AF_INET, SOCK_STREAM, 0);
+  if (sck < 0) {
+    perror("socket");
+    return NULL;
+  }
+  if (connect(sck, (struct sockaddr *)&client->addr, sizeof(client->addr)) < 0) {
+    perror("connect");
+    close(sck);
+    return NULL;
+  }
+  int opt_val = 1;
+  setsockopt(sck, IPPROTO_TCP, TCP_NODELAY, &opt_val, sizeof(opt_val));
+
+  if (client->pipeline > 0) {
+    RunPipelined(client, sck);
+    close(sck);
+    return NULL;
+  }
+
+  for (int i = 0; i < client->requests; i++) {
+    struct FactorialArgs args;
+    MakeTask(client, i, &args);
+    uint64_t task[3] = {args.begin, args.end, args.mod};
+
+    uint64_t start = NowNs();
+    uint64_t answer = 0;
+    if (!SendAll(sck, task, sizeof(task)) || !RecvAll(sck, &answer, sizeof(answer))) {
+      fprintf(stderr, "Request %d failed\n", i);
+      break;
+    }
+    client->latencies[client->done++] = NowNs() - start;
+  }
+
+  close(sck);
+  return NULL;
+}
+
+static int CompareU64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static double Percentile(const uint64_t *sorted, size_t count, double p) {
+  size_t idx = (size_t)(p * (double)(count - 1) + 0.5);
+  return (double)sorted[idx] / 1000.0;  // В микросекундах
+}
+
+int main(int argc, char **argv) {
+  char host[255] = "127.0.0.1";
+  int port = -1;
+  int clients = 10;
+  int requests = 100;
+  uint64_t range = 1000;
+  uint64_t mod = 1000000007;
+  int pipeline = 0;
+
+  while (true) {
+    static struct option options[] = {
+      {"host", required_argument, 0, 0},
+      {"port", required_argument, 0, 0},
+      {"clients", required_argument, 0, 0},
+      {"requests", required_argument, 0, 0},
+      {"range", required_argument, 0, 0},
+      {"mod", required_argument, 0, 0},
+      {"pipeline", required_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c != 0) {
+      printf("Unknown argument\n");
+      continue;
+    }
+
+    switch (option_index) {
+    case 0:
+      strncpy(host, optarg, sizeof(host) - 1);
+      break;
+    case 1:
+      port = atoi(optarg);
+      break;
+    case 2:
+      clients = atoi(optarg);
+      break;
+    case 3:
+      requests = atoi(optarg);
+      break;
+    case 4:
+      if (!ConvertStringToUI64(optarg, &range) || range == 0) {
+        fprintf(stderr, "Invalid range: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 5:
+      if (!ConvertStringToUI64(optarg, &mod) || mod == 0) {
+        fprintf(stderr, "Invalid mod: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 6:
+      pipeline = atoi(optarg);
+      break;
+    }
+  }
+
+  if (port <= 0 || clients <= 0 || requests <= 0 || pipeline < 0) {
+    fprintf(stderr, "Using: %s --port 20001 --clients 100 --requests 50 "
+            "[--host 127.0.0.1] [--range 1000] [--mod 1000000007] [--pipeline 8]\n", argv[0]);
+    return 1;
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) <= 0) {
+    fprintf(stderr, "Bad address: %s\n", host);
+    return 1;
+  }
+
+  struct BenchClient *bench = calloc(clients, sizeof(struct BenchClient));
+  pthread_t *threads = calloc(clients, sizeof(pthread_t));
+  uint64_t *latencies = calloc((size_t)clients * requests, sizeof(uint64_t));
+  if (bench == NULL || threads == NULL || latencies == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  // Маленький стек: потоков может быть несколько тысяч
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, 64 * 1024);
+
+  uint64_t start = NowNs();
+  for (int i = 0; i < clients; i++) {
+    bench[i].addr = addr;
+    bench[i].requests = requests;
+    bench[i].range = range;
+    bench[i].mod = mod;
+    bench[i].pipeline = pipeline;
+    bench[i].latencies = latencies + (size_t)i * requests;
+    if (pthread_create(&threads[i], &attr, RunClient, &bench[i])) {
+      fprintf(stderr, "Error creating client thread %d\n", i);
+      clients = i;
+      break;
+    }
+  }
+
+  // Сжатие задержек всех клиентов в начало общего массива
+  size_t total = 0;
+  for (int i = 0; i < clients; i++) {
+    pthread_join(threads[i], NULL);
+    memmove(latencies + total, bench[i].latencies, sizeof(uint64_t) * bench[i].done);
+    total += (size_t)bench[i].done;
+  }
+  double elapsed = (double)(NowNs() - start) / 1e9;
+  pthread_attr_destroy(&attr);
+
+  if (total == 0) {
+    fprintf(stderr, "No successful requests\n");
+    return 1;
+  }
+
+  qsort(latencies, total, sizeof(uint64_t), CompareU64);
+  printf("clients: %d, requests: %zu, range: %" PRIu64 "\n", clients, total, range);
+  printf("throughput: %.0f req/s\n", (double)total / elapsed);
+  printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+         Percentile(latencies, total, 0.50), Percentile(latencies, total, 0.90),
+         Percentile(latencies, total, 0.99), Percentile(latencies, total, 1.0));
+
+  free(latencies);
+  free(threads);
+  free(bench);
+  return 0;
+}
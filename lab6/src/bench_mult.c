@@ -0,0 +1,126 @@
+/**
+ * bench_mult.c - Микробенчмарк умножения по модулю
+ * Использование: ./bench_mult [--count 5000000]
+ *
+ * Сравнивает прежнее побитовое MultModulo (сдвиг и сложение с делением
+ * на каждом бите) с 128-битным MultModulo, ModMul через контекст
+ * и ModRangeProduct на модулях разной разрядности, четных и нечетных.
+ * Все варианты считают одно и то же произведение диапазона, результаты сверяются.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime при -std=c99
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <getopt.h>
+
+#include "common.h"
+
+/**
+ * Прежняя реализация MultModulo: до 64 итераций с двумя делениями
+ */
+static uint64_t MultModuloBitSerial(uint64_t a, uint64_t b, uint64_t mod) {
+  uint64_t result = 0;
+  a = a % mod;
+  while (b > 0) {
+    if (b % 2 == 1)
+      result = (result + a) % mod;
+    a = (a * 2) % mod;
+    b /= 2;
+  }
+  return result % mod;
+}
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  uint64_t count = 5000000;
+
+  while (true) {
+    static struct option options[] = {
+      {"count", required_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c == 0 && option_index == 0) {
+      if (!ConvertStringToUI64(optarg, &count) || count == 0) {
+        fprintf(stderr, "Invalid count: %s\n", optarg);
+        return 1;
+      }
+    }
+  }
+
+  // Модули разной разрядности: для каждой пара нечетный/четный
+  const uint64_t mods[] = {
+    65521, 65522,
+    2147483647, 2147483646,
+    281474976710597ull, 281474976710598ull,
+    4611686018427387847ull, 4611686018427387848ull,
+    18446744073709551557ull, 18446744073709551558ull,
+  };
+  const size_t mods_num = sizeof(mods) / sizeof(mods[0]);
+  // Побитовый вариант медленный: для него берется меньше умножений
+  uint64_t slow_count = count / 10 ? count / 10 : 1;
+  uint64_t begin = 1000003;  // Начало диапазона: числа больше 2^16, чтобы шло по 20+ итераций
+
+  printf("ns per multiplication, %" PRIu64 " multiplications per run\n", count);
+  printf("%-22s %-11s %12s %12s %12s %12s\n",
+         "mod", "kind", "bit-serial", "MultModulo", "ModMul", "RangeProd");
+
+  bool ok = true;
+  for (size_t m = 0; m < mods_num; m++) {
+    uint64_t mod = mods[m];
+    struct ModContext ctx;
+    ModContextInit(&ctx, mod);
+    const char *kind = ctx.kind == MOD_MONTGOMERY ? "montgomery"
+                     : ctx.kind == MOD_NATIVE ? "native" : "wide";
+
+    // Прежний побитовый вариант на укороченном диапазоне (для сверки тоже)
+    double t0 = NowSec();
+    uint64_t slow = 1 % mod;
+    for (uint64_t i = begin; i < begin + slow_count; i++)
+      slow = MultModuloBitSerial(slow, i, mod);
+    double slow_ns = (NowSec() - t0) * 1e9 / (double)slow_count;
+
+    t0 = NowSec();
+    uint64_t wide = 1 % mod;
+    for (uint64_t i = begin; i < begin + count; i++)
+      wide = MultModulo(wide, i, mod);
+    double wide_ns = (NowSec() - t0) * 1e9 / (double)count;
+
+    t0 = NowSec();
+    uint64_t ctx_mul = 1 % mod;
+    for (uint64_t i = begin; i < begin + count; i++)
+      ctx_mul = ModMul(&ctx, ctx_mul, i);
+    double ctx_ns = (NowSec() - t0) * 1e9 / (double)count;
+
+    t0 = NowSec();
+    uint64_t range = ModRangeProduct(&ctx, begin, begin + count - 1);
+    double range_ns = (NowSec() - t0) * 1e9 / (double)count;
+
+    // Побитовый вариант переполняется (a * 2, result + a) при mod >= 2^63,
+    // поэтому сверяется только ниже этой границы
+    uint64_t check = ModRangeProduct(&ctx, begin, begin + slow_count - 1);
+    if (wide != range || ctx_mul != range || (mod < (1ull << 63) && slow != check)) {
+      printf("MISMATCH for mod %" PRIu64 "\n", mod);
+      ok = false;
+    }
+
+    printf("%-22" PRIu64 " %-11s %12.2f %12.2f %12.2f %12.2f\n",
+           mod, kind, slow_ns, wide_ns, ctx_ns, range_ns);
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/**
+ * bench_range.c - Пропускная способность ядер произведения диапазона
+ * Использование: ./bench_range [--count 20000000]
+ *
+ * Считает одно и то же произведение диапазона каждым доступным ядром
+ * (serial - прежняя одна цепочка, scalar - RANGE_CHAINS цепочек,
+ * avx2, ifma) в одном потоке и печатает миллионы чисел в секунду
+ * на ядро процессора. Результаты всех ядер сверяются.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime при -std=c99
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <getopt.h>
+
+#include "common.h"
+#include "range_kernel.h"
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  uint64_t count = 20000000;
+
+  while (true) {
+    static struct option options[] = {
+      {"count", required_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c == 0 && option_index == 0) {
+      if (!ConvertStringToUI64(optarg, &count) || count == 0) {
+        fprintf(stderr, "Invalid count: %s\n", optarg);
+        return 1;
+      }
+    }
+  }
+
+  // Модули разной разрядности: векторные ядра берут нечетные до 2^32 и 2^52
+  const uint64_t mods[] = {
+    65521, 998244353, 2147483647, 4294967291ull,
+    281474976710597ull, 4503599627370449ull,
+    4611686018427387847ull, 18446744073709551557ull, 1000000008,
+  };
+  const size_t mods_num = sizeof(mods) / sizeof(mods[0]);
+  const enum RangeKernel kernels[] = {
+    RANGE_KERNEL_SERIAL, RANGE_KERNEL_SCALAR, RANGE_KERNEL_AVX2, RANGE_KERNEL_IFMA
+  };
+  const size_t kernels_num = sizeof(kernels) / sizeof(kernels[0]);
+  uint64_t begin = 1000003;
+
+  printf("Million integers per second per core, %" PRIu64 " integers per run\n", count);
+  printf("%-22s", "mod");
+  for (size_t k = 0; k < kernels_num; k++)
+    printf(" %10s", RangeKernelName(kernels[k]));
+  printf("   selected\n");
+
+  bool ok = true;
+  for (size_t m = 0; m < mods_num; m++) {
+    struct ModContext ctx;
+    ModContextInit(&ctx, mods[m]);
+    printf("%-22" PRIu64, mods[m]);
+
+    uint64_t expected = 0;
+    for (size_t k = 0; k < kernels_num; k++) {
+      if (!RangeKernelAvailable(kernels[k], &ctx)) {
+        printf(" %10s", "-");
+        continue;
+      }
+      double t0 = NowSec();
+      uint64_t result = RangeKernelProduct(kernels[k], &ctx, begin, begin + count - 1);
+      double elapsed = NowSec() - t0;
+      if (k == 0)
+        expected = result;
+      else if (result != expected) {
+        printf("\nMISMATCH for mod %" PRIu64 " in %s\n", mods[m], RangeKernelName(kernels[k]));
+        ok = false;
+      }
+      printf(" %10.1f", (double)count / elapsed / 1e6);
+    }
+    printf("   %s\n", RangeKernelName(RangeKernelSelect(&ctx)));
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/**
+ * cache.c - Кэш произведений блоков для повторяющихся диапазонов
+ */
+
+#include "cache.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "metrics.h"       // Счетчики попаданий и промахов
+#include "range_kernel.h"  // Векторные ядра произведения диапазона
+
+/**
+ * Ячейка хеш-таблицы: номер блока + 1 (0 - пустая ячейка) и его произведение
+ */
+struct CacheSlot {
+  uint64_t key;
+  uint64_t value;
+};
+
+/**
+ * Блоки одного модуля: хеш-таблица с открытой адресацией
+ * и место в LRU-списке модулей
+ */
+struct ModCache {
+  uint64_t mod;
+  struct CacheSlot *slots;
+  size_t capacity;          // Степень двойки
+  size_t count;             // Занятые ячейки
+  struct ModCache *prev;
+  struct ModCache *next;
+};
+
+#define CACHE_MIN_CAPACITY 64
+
+static size_t EntryBytes(size_t capacity) {
+  return sizeof(struct ModCache) + capacity * sizeof(struct CacheSlot);
+}
+
+static size_t SlotIndex(uint64_t key, size_t capacity) {
+  return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+void CacheInit(struct PrefixCache *cache, size_t budget_bytes) {
+  pthread_mutex_init(&cache->mutex, NULL);
+  cache->budget = budget_bytes;
+  cache->used = 0;
+  cache->head = NULL;
+  cache->tail = NULL;
+}
+
+static void Unlink(struct PrefixCache *cache, struct ModCache *entry) {
+  if (entry->prev != NULL)
+    entry->prev->next = entry->next;
+  else
+    cache->head = entry->next;
+  if (entry->next != NULL)
+    entry->next->prev = entry->prev;
+  else
+    cache->tail = entry->prev;
+}
+
+static void PushFront(struct PrefixCache *cache, struct ModCache *entry) {
+  entry->prev = NULL;
+  entry->next = cache->head;
+  if (cache->head != NULL)
+    cache->head->prev = entry;
+  cache->head = entry;
+  if (cache->tail == NULL)
+    cache->tail = entry;
+}
+
+static void FreeEntry(struct PrefixCache *cache, struct ModCache *entry) {
+  Unlink(cache, entry);
+  cache->used -= EntryBytes(entry->capacity);
+  free(entry->slots);
+  free(entry);
+}
+
+void CacheDestroy(struct PrefixCache *cache) {
+  while (cache->head != NULL)
+    FreeEntry(cache, cache->head);
+  pthread_mutex_destroy(&cache->mutex);
+}
+
+/**
+ * Освобождение места под bytes байт вытеснением модулей с конца LRU-списка
+ * Модуль keep не вытесняется: для него как раз выделяется память
+ */
+static bool Reserve(struct PrefixCache *cache, size_t bytes, struct ModCache *keep) {
+  while (cache->used + bytes > cache->budget) {
+    struct ModCache *victim = cache->tail;
+    if (victim == keep)
+      victim = keep->prev;
+    if (victim == NULL)
+      return false;
+    FreeEntry(cache, victim);
+  }
+  return true;
+}
+
+/**
+ * Поиск модуля с переносом в начало LRU-списка; при отсутствии - создание
+ */
+static struct ModCache *FindEntry(struct PrefixCache *cache, uint64_t mod, bool create) {
+  for (struct ModCache *entry = cache->head; entry != NULL; entry = entry->next) {
+    if (entry->mod == mod) {
+      Unlink(cache, entry);
+      PushFront(cache, entry);
+      return entry;
+    }
+  }
+  if (!create || !Reserve(cache, EntryBytes(CACHE_MIN_CAPACITY), NULL))
+    return NULL;
+
+  struct ModCache *entry = malloc(sizeof(struct ModCache));
+  struct CacheSlot *slots = calloc(CACHE_MIN_CAPACITY, sizeof(struct CacheSlot));
+  if (entry == NULL || slots == NULL) {
+    free(entry);
+    free(slots);
+    return NULL;
+  }
+  entry->mod = mod;
+  entry->slots = slots;
+  entry->capacity = CACHE_MIN_CAPACITY;
+  entry->count = 0;
+  cache->used += EntryBytes(entry->capacity);
+  PushFront(cache, entry);
+  return entry;
+}
+
+static bool Lookup(const struct ModCache *entry, uint64_t key, uint64_t *value) {
+  size_t mask = entry->capacity - 1;
+  for (size_t i = SlotIndex(key, entry->capacity); entry->slots[i].key != 0; i = (i + 1) & mask) {
+    if (entry->slots[i].key == key) {
+      *value = entry->slots[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void InsertSlot(struct CacheSlot *slots, size_t capacity, uint64_t key, uint64_t value) {
+  size_t mask = capacity - 1;
+  size_t i = SlotIndex(key, capacity);
+  while (slots[i].key != 0)
+    i = (i + 1) & mask;
+  slots[i].key = key;
+  slots[i].value = value;
+}
+
+/**
+ * Удвоение таблицы модуля, если это позволяет бюджет
+ */
+static bool Grow(struct PrefixCache *cache, struct ModCache *entry) {
+  size_t capacity = entry->capacity * 2;
+  size_t extra = EntryBytes(capacity) - EntryBytes(entry->capacity);
+  if (!Reserve(cache, extra, entry))
+    return false;
+  struct CacheSlot *slots = calloc(capacity, sizeof(struct CacheSlot));
+  if (slots == NULL)
+    return false;
+  for (size_t i = 0; i < entry->capacity; i++) {
+    if (entry->slots[i].key != 0)
+      InsertSlot(slots, capacity, entry->slots[i].key, entry->slots[i].value);
+  }
+  free(entry->slots);
+  entry->slots = slots;
+  entry->capacity = capacity;
+  cache->used += extra;
+  return true;
+}
+
+/**
+ * Добавление отсутствующего блока; таблица растет при заполнении наполовину.
+ * Если бюджет не дает расти, таблица заполняется не более чем на 3/4,
+ * а лишние блоки просто не сохраняются
+ */
+static void Insert(struct PrefixCache *cache, struct ModCache *entry, uint64_t key, uint64_t value) {
+  if ((entry->count + 1) * 2 > entry->capacity && !Grow(cache, entry) &&
+      (entry->count + 1) * 4 > entry->capacity * 3)
+    return;
+  InsertSlot(entry->slots, entry->capacity, key, value);
+  entry->count++;
+}
+
+/**
+ * Произведение одного блока: из кэша или с вычислением и сохранением
+ * Вычисление идет без блокировки, чтобы потоки не ждали друг друга
+ */
+static uint64_t BlockProduct(struct PrefixCache *cache, const struct ModContext *ctx, uint64_t block) {
+  uint64_t key = block + 1;
+  uint64_t value = 0;
+
+  pthread_mutex_lock(&cache->mutex);
+  struct ModCache *entry = FindEntry(cache, ctx->mod, false);
+  bool found = entry != NULL && Lookup(entry, key, &value);
+  pthread_mutex_unlock(&cache->mutex);
+  MetricsAdd(found ? METRIC_CACHE_HITS : METRIC_CACHE_MISSES, 1);
+  if (found)
+    return value;
+
+  uint64_t first = block << CACHE_BLOCK_BITS;
+  value = RangeProduct(ctx, first, first + CACHE_BLOCK_SIZE - 1);
+
+  // Модуль мог быть вытеснен, пока шло вычисление: ищем заново
+  pthread_mutex_lock(&cache->mutex);
+  entry = FindEntry(cache, ctx->mod, true);
+  uint64_t existing;
+  if (entry != NULL && !Lookup(entry, key, &existing))
+    Insert(cache, entry, key, value);
+  pthread_mutex_unlock(&cache->mutex);
+  return value;
+}
+
+/**
+ * Произведение begin * ... * end по модулю контекста с использованием кэша:
+ * короткий хвост до первой контрольной точки, целые блоки, хвост после последней
+ */
+uint64_t CacheRangeProduct(struct PrefixCache *cache, const struct ModContext *ctx,
+                           uint64_t begin, uint64_t end) {
+  // Номера первого и следующего за последним целых блоков внутри [begin, end]
+  uint64_t first_block = (begin >> CACHE_BLOCK_BITS) + ((begin & (CACHE_BLOCK_SIZE - 1)) != 0);
+  uint64_t last_block = (end >> CACHE_BLOCK_BITS) +
+                        ((end & (CACHE_BLOCK_SIZE - 1)) == CACHE_BLOCK_SIZE - 1);
+  if (first_block >= last_block || first_block >= (UINT64_MAX >> CACHE_BLOCK_BITS))
+    return RangeProduct(ctx, begin, end);
+
+  uint64_t blocks_begin = first_block << CACHE_BLOCK_BITS;
+  uint64_t blocks_end = (last_block << CACHE_BLOCK_BITS) - 1;
+
+  uint64_t ans = 1 % ctx->mod;
+  if (begin < blocks_begin)
+    ans = RangeProduct(ctx, begin, blocks_begin - 1);
+  for (uint64_t block = first_block; block < last_block && ans != 0; block++)
+    ans = ModMul(ctx, ans, BlockProduct(cache, ctx, block));
+  if (blocks_end < end && ans != 0)
+    ans = ModMul(ctx, ans, RangeProduct(ctx, blocks_end + 1, end));
+  return ans;
+}
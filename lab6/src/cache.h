@@ -0,0 +1,38 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Шаг контрольных точек: кэшируются произведения блоков по 2^16 чисел
+#define CACHE_BLOCK_BITS 16
+#define CACHE_BLOCK_SIZE (1ull << CACHE_BLOCK_BITS)
+
+struct ModCache;
+
+/**
+ * Кэш произведений блоков [j * 2^16, (j+1) * 2^16 - 1] по каждому модулю
+ *
+ * Префиксные произведения при составном модуле нельзя делить друг на друга,
+ * поэтому хранятся произведения отдельных блоков между контрольными точками:
+ * запрос собирается из готовых блоков плюс короткие хвосты по краям.
+ * Общий объем ограничен бюджетом, при нехватке места вытесняются
+ * давно не использованные модули (LRU).
+ */
+struct PrefixCache {
+  pthread_mutex_t mutex;
+  size_t budget;            // Предел памяти в байтах
+  size_t used;              // Занятая память в байтах
+  struct ModCache *head;    // Самый недавно использованный модуль
+  struct ModCache *tail;    // Кандидат на вытеснение
+};
+
+void CacheInit(struct PrefixCache *cache, size_t budget_bytes);
+void CacheDestroy(struct PrefixCache *cache);
+uint64_t CacheRangeProduct(struct PrefixCache *cache, const struct ModContext *ctx,
+                           uint64_t begin, uint64_t end);
+
+#endif
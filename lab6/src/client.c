@@ -1,142 +1,76 @@
 /**
  * client.c - Клиент для распределенного вычисления факториала по модулю
  * Использование: ./client --k 1000 --mod 5 --servers servers.txt
- * 
+ *                         [--pipeline 4] [--chunks 64] [--timeout-ms 10000] [--retries 3]
+ *                ./client --batch --servers servers.txt [...] < jobs.txt
+ *
  * Клиент распределяет вычисление факториала k! mod mod между несколькими серверами,
- * используя многопоточность для параллельного взаимодействия с серверами.
- * 
+ * используя клиентскую библиотеку cluster.h (потоки, постоянные соединения,
+ * планировщик кусков и обработка отказов описаны там).
+ *
  * Архитектура:
  * 1. Парсинг аргументов командной строки
  * 2. Чтение конфигурации серверов из файла
- * 3. Распределение диапазонов чисел между серверами
- * 4. Параллельное взаимодействие с серверами через потоки
- * 5. Объединение результатов и вывод итога
+ * 3. Открытие кластера: адреса серверов разрешаются один раз
+ * 4. Вычисление одного задания (--k, --mod) или по заданию на каждую строку
+ *    "k mod" из stdin (--batch): все задания идут по одним и тем же
+ *    соединениям, без нового рукопожатия TCP
+ * 5. Вывод итога, пропускной способности и состояния серверов по каждому заданию
  */
 
+#define _POSIX_C_SOURCE 200809L  // clock_gettime при -std=c99
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+#include <time.h>
 #include <inttypes.h>  // Для правильного форматирования uint64_t (PRIu64)
 
-#include <errno.h>
 #include <getopt.h>
-#include <netdb.h>
-#include <netinet/in.h>
-#include <netinet/ip.h>
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <pthread.h>
 
-#include "common.h"  // Общие структуры и функции
+#include "common.h"   // Общие структуры и функции
+#include "cluster.h"  // Постоянные соединения с серверами и планировщик кусков
 
-/**
- * Структура для передачи аргументов в поток обработки сервера
- * Содержит всю необходимую информацию для взаимодействия с одним сервером
- */
-struct ThreadArgs {
-  struct Server server;    // Информация о сервере (IP и порт)
-  uint64_t begin;          // Начало диапазона чисел для вычислений
-  uint64_t end;            // Конец диапазона чисел для вычислений
-  uint64_t mod;            // Модуль для вычислений
-  uint64_t* result;        // Указатель для сохранения результата от сервера
-};
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
 
 /**
- * Функция, выполняемая в отдельном потоке для взаимодействия с одним сервером
- * Устанавливает TCP-соединение, отправляет задачу, получает и сохраняет результат
- * 
- * @param args - указатель на структуру ThreadArgs с параметрами для сервера
- * @return NULL (результат сохраняется через указатель в структуре)
+ * Вычисление одного задания на кластере и вывод его итогов
+ *
+ * @return true, если результат получен
  */
-void* ProcessServer(void* args) {
-  struct ThreadArgs* thread_args = (struct ThreadArgs*)args;
-  
-  // Получение информации о хосте по IP-адресу или доменному имени
-  struct hostent *hostname = gethostbyname(thread_args->server.ip);
-  if (hostname == NULL) {
-    fprintf(stderr, "gethostbyname failed with %s\n", thread_args->server.ip);
-    *(thread_args->result) = 0;  // В случае ошибки возвращаем 0
-    return NULL;
-  }
-
-  // Настройка адреса сервера для подключения
-  struct sockaddr_in server_addr;
-  server_addr.sin_family = AF_INET;  // Используем IPv4
-  server_addr.sin_port = htons(thread_args->server.port);  // Порт в сетевом порядке байт
-  
-  // Копирование IP-адреса из структуры hostent
-  if (hostname->h_addr_list[0] != NULL) {
-    memcpy(&server_addr.sin_addr.s_addr, 
-           hostname->h_addr_list[0], 
-           hostname->h_length);
-  } else {
-    fprintf(stderr, "No address found for %s\n", thread_args->server.ip);
-    *(thread_args->result) = 0;
-    return NULL;
-  }
-
-  // СОЗДАНИЕ И НАСТРОЙКА КЛИЕНТСКОГО СОКЕТА
-  
-  // Создание TCP сокета
-  int sck = socket(AF_INET, SOCK_STREAM, 0);
-  if (sck < 0) {
-    fprintf(stderr, "Socket creation failed!\n");
-    *(thread_args->result) = 0;
-    return NULL;
-  }
-
-  // Установка соединения с сервером
-  if (connect(sck, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-    fprintf(stderr, "Connection to %s:%d failed\n", 
-            thread_args->server.ip, thread_args->server.port);
-    close(sck);
-    *(thread_args->result) = 0;
-    return NULL;
-  }
-
-  // ПОДГОТОВКА И ОТПРАВКА ЗАДАЧИ СЕРВЕРУ
-  
-  // Формирование бинарного сообщения: 3 числа uint64_t (begin, end, mod)
-  char task[sizeof(uint64_t) * 3];
-  memcpy(task, &thread_args->begin, sizeof(uint64_t));
-  memcpy(task + sizeof(uint64_t), &thread_args->end, sizeof(uint64_t));
-  memcpy(task + 2 * sizeof(uint64_t), &thread_args->mod, sizeof(uint64_t));
-
-  // Отправка задачи серверу
-  if (send(sck, task, sizeof(task), 0) < 0) {
-    fprintf(stderr, "Send failed to %s:%d\n", 
-            thread_args->server.ip, thread_args->server.port);
-    close(sck);
-    *(thread_args->result) = 0;
-    return NULL;
-  }
-
-  // ПОЛУЧЕНИЕ ОТВЕТА ОТ СЕРВЕРА
-  
-  char response[sizeof(uint64_t)];  // Буфер для ответа (одно число uint64_t)
-  if (recv(sck, response, sizeof(response), 0) < 0) {
-    fprintf(stderr, "Receive failed from %s:%d\n", 
-            thread_args->server.ip, thread_args->server.port);
-    close(sck);
-    *(thread_args->result) = 0;
-    return NULL;
+static bool RunJob(struct Cluster *cluster, uint64_t k, uint64_t mod, uint64_t chunks_num) {
+  uint64_t start = NowNs();
+  uint64_t total = 0;
+  bool ok = ClusterFactorial(cluster, k, mod, chunks_num, &total);
+  double elapsed = (double)(NowNs() - start) / 1e9;
+
+  printf("Range [1, %" PRIu64 "] split into %zu chunks\n", k, cluster->chunks_num);
+
+  // ПРОПУСКНАЯ СПОСОБНОСТЬ И ЗДОРОВЬЕ СЕРВЕРОВ
+
+  static const char *state_names[] = {"healthy", "suspect", "blacklisted", "unresolved"};
+  for (unsigned int i = 0; i < cluster->servers_num; i++) {
+    const struct ServerWorker *worker = &cluster->workers[i];
+    const struct ServerHealth *health = &worker->health;
+    printf("Server %s:%d: %" PRIu64 " chunks (%" PRIu64 " re-issued), %" PRIu64
+           " numbers, %.0f numbers/s; %s, %" PRIu64 " failures (%" PRIu64 " timeouts), "
+           "%" PRIu64 " connects\n",
+           worker->server.ip, worker->server.port, worker->chunks_done, worker->reissued,
+           worker->numbers_done, (double)worker->numbers_done / elapsed,
+           state_names[health->state], health->failures, health->timeouts, health->connects);
   }
+  printf("Elapsed: %.3f s\n", elapsed);
 
-  // Извлечение результата из бинарного ответа
-  uint64_t answer = 0;
-  memcpy(&answer, response, sizeof(uint64_t));
-  *(thread_args->result) = answer;  // Сохранение результата
-
-  // Вывод информации о полученном результате
-  // PRIu64 - правильный спецификатор формата для uint64_t
-  printf("Server %s:%d returned: %" PRIu64 " for range [%" PRIu64 ", %" PRIu64 "]\n", 
-         thread_args->server.ip, thread_args->server.port, answer,
-         thread_args->begin, thread_args->end);
-
-  close(sck);  // Закрытие соединения
-  return NULL;
+  // ВЫВОД ФИНАЛЬНОГО РЕЗУЛЬТАТА
+  if (ok)
+    printf("\nFinal result: %" PRIu64 "! mod %" PRIu64 " = %" PRIu64 "\n", k, mod, total);
+  fflush(stdout);
+  return ok;
 }
 
 /**
@@ -147,9 +81,15 @@ int main(int argc, char **argv) {
   uint64_t k = 0;          // Число для вычисления факториала (k!)
   uint64_t mod = 0;        // Модуль для вычислений
   char servers_file[255] = {'\0'};  // Путь к файлу со списком серверов
+  uint64_t chunks_num = 0; // Количество кусков (0 - CHUNKS_PER_SERVER на сервер)
+  bool batch = false;      // Задания из stdin вместо --k и --mod
+  struct ClusterOptions cluster_options;
+  cluster_options.pipeline = 4;        // Запросов в полете на одно соединение с сервером
+  cluster_options.timeout_ms = 10000;  // Предел ожидания ответа на кусок
+  cluster_options.retries = 3;         // Отказов подряд до черного списка
 
   // ПАРСИНГ АРГУМЕНТОВ КОМАНДНОЙ СТРОКИ
-  
+
   // Используем getopt_long для обработки длинных опций (--key value)
   while (true) {
     // Определение доступных опций командной строки
@@ -157,6 +97,11 @@ int main(int argc, char **argv) {
       {"k", required_argument, 0, 0},        // Число для факториала
       {"mod", required_argument, 0, 0},      // Модуль
       {"servers", required_argument, 0, 0},  // Файл с серверами
+      {"pipeline", required_argument, 0, 0}, // Запросов в конвейере
+      {"chunks", required_argument, 0, 0},   // Количество кусков
+      {"timeout-ms", required_argument, 0, 0}, // Предел ожидания ответа
+      {"retries", required_argument, 0, 0},  // Отказов подряд до черного списка
+      {"batch", no_argument, 0, 0},          // Задания "k mod" из stdin
       {0, 0, 0, 0}                           // Конец списка
     };
 
@@ -186,6 +131,36 @@ int main(int argc, char **argv) {
         strncpy(servers_file, optarg, sizeof(servers_file) - 1);
         servers_file[sizeof(servers_file) - 1] = '\0';  // Гарантия нуль-терминации
         break;
+      case 3:  // --pipeline
+        cluster_options.pipeline = atoi(optarg);
+        if (cluster_options.pipeline <= 0) {
+          fprintf(stderr, "Pipeline depth must be positive number\n");
+          return 1;
+        }
+        break;
+      case 4:  // --chunks
+        if (!ConvertStringToUI64(optarg, &chunks_num) || chunks_num == 0) {
+          fprintf(stderr, "Invalid chunks value: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 5:  // --timeout-ms
+        cluster_options.timeout_ms = atoi(optarg);
+        if (cluster_options.timeout_ms <= 0) {
+          fprintf(stderr, "Timeout must be positive number\n");
+          return 1;
+        }
+        break;
+      case 6:  // --retries
+        cluster_options.retries = atoi(optarg);
+        if (cluster_options.retries <= 0) {
+          fprintf(stderr, "Retries must be positive number\n");
+          return 1;
+        }
+        break;
+      case 7:  // --batch
+        batch = true;
+        break;
       default:
         printf("Index %d is out of options\n", option_index);
       }
@@ -201,123 +176,55 @@ int main(int argc, char **argv) {
 
   // ПРОВЕРКА ОБЯЗАТЕЛЬНЫХ ПАРАМЕТРОВ
   // Используем 0 вместо -1, так как uint64_t всегда неотрицательный
-  if (k == 0 || mod == 0 || !strlen(servers_file)) {
-    fprintf(stderr, "Using: %s --k 1000 --mod 5 --servers /path/to/file\n",
-            argv[0]);
+  if ((!batch && (k == 0 || mod == 0)) || !strlen(servers_file)) {
+    fprintf(stderr, "Using: %s --k 1000 --mod 5 --servers /path/to/file "
+            "[--pipeline 4] [--chunks 64] [--timeout-ms 10000] [--retries 3]\n"
+            "       %s --batch --servers /path/to/file [...] < jobs\n", argv[0], argv[0]);
     return 1;
   }
 
   // ЧТЕНИЕ КОНФИГУРАЦИИ СЕРВЕРОВ ИЗ ФАЙЛА
-  
-  FILE* file = fopen(servers_file, "r");
-  if (file == NULL) {
-    fprintf(stderr, "Cannot open servers file: %s\n", servers_file);
-    return 1;
-  }
-
-  struct Server* servers = NULL;     // Динамический массив серверов
-  unsigned int servers_num = 0;      // Количество найденных серверов
-  char line[255];                    // Буфер для чтения строк
 
-  // Чтение файла построчно
-  while (fgets(line, sizeof(line), file)) {
-    line[strcspn(line, "\n")] = 0;  // Удаление символа новой строки
-    
-    if (strlen(line) == 0)  // Пропуск пустых строк
-      continue;
-
-    // Разбор строки формата "IP:port"
-    char* colon = strchr(line, ':');
-    if (colon == NULL) {
-      fprintf(stderr, "Invalid server format in line: %s\n", line);
-      continue;
-    }
-
-    *colon = '\0';  // Разделение строки на IP и порт
-    int port = atoi(colon + 1);  // Преобразование порта в число
-
-    // Проверка корректности номера порта
-    if (port <= 0) {
-      fprintf(stderr, "Invalid port in line: %s\n", line);
-      continue;
-    }
+  unsigned int servers_num = 0;
+  struct Server *servers = ReadServersFile(servers_file, &servers_num);
+  if (servers == NULL)
+    return 1;
+  printf("Found %u servers\n", servers_num);
 
-    // Добавление сервера в динамический массив
-    servers = realloc(servers, (servers_num + 1) * sizeof(struct Server));
-    // Безопасное копирование IP-адреса
-    strncpy(servers[servers_num].ip, line, sizeof(servers[servers_num].ip) - 1);
-    servers[servers_num].ip[sizeof(servers[servers_num].ip) - 1] = '\0';
-    servers[servers_num].port = port;
-    servers_num++;  // Увеличение счетчика серверов
-  }
-  fclose(file);
+  // ОТКРЫТИЕ КЛАСТЕРА
 
-  // Проверка наличия хотя бы одного валидного сервера
-  if (servers_num == 0) {
-    fprintf(stderr, "No valid servers found in file: %s\n", servers_file);
+  struct Cluster cluster;
+  if (ClusterInit(&cluster, servers, servers_num, &cluster_options) != 0) {
+    fprintf(stderr, "Error: can not start cluster!\n");
     free(servers);
     return 1;
   }
 
-  printf("Found %u servers\n", servers_num);
-
-  // РАСПРЕДЕЛЕНИЕ ВЫЧИСЛЕНИЙ МЕЖДУ СЕРВЕРАМИ
-  
-  pthread_t threads[servers_num];           // Массив идентификаторов потоков
-  struct ThreadArgs thread_args[servers_num]; // Аргументы для каждого потока
-  uint64_t results[servers_num];            // Результаты от каждого сервера
-
-  // Вычисление распределения чисел между серверами
-  uint64_t numbers_per_server = k / servers_num;  // Базовое количество на сервер
-  uint64_t remainder = k % servers_num;           // Остаток для равномерного распределения
-  uint64_t current_begin = 1;                     // Начало первого диапазона
-
-  // Создание потоков для взаимодействия с каждым сервером
-  for (unsigned int i = 0; i < servers_num; i++) {
-    // Определение диапазона чисел для текущего сервера
-    uint64_t numbers_for_this_server = numbers_per_server;
-    if (i < remainder) {
-      numbers_for_this_server++;  // Распределение остатка по первым серверам
-    }
-
-    // Настройка параметров для текущего потока
-    thread_args[i].server = servers[i];
-    thread_args[i].begin = current_begin;
-    thread_args[i].end = current_begin + numbers_for_this_server - 1;
-    thread_args[i].mod = mod;
-    thread_args[i].result = &results[i];  // Указатель на ячейку для результата
-
-    // Вывод информации о распределении
-    printf("Server %s:%d will process range [%" PRIu64 ", %" PRIu64 "]\n", 
-           servers[i].ip, servers[i].port, thread_args[i].begin, thread_args[i].end);
+  // ВЫЧИСЛЕНИЯ
 
-    // Создание потока для взаимодействия с сервером
-    if (pthread_create(&threads[i], NULL, ProcessServer, &thread_args[i])) {
-      fprintf(stderr, "Error creating thread for server %s:%d\n", 
-              servers[i].ip, servers[i].port);
-      results[i] = 1;  // При ошибке используем нейтральный элемент умножения
+  int status = 0;
+  if (!batch) {
+    status = RunJob(&cluster, k, mod, chunks_num) ? 0 : 1;
+  } else {
+    // Строка stdin - задание "k mod"; неверные строки пропускаются
+    char line[255];
+    while (fgets(line, sizeof(line), stdin)) {
+      char k_str[64], mod_str[64];
+      if (sscanf(line, "%63s %63s", k_str, mod_str) != 2 ||
+          !ConvertStringToUI64(k_str, &k) || !ConvertStringToUI64(mod_str, &mod) ||
+          k == 0 || mod == 0) {
+        if (strspn(line, " \t\r\n") != strlen(line))
+          fprintf(stderr, "Invalid job line: %s", line);
+        continue;
+      }
+      if (!RunJob(&cluster, k, mod, chunks_num))
+        status = 1;
     }
-
-    current_begin += numbers_for_this_server;  // Сдвиг начала для следующего сервера
-  }
-
-  // СБОР И ОБЪЕДИНЕНИЕ РЕЗУЛЬТАТОВ
-  
-  uint64_t total = 1;  // Нейтральный элемент для умножения
-  
-  // Ожидание завершения всех потоков
-  for (unsigned int i = 0; i < servers_num; i++) {
-    pthread_join(threads[i], NULL);
-    // Последовательное умножение результатов по модулю
-    total = MultModulo(total, results[i], mod);
   }
 
-  // ВЫВОД ФИНАЛЬНОГО РЕЗУЛЬТАТА
-  
-  printf("\nFinal result: %" PRIu64 "! mod %" PRIu64 " = %" PRIu64 "\n", k, mod, total);
-
   // ОСВОБОЖДЕНИЕ РЕСУРСОВ
+  ClusterDestroy(&cluster);
   free(servers);  // Освобождение массива серверов
-  
-  return 0;
-}
\ No newline at end of file
+
+  return status;
+}
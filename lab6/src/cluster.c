@@ -0,0 +1,618 @@
+/**
+ * cluster.c - Постоянные соединения с серверами и планировщик кусков
+ */
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime и getaddrinfo при -std=c99
+
+#include "cluster.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "protocol.h"  // Кадровый протокол с request_id
+
+// Кусок одновременно считается не более чем на стольких серверах
+#define MAX_ISSUES 2
+// Кусок, на котором столько раз отказал сервер (когда кусок был в полете
+// один), считается неисчислимым
+#define MAX_CHUNK_FAILURES 8
+// Пауза перед переподключением: от BACKOFF_BASE_MS, удваивается до BACKOFF_MAX_MS
+#define BACKOFF_BASE_MS 50
+#define BACKOFF_MAX_MS 2000
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Чтение списка серверов из файла (строки формата "IP:port")
+ *
+ * @return массив серверов (освобождается free) или NULL, если их нет
+ */
+struct Server *ReadServersFile(const char *path, unsigned int *servers_num) {
+  *servers_num = 0;
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot open servers file: %s\n", path);
+    return NULL;
+  }
+
+  struct Server *servers = NULL;  // Динамический массив серверов
+  char line[255];                 // Буфер для чтения строк
+
+  // Чтение файла построчно
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\n")] = 0;  // Удаление символа новой строки
+
+    if (strlen(line) == 0)  // Пропуск пустых строк
+      continue;
+
+    // Разбор строки формата "IP:port"
+    char *colon = strchr(line, ':');
+    if (colon == NULL) {
+      fprintf(stderr, "Invalid server format in line: %s\n", line);
+      continue;
+    }
+
+    *colon = '\0';  // Разделение строки на IP и порт
+    int port = atoi(colon + 1);  // Преобразование порта в число
+
+    // Проверка корректности номера порта
+    if (port <= 0) {
+      fprintf(stderr, "Invalid port in line: %s\n", line);
+      continue;
+    }
+
+    // Добавление сервера в динамический массив
+    struct Server *grown = realloc(servers, (*servers_num + 1) * sizeof(struct Server));
+    if (grown == NULL)
+      break;
+    servers = grown;
+    // Безопасное копирование IP-адреса
+    strncpy(servers[*servers_num].ip, line, sizeof(servers[*servers_num].ip) - 1);
+    servers[*servers_num].ip[sizeof(servers[*servers_num].ip) - 1] = '\0';
+    servers[*servers_num].port = port;
+    (*servers_num)++;  // Увеличение счетчика серверов
+  }
+  fclose(file);
+
+  if (*servers_num == 0) {
+    fprintf(stderr, "No valid servers found in file: %s\n", path);
+    free(servers);
+    return NULL;
+  }
+  return servers;
+}
+
+/**
+ * Разрешение адреса сервера по IP или доменному имени (один раз на кластер)
+ */
+static bool ResolveServer(struct ServerWorker *worker) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;  // Используем IPv4
+  hints.ai_socktype = SOCK_STREAM;
+
+  char port[16];
+  snprintf(port, sizeof(port), "%d", worker->server.port);
+  struct addrinfo *addrs = NULL;
+  int err = getaddrinfo(worker->server.ip, port, &hints, &addrs);
+  if (err != 0) {
+    fprintf(stderr, "getaddrinfo failed with %s: %s\n", worker->server.ip, gai_strerror(err));
+    return false;
+  }
+  memcpy(&worker->addr, addrs->ai_addr, addrs->ai_addrlen);
+  worker->addr_len = addrs->ai_addrlen;
+  freeaddrinfo(addrs);
+  return true;
+}
+
+/**
+ * Подключение к серверу по разрешенному адресу
+ *
+ * @return сокет или -1
+ */
+static int ConnectServer(const struct ServerWorker *worker, int timeout_ms) {
+  int sck = socket(worker->addr.ss_family, SOCK_STREAM, 0);
+  if (sck < 0)
+    return -1;
+
+  // Таймауты на запись действуют и на connect, на чтение - внутри кадра
+  struct timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  setsockopt(sck, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  setsockopt(sck, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (connect(sck, (const struct sockaddr *)&worker->addr, worker->addr_len) < 0) {
+    fprintf(stderr, "Connection to %s:%d failed\n", worker->server.ip, worker->server.port);
+    close(sck);
+    return -1;
+  }
+
+  // Запросы маленькие и идут конвейером: отключаем алгоритм Нейгла;
+  // соединение живет между заданиями: keep-alive обнаружит его обрыв
+  int opt_val = 1;
+  setsockopt(sck, IPPROTO_TCP, TCP_NODELAY, &opt_val, sizeof(opt_val));
+  setsockopt(sck, SOL_SOCKET, SO_KEEPALIVE, &opt_val, sizeof(opt_val));
+  return sck;
+}
+
+/**
+ * Простаивающее соединение, в котором есть что читать, закрыто сервером
+ * (между заданиями сервер ничего не присылает)
+ */
+static bool IsConnectionStale(int fd) {
+  struct pollfd pfd = {fd, POLLIN, 0};
+  return poll(&pfd, 1, 0) != 0;
+}
+
+static bool JobFinished(const struct Cluster *cluster) {
+  return cluster->done_num == cluster->chunks_num || cluster->aborted || cluster->stop;
+}
+
+/**
+ * Выбор куска для сервера (под мьютексом кластера)
+ * Сначала - следующий невыданный кусок. Если таких нет - незавершенный
+ * кусок, выданный раньше всех: кусок отказавшего сервера (issued == 0)
+ * берет любой сервер, кусок отстающего (issued < MAX_ISSUES) - только
+ * простаивающий
+ *
+ * @return номер куска или -1, если брать нечего
+ */
+static long TakeChunk(struct Cluster *cluster, struct ServerWorker *worker) {
+  long idx = -1;
+  if (cluster->next < cluster->chunks_num) {
+    idx = (long)cluster->next++;
+  } else {
+    int max_issued = worker->inflight_num == 0 ? MAX_ISSUES : 1;
+    for (size_t i = 0; i < cluster->chunks_num; i++) {
+      struct Chunk *chunk = &cluster->chunks[i];
+      if (chunk->done || chunk->issued >= max_issued)
+        continue;
+      if (idx < 0 || chunk->issued < cluster->chunks[idx].issued ||
+          (chunk->issued == cluster->chunks[idx].issued &&
+           chunk->issue_time < cluster->chunks[idx].issue_time))
+        idx = (long)i;
+    }
+    if (idx >= 0 && cluster->chunks[idx].issued > 0)
+      worker->reissued++;
+  }
+  if (idx >= 0) {
+    cluster->chunks[idx].issued++;
+    cluster->chunks[idx].issue_time = NowNs();
+  }
+  return idx;
+}
+
+/**
+ * Прием ответа на кусок (под мьютексом кластера)
+ *
+ * @return false, если сервер прислал ответ не на свой запрос или отказ
+ */
+static bool CompleteChunk(struct Cluster *cluster, struct ServerWorker *worker,
+                          const struct FrameHeader *header, const uint8_t *payload) {
+  int pos = -1;
+  for (int i = 0; i < worker->inflight_num; i++) {
+    if (worker->inflight[i] == header->request_id)
+      pos = i;
+  }
+  if (pos < 0 || (header->opcode == OP_RESULT && header->length != RESULT_PAYLOAD_SIZE)) {
+    fprintf(stderr, "Unexpected frame from %s:%d\n", worker->server.ip, worker->server.port);
+    return false;
+  }
+  if (header->opcode != OP_RESULT) {
+    fprintf(stderr, "Server %s:%d rejected request %" PRIu64 "\n",
+            worker->server.ip, worker->server.port, header->request_id);
+    return false;
+  }
+
+  struct Chunk *chunk = &cluster->chunks[header->request_id];
+  worker->inflight_num--;
+  worker->inflight[pos] = worker->inflight[worker->inflight_num];
+  worker->inflight_time[pos] = worker->inflight_time[worker->inflight_num];
+  chunk->issued--;
+  worker->health.state = SERVER_HEALTHY;
+  worker->health.consecutive_failures = 0;
+  if (!chunk->done) {  // Повторный ответ на уже готовый кусок не нужен
+    chunk->done = true;
+    chunk->result = GetU64(payload);
+    cluster->done_num++;
+    worker->chunks_done++;
+    worker->numbers_done += chunk->end - chunk->begin + 1;
+    pthread_cond_broadcast(&cluster->cond);
+  }
+  return true;
+}
+
+/**
+ * Работа по соединению (под мьютексом кластера): дозаполнение конвейера
+ * кусками и прием ответов, пока задание не готово или соединение не отказало
+ *
+ * @return false при отказе сервера
+ */
+static bool RunSession(struct Cluster *cluster, struct ServerWorker *worker, uint8_t *frames) {
+  int sck = worker->fd;
+  while (!JobFinished(cluster)) {
+    // Дозаполнение конвейера новыми кусками. После отказа сервер проверяется
+    // одним запросом в полете, пока не ответит успешно
+    int pipeline = worker->health.consecutive_failures > 0 ? 1 : cluster->options.pipeline;
+    size_t frames_size = 0;
+    uint64_t now = NowNs();
+    while (worker->inflight_num < pipeline) {
+      long idx = TakeChunk(cluster, worker);
+      if (idx < 0)
+        break;
+      worker->inflight[worker->inflight_num] = (size_t)idx;
+      worker->inflight_time[worker->inflight_num] = now;
+      worker->inflight_num++;
+      struct FactorialArgs part = {cluster->chunks[idx].begin, cluster->chunks[idx].end,
+                                   cluster->mod};
+      frames_size += EncodeRangeRequest(frames + frames_size, (uint64_t)idx, &part);
+    }
+    if (worker->inflight_num == 0) {  // Все оставшиеся куски уже считаются
+      pthread_cond_wait(&cluster->cond, &cluster->mutex);
+      continue;
+    }
+
+    // Срок ответа отсчитывается от самого старого куска в полете
+    uint64_t oldest = worker->inflight_time[0];
+    for (int i = 1; i < worker->inflight_num; i++) {
+      if (worker->inflight_time[i] < oldest)
+        oldest = worker->inflight_time[i];
+    }
+    uint64_t deadline = oldest + (uint64_t)cluster->options.timeout_ms * 1000000ull;
+    pthread_mutex_unlock(&cluster->mutex);
+
+    // Отправка новых задач и получение одного ответа
+    struct FrameHeader header;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    bool io_ok = frames_size == 0 || SendAll(sck, frames, frames_size);
+    bool timeout = false;
+    if (io_ok) {
+      now = NowNs();
+      struct pollfd pfd = {sck, POLLIN, 0};
+      int wait_ms = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+      timeout = poll(&pfd, 1, wait_ms) == 0;
+      io_ok = !timeout && RecvFrame(sck, &header, payload, sizeof(payload));
+    }
+
+    pthread_mutex_lock(&cluster->mutex);
+    if (!io_ok) {
+      // Соединение разрывает ClusterFactorial, когда все готово, - это не отказ
+      if (!JobFinished(cluster)) {
+        fprintf(stderr, "Connection to %s:%d %s\n", worker->server.ip, worker->server.port,
+                timeout ? "timed out" : "lost");
+        if (timeout)
+          worker->health.timeouts++;
+      }
+      return false;
+    }
+    if (!CompleteChunk(cluster, worker, &header, payload))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Возврат кусков из конвейера в очередь (под мьютексом кластера). Отказ
+ * засчитывается куску, только если он был в полете один: иначе неизвестно,
+ * какой из запросов уронил сервер
+ */
+static void ReleaseInflight(struct Cluster *cluster, struct ServerWorker *worker, bool failed) {
+  bool blame = failed && worker->inflight_num == 1;
+  for (int i = 0; i < worker->inflight_num; i++) {
+    struct Chunk *chunk = &cluster->chunks[worker->inflight[i]];
+    chunk->issued--;
+    if (blame && !chunk->done && ++chunk->failures >= MAX_CHUNK_FAILURES) {
+      fprintf(stderr, "Range [%" PRIu64 ", %" PRIu64 "] failed on %d servers, giving up\n",
+              chunk->begin, chunk->end, chunk->failures);
+      cluster->aborted = true;
+    }
+  }
+  worker->inflight_num = 0;
+  pthread_cond_broadcast(&cluster->cond);
+}
+
+/**
+ * Закрытие соединения сервера (под мьютексом кластера)
+ */
+static void CloseConnection(struct Cluster *cluster, struct ServerWorker *worker) {
+  int sck = worker->fd;
+  worker->fd = -1;
+  pthread_mutex_unlock(&cluster->mutex);
+  close(sck);
+  pthread_mutex_lock(&cluster->mutex);
+}
+
+/**
+ * Отметка отказа в таблице здоровья (под мьютексом кластера)
+ */
+static void RecordFailure(struct Cluster *cluster, struct ServerWorker *worker) {
+  worker->health.failures++;
+  worker->health.consecutive_failures++;
+  worker->health.state = SERVER_SUSPECT;
+  if (worker->health.consecutive_failures >= cluster->options.retries) {
+    worker->health.state = SERVER_BLACKLISTED;
+    cluster->alive--;
+    pthread_cond_broadcast(&cluster->cond);
+    fprintf(stderr, "Server %s:%d blacklisted after %d failures in a row\n",
+            worker->server.ip, worker->server.port, worker->health.consecutive_failures);
+  }
+}
+
+/**
+ * Пауза перед переподключением: BACKOFF_BASE_MS * 2^(отказы подряд - 1),
+ * не больше BACKOFF_MAX_MS, плюс случайная добавка до половины паузы, чтобы
+ * клиенты не переподключались одновременно. Прерывается, если задание готово
+ */
+static void Backoff(struct Cluster *cluster, struct ServerWorker *worker) {
+  uint64_t delay_ms = BACKOFF_BASE_MS;
+  for (int i = 1; i < worker->health.consecutive_failures && delay_ms < BACKOFF_MAX_MS; i++)
+    delay_ms *= 2;
+  if (delay_ms > BACKOFF_MAX_MS)
+    delay_ms = BACKOFF_MAX_MS;
+  delay_ms += (uint64_t)rand_r(&worker->seed) % (delay_ms / 2 + 1);
+
+  struct timespec until;
+  clock_gettime(CLOCK_MONOTONIC, &until);
+  uint64_t ns = (uint64_t)until.tv_nsec + delay_ms * 1000000ull;
+  until.tv_sec += (time_t)(ns / 1000000000ull);
+  until.tv_nsec = (long)(ns % 1000000000ull);
+  while (!JobFinished(cluster) &&
+         pthread_cond_timedwait(&cluster->cond, &cluster->mutex, &until) != ETIMEDOUT) {
+  }
+}
+
+/**
+ * Участие сервера в текущем задании (под мьютексом кластера): подключение
+ * при необходимости, работа по соединению и переподключение после отказов,
+ * пока задание не готово или сервер не попал в черный список
+ */
+static void WorkOnJob(struct Cluster *cluster, struct ServerWorker *worker, uint8_t *frames) {
+  // Соединение, простоявшее между заданиями, мог закрыть сервер
+  if (worker->fd >= 0 && IsConnectionStale(worker->fd))
+    CloseConnection(cluster, worker);
+
+  while (!JobFinished(cluster) && worker->health.state != SERVER_BLACKLISTED) {
+    if (worker->fd < 0) {
+      if (worker->health.consecutive_failures > 0) {
+        Backoff(cluster, worker);
+        if (JobFinished(cluster))
+          break;
+      }
+      pthread_mutex_unlock(&cluster->mutex);
+      int sck = ConnectServer(worker, cluster->options.timeout_ms);
+      pthread_mutex_lock(&cluster->mutex);
+      if (sck < 0) {
+        RecordFailure(cluster, worker);
+        continue;
+      }
+      worker->fd = sck;
+      worker->health.connects++;
+    }
+
+    bool ok = RunSession(cluster, worker, frames);
+    bool failed = !ok && !JobFinished(cluster);
+    bool pending = worker->inflight_num > 0;
+    ReleaseInflight(cluster, worker, failed);
+    // Соединение остается для следующего задания, если в нем не ждут
+    // ответы на перевыданные куски
+    if (!ok || pending)
+      CloseConnection(cluster, worker);
+    if (failed)
+      RecordFailure(cluster, worker);
+  }
+}
+
+/**
+ * Долгоживущий поток сервера: ждет задания и участвует в каждом
+ *
+ * @param args - указатель на структуру ServerWorker
+ * @return NULL (результаты сохраняются в кусках кластера)
+ */
+static void *ProcessServer(void *args) {
+  struct ServerWorker *worker = (struct ServerWorker *)args;
+  struct Cluster *cluster = worker->cluster;
+  size_t frame_size = FRAME_HEADER_SIZE + RANGE_PAYLOAD_SIZE;
+  uint8_t *frames = malloc(frame_size * (size_t)cluster->options.pipeline);
+
+  pthread_mutex_lock(&cluster->mutex);
+  while (!cluster->stop) {
+    if (!worker->busy) {
+      pthread_cond_wait(&cluster->cond, &cluster->mutex);
+      continue;
+    }
+    if (frames != NULL)
+      WorkOnJob(cluster, worker, frames);
+    worker->busy = false;
+    cluster->busy--;
+    pthread_cond_broadcast(&cluster->cond);
+  }
+  pthread_mutex_unlock(&cluster->mutex);
+  free(frames);
+  return NULL;
+}
+
+/**
+ * Открытие кластера: разрешение адресов и запуск потоков серверов
+ * Соединения устанавливаются при первом задании
+ *
+ * @return 0 при успехе, -1 при ошибке
+ */
+int ClusterInit(struct Cluster *cluster, const struct Server *servers,
+                unsigned int servers_num, const struct ClusterOptions *options) {
+  memset(cluster, 0, sizeof(*cluster));
+  cluster->servers_num = servers_num;
+  cluster->options = *options;
+  cluster->workers = calloc(servers_num, sizeof(struct ServerWorker));
+  cluster->threads = calloc(servers_num, sizeof(pthread_t));
+  size_t *inflight = calloc((size_t)servers_num * options->pipeline, sizeof(size_t));
+  uint64_t *inflight_time = calloc((size_t)servers_num * options->pipeline, sizeof(uint64_t));
+  if (cluster->workers == NULL || cluster->threads == NULL || inflight == NULL ||
+      inflight_time == NULL) {
+    free(cluster->workers);
+    free(cluster->threads);
+    free(inflight);
+    free(inflight_time);
+    return -1;
+  }
+
+  pthread_mutex_init(&cluster->mutex, NULL);
+  // Паузы между переподключениями отсчитываются по монотонным часам
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cluster->cond, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+
+  uint64_t now = NowNs();
+  for (unsigned int i = 0; i < servers_num; i++) {
+    struct ServerWorker *worker = &cluster->workers[i];
+    worker->server = servers[i];
+    worker->cluster = cluster;
+    worker->fd = -1;
+    worker->inflight = inflight + (size_t)i * options->pipeline;
+    worker->inflight_time = inflight_time + (size_t)i * options->pipeline;
+    worker->health.state = ResolveServer(worker) ? SERVER_HEALTHY : SERVER_UNRESOLVED;
+    worker->seed = (unsigned int)(now ^ i);
+  }
+
+  for (unsigned int i = 0; i < servers_num; i++) {
+    if (pthread_create(&cluster->threads[i], NULL, ProcessServer, &cluster->workers[i])) {
+      fprintf(stderr, "Error creating thread for server %s:%d\n",
+              servers[i].ip, servers[i].port);
+      cluster->servers_num = i;  // Останавливаются только запущенные потоки
+      ClusterDestroy(cluster);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Вычисление k! mod mod на кластере: нарезка [1, k] на chunks_num кусков
+ * (0 - CHUNKS_PER_SERVER на сервер) и ожидание всех ответов
+ * Статистика серверов по заданию остается в cluster->workers до следующего
+ *
+ * @return false, если задание не удалось досчитать (все серверы в черном
+ *         списке или кусок превысил предел отказов)
+ */
+bool ClusterFactorial(struct Cluster *cluster, uint64_t k, uint64_t mod,
+                      uint64_t chunks_num, uint64_t *result) {
+  if (chunks_num == 0)
+    chunks_num = (uint64_t)cluster->servers_num * CHUNKS_PER_SERVER;
+  if (chunks_num > k)
+    chunks_num = k;  // Пустых кусков не бывает
+  struct Chunk *chunks = calloc(chunks_num, sizeof(struct Chunk));
+  if (chunks == NULL) {
+    fprintf(stderr, "Out of memory for chunks\n");
+    return false;
+  }
+
+  // Вычисление распределения чисел между кусками
+  uint64_t numbers_per_chunk = k / chunks_num;  // Базовое количество на кусок
+  uint64_t remainder = k % chunks_num;          // Остаток для равномерного распределения
+  uint64_t current_begin = 1;                   // Начало первого диапазона
+  for (uint64_t i = 0; i < chunks_num; i++) {
+    uint64_t numbers_for_this_chunk = numbers_per_chunk + (i < remainder ? 1 : 0);
+    chunks[i].begin = current_begin;
+    chunks[i].end = current_begin + numbers_for_this_chunk - 1;
+    current_begin += numbers_for_this_chunk;  // Сдвиг начала для следующего куска
+  }
+
+  pthread_mutex_lock(&cluster->mutex);
+  cluster->job++;
+  cluster->chunks = chunks;
+  cluster->chunks_num = chunks_num;
+  cluster->next = 0;
+  cluster->done_num = 0;
+  cluster->aborted = false;
+  cluster->mod = mod;
+  cluster->alive = 0;
+  for (unsigned int i = 0; i < cluster->servers_num; i++) {
+    struct ServerWorker *worker = &cluster->workers[i];
+    worker->chunks_done = 0;
+    worker->numbers_done = 0;
+    worker->reissued = 0;
+    if (worker->health.state == SERVER_UNRESOLVED)
+      continue;
+    // Сервер из черного списка получает одну попытку: следующий отказ
+    // вернет его туда
+    if (worker->health.state == SERVER_BLACKLISTED) {
+      worker->health.state = SERVER_SUSPECT;
+      worker->health.consecutive_failures = cluster->options.retries - 1;
+    }
+    worker->busy = true;
+    cluster->busy++;
+    cluster->alive++;
+  }
+  pthread_cond_broadcast(&cluster->cond);
+
+  // Ожидание готовности всех кусков (или отказа всех серверов)
+  while (!JobFinished(cluster) && cluster->alive > 0)
+    pthread_cond_wait(&cluster->cond, &cluster->mutex);
+  if (!JobFinished(cluster))
+    cluster->aborted = true;  // Серверов не осталось: потоки выходят из задания
+  // Ответы на повторно выданные куски больше не нужны: разрываем такие
+  // соединения, чтобы потоки не ждали отстающие серверы
+  for (unsigned int i = 0; i < cluster->servers_num; i++) {
+    if (cluster->workers[i].fd >= 0 && cluster->workers[i].inflight_num > 0)
+      shutdown(cluster->workers[i].fd, SHUT_RDWR);
+  }
+  while (cluster->busy > 0)
+    pthread_cond_wait(&cluster->cond, &cluster->mutex);
+
+  // СБОР И ОБЪЕДИНЕНИЕ РЕЗУЛЬТАТОВ (без всех кусков ответ был бы неверным)
+  bool ok = cluster->done_num == cluster->chunks_num;
+  if (ok) {
+    uint64_t total = 1 % mod;  // Нейтральный элемент для умножения
+    for (size_t i = 0; i < cluster->chunks_num; i++)
+      total = MultModulo(total, cluster->chunks[i].result, mod);
+    *result = total;
+  } else {
+    fprintf(stderr, "Computation failed: %zu of %zu chunks computed\n",
+            cluster->done_num, cluster->chunks_num);
+  }
+  cluster->chunks = NULL;
+  pthread_mutex_unlock(&cluster->mutex);
+  free(chunks);
+  return ok;
+}
+
+/**
+ * Остановка потоков и закрытие соединений
+ */
+void ClusterDestroy(struct Cluster *cluster) {
+  pthread_mutex_lock(&cluster->mutex);
+  cluster->stop = true;
+  pthread_cond_broadcast(&cluster->cond);
+  pthread_mutex_unlock(&cluster->mutex);
+
+  for (unsigned int i = 0; i < cluster->servers_num; i++)
+    pthread_join(cluster->threads[i], NULL);
+  for (unsigned int i = 0; i < cluster->servers_num; i++) {
+    if (cluster->workers[i].fd >= 0)
+      close(cluster->workers[i].fd);
+  }
+
+  pthread_mutex_destroy(&cluster->mutex);
+  pthread_cond_destroy(&cluster->cond);
+  free(cluster->workers[0].inflight);
+  free(cluster->workers[0].inflight_time);
+  free(cluster->workers);
+  free(cluster->threads);
+}
@@ -0,0 +1,128 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "common.h"
+
+/**
+ * Клиентская библиотека распределенного вычисления факториала
+ *
+ * Кластер - набор серверов с долгоживущим потоком и постоянным соединением
+ * на каждый. Адреса разрешаются один раз при открытии кластера, соединения
+ * переиспользуются между кусками и между заданиями: последовательные
+ * вызовы ClusterFactorial не платят за рукопожатие TCP и за разрешение имен.
+ *
+ * Задание нарезается на куски, серверы берут их из общей очереди по мере
+ * освобождения места в конвейере, отстающие куски перевыдаются простаивающим
+ * серверам. Отказы (обрыв, ошибка, ответ дольше timeout_ms) возвращают куски
+ * в очередь, сервер переподключается с растущей паузой и после retries
+ * отказов подряд попадает в черный список; в начале следующего задания
+ * такой сервер получает одну попытку восстановиться.
+ */
+
+// Кусков на сервер по умолчанию
+#define CHUNKS_PER_SERVER 16
+
+/**
+ * Параметры кластера
+ */
+struct ClusterOptions {
+  int pipeline;     // Запросов в полете на одно соединение
+  int timeout_ms;   // Предел ожидания ответа на кусок
+  int retries;      // Отказов подряд до черного списка
+};
+
+/**
+ * Кусок диапазона [1, k] - единица работы планировщика
+ */
+struct Chunk {
+  uint64_t begin;
+  uint64_t end;
+  uint64_t result;       // Ответ сервера, когда done
+  bool done;
+  int issued;            // На скольких серверах кусок считается сейчас
+  int failures;          // Отказы серверов, на которых кусок был в полете
+  uint64_t issue_time;   // Время последней выдачи (для выбора отстающих)
+};
+
+/**
+ * Состояние сервера в таблице здоровья
+ */
+enum ServerState {
+  SERVER_HEALTHY,      // Последний запрос успешен
+  SERVER_SUSPECT,      // Были отказы подряд, сервер переподключается
+  SERVER_BLACKLISTED,  // retries отказов подряд: до следующего задания не используется
+  SERVER_UNRESOLVED    // Адрес не разрешился при открытии кластера
+};
+
+/**
+ * Строка таблицы здоровья сервера (накапливается за все задания)
+ */
+struct ServerHealth {
+  enum ServerState state;
+  int consecutive_failures;  // Отказы подряд (сбрасывается успешным ответом)
+  uint64_t failures;         // Все отказы
+  uint64_t timeouts;         // Из них ответы дольше timeout_ms
+  uint64_t connects;         // Установленные соединения
+};
+
+struct Cluster;
+
+/**
+ * Состояние потока одного сервера
+ */
+struct ServerWorker {
+  struct Server server;              // Информация о сервере (IP и порт)
+  struct Cluster *cluster;
+  struct sockaddr_storage addr;      // Адрес, разрешенный при открытии
+  socklen_t addr_len;
+  int fd;                            // Постоянное соединение (-1, если нет)
+  size_t *inflight;                  // Куски, отправленные и еще не полученные
+  uint64_t *inflight_time;           // Время отправки каждого из них
+  int inflight_num;
+  bool busy;                         // Поток работает над текущим заданием
+  uint64_t chunks_done;              // Куски текущего задания по ответам сервера
+  uint64_t numbers_done;             // Числа в этих кусках
+  uint64_t reissued;                 // Куски, взятые повторно у отстающих серверов
+  struct ServerHealth health;
+  unsigned int seed;                 // Для случайной добавки к паузе
+};
+
+/**
+ * Кластер серверов и очередь кусков текущего задания
+ */
+struct Cluster {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;       // Новое задание, готовый кусок или отказ сервера
+  struct ServerWorker *workers;
+  pthread_t *threads;
+  unsigned int servers_num;
+  struct ClusterOptions options;
+  bool stop;                 // Кластер закрывается
+
+  // Текущее задание
+  uint64_t job;              // Номер задания (0 - заданий еще не было)
+  struct Chunk *chunks;
+  size_t chunks_num;
+  size_t next;               // Первый еще не выданный кусок
+  size_t done_num;           // Готовые куски
+  int alive;                 // Серверы не в черном списке
+  int busy;                  // Потоки, еще работающие над заданием
+  bool aborted;              // Кусок превысил предел отказов
+  uint64_t mod;
+};
+
+struct Server *ReadServersFile(const char *path, unsigned int *servers_num);
+
+int ClusterInit(struct Cluster *cluster, const struct Server *servers,
+                unsigned int servers_num, const struct ClusterOptions *options);
+bool ClusterFactorial(struct Cluster *cluster, uint64_t k, uint64_t mod,
+                      uint64_t chunks_num, uint64_t *result);
+void ClusterDestroy(struct Cluster *cluster);
+
+#endif
@@ -6,31 +6,185 @@
 #include <errno.h>
 #include <stdlib.h>
 
+// 128-битное целое - расширение GCC/Clang, отсюда __extension__ при -pedantic
+__extension__ typedef unsigned __int128 uint128_t;
+
 /**
- * Умножение двух чисел по модулю 
+ * Умножение двух чисел по модулю
+ * Произведение вычисляется целиком в 128 битах и делится один раз
  */
 uint64_t MultModulo(uint64_t a, uint64_t b, uint64_t mod) {
-    uint64_t result = 0;
-    a = a % mod;
-    while (b > 0) {
-        if (b % 2 == 1)
-            result = (result + a) % mod;
-        a = (a * 2) % mod;
-        b /= 2;
+    return (uint64_t)(((uint128_t)a * b) % mod);
+}
+
+/**
+ * Редукция Монтгомери: T * 2^-64 mod m для T < m * 2^64
+ * q подбирается так, что младшие 64 бита q*m и T совпадают,
+ * поэтому (T - q*m) / 2^64 равно разности старших половин
+ */
+static inline uint64_t MontRedc(const struct ModContext *ctx, uint128_t t) {
+    uint64_t q = (uint64_t)t * ctx->inv;
+    uint64_t hi = (uint64_t)(t >> 64);
+    uint64_t qm_hi = (uint64_t)(((uint128_t)q * ctx->mod) >> 64);
+    uint64_t res = hi - qm_hi;
+    if (hi < qm_hi)
+        res += ctx->mod;
+    return res;
+}
+
+/**
+ * Подготовка контекста для модуля mod (mod > 0)
+ */
+void ModContextInit(struct ModContext *ctx, uint64_t mod) {
+    ctx->mod = mod;
+    ctx->inv = 0;
+    ctx->r1 = 0;
+    ctx->r2 = 0;
+
+    if (mod % 2 == 1) {
+        ctx->kind = MOD_MONTGOMERY;
+        // Обратный к mod по модулю 2^64 методом Ньютона:
+        // каждая итерация удваивает число верных бит (mod * mod = 1 mod 8)
+        uint64_t inv = mod;
+        for (int i = 0; i < 5; i++)
+            inv *= 2 - mod * inv;
+        ctx->inv = inv;
+        ctx->r1 = (0 - mod) % mod;  // 2^64 mod mod
+        ctx->r2 = (uint64_t)(((uint128_t)ctx->r1 * ctx->r1) % mod);
+    } else if (mod <= UINT32_MAX) {
+        ctx->kind = MOD_NATIVE;
+    } else {
+        ctx->kind = MOD_WIDE;
+    }
+}
+
+/**
+ * Умножение по модулю контекста для чисел в обычном представлении
+ */
+uint64_t ModMul(const struct ModContext *ctx, uint64_t a, uint64_t b) {
+    uint64_t mod = ctx->mod;
+    if (a >= mod)
+        a %= mod;
+    if (b >= mod)
+        b %= mod;
+
+    switch (ctx->kind) {
+    case MOD_NATIVE:
+        return a * b % mod;
+    case MOD_MONTGOMERY:
+        // a*b*2^-64, затем умножение на 2^128 и еще одна редукция дают a*b
+        return MontRedc(ctx, (uint128_t)MontRedc(ctx, (uint128_t)a * b) * ctx->r2);
+    default:
+        return (uint64_t)(((uint128_t)a * b) % mod);
     }
-    return result % mod;
+}
+
+/**
+ * Возведение в степень по модулю контекста
+ */
+uint64_t ModPow(const struct ModContext *ctx, uint64_t base, uint64_t exp) {
+    if (ctx->kind == MOD_MONTGOMERY) {
+        // Все промежуточные значения остаются в представлении Монтгомери
+        uint64_t x = MontRedc(ctx, (uint128_t)(base % ctx->mod) * ctx->r2);
+        uint64_t res = ctx->r1;  // Единица в представлении Монтгомери
+        while (exp > 0) {
+            if (exp & 1)
+                res = MontRedc(ctx, (uint128_t)res * x);
+            x = MontRedc(ctx, (uint128_t)x * x);
+            exp >>= 1;
+        }
+        return MontRedc(ctx, res);
+    }
+
+    uint64_t res = 1 % ctx->mod;
+    base %= ctx->mod;
+    while (exp > 0) {
+        if (exp & 1)
+            res = ModMul(ctx, res, base);
+        base = ModMul(ctx, base, base);
+        exp >>= 1;
+    }
+    return res;
+}
+
+/**
+ * Произведение begin * (begin+1) * ... * end по модулю контекста (begin <= end)
+ *
+ * Числа раздаются по кругу RANGE_CHAINS независимым цепочкам умножений,
+ * которые объединяются в конце: процессор перекрывает их задержки, и число
+ * обходится в такт пропускной способности умножителя, а не в полную задержку.
+ * Для нечетного модуля каждое число умножается одной редукцией Монтгомери
+ * без перевода в представление: результат цепочек из n умножений равен
+ * произведению, умноженному на 2^(-64n), что исправляется одним ModPow в конце.
+ * Для четного модуля остатки чисел ведутся инкрементно,
+ * поэтому деление остается одно на умножение.
+ */
+uint64_t ModRangeProduct(const struct ModContext *ctx, uint64_t begin, uint64_t end) {
+    uint64_t mod = ctx->mod;
+    if (begin == 0)
+        return 0;  // В диапазоне есть ноль
+    uint64_t count = end - begin + 1;
+    uint64_t acc[RANGE_CHAINS];
+    for (int j = 0; j < RANGE_CHAINS; j++)
+        acc[j] = 1 % mod;
+
+    if (ctx->kind == MOD_MONTGOMERY) {
+        // acc < mod и i < 2^64, поэтому acc * i < mod * 2^64 - условие MontRedc
+        uint64_t i = begin;
+        uint64_t left = count;
+        for (; left >= RANGE_CHAINS; left -= RANGE_CHAINS, i += RANGE_CHAINS) {
+            for (int j = 0; j < RANGE_CHAINS; j++)
+                acc[j] = MontRedc(ctx, (uint128_t)acc[j] * (i + j));
+        }
+        for (int j = 0; left > 0; left--, j++)
+            acc[j] = MontRedc(ctx, (uint128_t)acc[j] * (i + j));
+        uint64_t ans = ModPow(ctx, ctx->r1, count);
+        for (int j = 0; j < RANGE_CHAINS; j++)
+            ans = ModMul(ctx, ans, acc[j]);
+        return ans;
+    }
+
+    // Остатки текущих чисел цепочек и шаг остатка за один круг
+    uint64_t r[RANGE_CHAINS];
+    r[0] = begin % mod;
+    for (int j = 1; j < RANGE_CHAINS; j++)
+        r[j] = r[j - 1] + 1 == mod ? 0 : r[j - 1] + 1;
+    uint64_t step = RANGE_CHAINS % mod;
+    uint64_t left = count;
+    for (; left >= RANGE_CHAINS; left -= RANGE_CHAINS) {
+        for (int j = 0; j < RANGE_CHAINS; j++) {
+            if (ctx->kind == MOD_NATIVE)
+                acc[j] = acc[j] * r[j] % mod;
+            else
+                acc[j] = (uint64_t)(((uint128_t)acc[j] * r[j]) % mod);
+            // r + step < 2 * mod: одного вычитания достаточно
+            r[j] = r[j] >= mod - step ? r[j] - (mod - step) : r[j] + step;
+        }
+    }
+    for (int j = 0; left > 0; left--, j++)
+        acc[j] = ModMul(ctx, acc[j], r[j]);
+    uint64_t ans = acc[0];
+    for (int j = 1; j < RANGE_CHAINS; j++)
+        ans = ModMul(ctx, ans, acc[j]);
+    return ans;
 }
 
 /**
  * Конвертация строки в uint64_t с проверкой ошибок
+ * Строка должна целиком состоять из десятичных цифр: пустая строка,
+ * знак (strtoull молча обращает "-5") и хвост вроде "12abc" отвергаются
  */
 bool ConvertStringToUI64(const char *str, uint64_t *val) {
+    if (*str < '0' || *str > '9')
+        return false;
+
     char *end = NULL;
+    errno = 0;  // strtoull не сбрасывает errno при успехе
     unsigned long long i = strtoull(str, &end, 10);
     if (errno == ERANGE) {
         return false;
     }
-    if (errno != 0)
+    if (errno != 0 || end == str || *end != '\0')
         return false;
 
     *val = i;
@@ -16,7 +16,35 @@ struct Server {
     int port;
 };
 
+/**
+ * Способ умножения по модулю, выбранный для конкретного mod
+ */
+enum ModKind {
+    MOD_NATIVE,      // Четный mod < 2^32: произведение помещается в 64 бита
+    MOD_WIDE,        // Четный mod >= 2^32: 128-битное произведение и остаток
+    MOD_MONTGOMERY   // Нечетный mod: представление Монтгомери, без делений
+};
+
+/**
+ * Контекст умножения по фиксированному модулю
+ * Готовится один раз на весь диапазон и переиспользуется на каждом умножении
+ */
+struct ModContext {
+    uint64_t mod;
+    enum ModKind kind;
+    uint64_t inv;    // mod^-1 по модулю 2^64 (для Монтгомери)
+    uint64_t r2;     // 2^128 mod mod: перевод в представление Монтгомери
+    uint64_t r1;     // 2^64 mod mod: поправка множителя 2^-64 после цепочки умножений
+};
+
+// Независимых цепочек умножений в ModRangeProduct
+#define RANGE_CHAINS 4
+
 uint64_t MultModulo(uint64_t a, uint64_t b, uint64_t mod);
+void ModContextInit(struct ModContext *ctx, uint64_t mod);
+uint64_t ModMul(const struct ModContext *ctx, uint64_t a, uint64_t b);
+uint64_t ModPow(const struct ModContext *ctx, uint64_t base, uint64_t exp);
+uint64_t ModRangeProduct(const struct ModContext *ctx, uint64_t begin, uint64_t end);
 bool ConvertStringToUI64(const char *str, uint64_t *val);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,625 @@
+/**
+ * event_loop.c - Неблокирующий слой соединений сервера на основе epoll
+ *
+ * Один поток мультиплексирует все клиентские сокеты: принимает соединения,
+ * накапливает запросы из частичных чтений, передает полные запросы
+ * обработчику (пулу потоков) и отправляет готовые результаты.
+ * Соединение говорит либо кадровым протоколом (protocol.h) с конвейером
+ * запросов, либо старым форматом без заголовков.
+ * Рабочие потоки возвращают результаты через очередь и eventfd,
+ * поэтому сокеты трогает только поток цикла событий.
+ */
+
+#include "event_loop.h"
+#include "log.h"
+#include "metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "protocol.h"
+
+// Размер запроса: 3 числа uint64_t (begin, end, mod)
+#define REQUEST_SIZE (sizeof(uint64_t) * 3)
+// Предел входного буфера соединения: при заполнении чтение приостанавливается
+#define INPUT_LIMIT 4096
+// Количество событий, забираемых за один вызов epoll_wait
+#define MAX_EVENTS 256
+// Предел запросов одного соединения в обработке (кадровый протокол)
+#define PIPELINE_LIMIT 256
+// Пауза приема после ошибки accept, не связанной с клиентом (EMFILE, ENFILE)
+#define ACCEPT_RETRY_NS 100000000
+
+/**
+ * Протокол соединения, определяется по первому сообщению
+ */
+enum Protocol {
+  PROTO_UNKNOWN,
+  PROTO_LEGACY,   // 24 байта запроса, 8 байт ответа, ответы строго по порядку
+  PROTO_FRAMED    // Кадры с request_id, ответы в порядке готовности
+};
+
+/**
+ * Состояние одного клиентского соединения
+ */
+struct Connection {
+  int fd;                  // Сокет клиента (-1 после закрытия)
+  uint32_t events;         // Текущая маска событий в epoll
+  char in[INPUT_LIMIT];    // Накопленные, но еще не разобранные байты
+  size_t in_len;
+  char *out;               // Байты ответа, ожидающие отправки
+  size_t out_len;
+  size_t out_sent;
+  size_t out_cap;
+  enum Protocol proto;     // Протокол соединения
+  int pending;             // Запросы в обработке
+  bool read_closed;        // Клиент закрыл передачу
+  bool dead;               // Сокет закрыт, ждем завершения запросов
+  struct Connection *next_free;  // Связь в списке на освобождение
+};
+
+// Метки для отличия служебных дескрипторов от соединений в epoll
+static int listen_tag;
+static int wake_tag;
+
+int SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0)
+    return -1;
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * Поднятие мягкого лимита открытых файлов до жесткого,
+ * чтобы цикл мог держать тысячи соединений
+ */
+static void RaiseFileLimit(void) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int EventLoopInit(struct EventLoop *loop, int listen_fd,
+                  RequestHandler handler, void *handler_ctx) {
+  RaiseFileLimit();
+
+  loop->listen_fd = listen_fd;
+  loop->handler = handler;
+  loop->handler_ctx = handler_ctx;
+  loop->done_head = NULL;
+  loop->graveyard = NULL;
+  loop->connections = 0;
+  loop->accept_paused = false;
+  loop->accept_failing = false;
+
+  if (SetNonBlocking(listen_fd) < 0) {
+    perror("fcntl");
+    return -1;
+  }
+
+  loop->epoll_fd = epoll_create1(0);
+  if (loop->epoll_fd < 0) {
+    perror("epoll_create1");
+    return -1;
+  }
+
+  loop->wake_fd = eventfd(0, EFD_NONBLOCK);
+  if (loop->wake_fd < 0) {
+    perror("eventfd");
+    close(loop->epoll_fd);
+    return -1;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = &listen_tag;
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+    perror("epoll_ctl");
+    EventLoopDestroy(loop);
+    return -1;
+  }
+  ev.events = EPOLLIN;
+  ev.data.ptr = &wake_tag;
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) < 0) {
+    perror("epoll_ctl");
+    EventLoopDestroy(loop);
+    return -1;
+  }
+
+  pthread_mutex_init(&loop->done_mutex, NULL);
+  return 0;
+}
+
+void EventLoopDestroy(struct EventLoop *loop) {
+  close(loop->wake_fd);
+  close(loop->epoll_fd);
+  pthread_mutex_destroy(&loop->done_mutex);
+}
+
+/**
+ * Возврат результата запроса в цикл событий (вызывается из рабочих потоков)
+ */
+void EventLoopComplete(struct Request *req) {
+  struct EventLoop *loop = req->loop;
+  pthread_mutex_lock(&loop->done_mutex);
+  req->next = loop->done_head;
+  loop->done_head = req;
+  pthread_mutex_unlock(&loop->done_mutex);
+
+  uint64_t one = 1;
+  if (write(loop->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    perror("eventfd write");
+}
+
+/**
+ * Освобождение откладывается до конца итерации цикла: в текущей пачке
+ * событий еще могут быть события этого соединения
+ */
+static void FreeConnection(struct EventLoop *loop, struct Connection *conn) {
+  conn->next_free = loop->graveyard;
+  loop->graveyard = conn;
+  loop->connections--;
+}
+
+static void ReleaseGraveyard(struct EventLoop *loop) {
+  while (loop->graveyard != NULL) {
+    struct Connection *conn = loop->graveyard;
+    loop->graveyard = conn->next_free;
+    free(conn->out);
+    free(conn);
+  }
+}
+
+/**
+ * Возврат слушающего сокета в epoll после паузы приема
+ */
+static void ResumeAccept(struct EventLoop *loop) {
+  if (!loop->accept_paused)
+    return;
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = &listen_tag;
+  epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, loop->listen_fd, &ev);
+  loop->accept_paused = false;
+}
+
+/**
+ * Пауза приема: сокет остается готовым к чтению, и без снятия EPOLLIN
+ * epoll_wait возвращался бы к нему сразу же
+ */
+static void PauseAccept(struct EventLoop *loop) {
+  struct epoll_event ev;
+  ev.events = 0;
+  ev.data.ptr = &listen_tag;
+  epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, loop->listen_fd, &ev);
+  loop->accept_paused = true;
+  loop->accept_resume_ns = MetricsNowNs() + ACCEPT_RETRY_NS;
+}
+
+/**
+ * Закрытие сокета; память освобождается, когда завершатся все запросы
+ * Освободившийся дескриптор сразу возвращает прием после EMFILE
+ */
+static void CloseConnection(struct EventLoop *loop, struct Connection *conn) {
+  if (conn->fd >= 0) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+    MetricsAdd(METRIC_CONNECTIONS_CLOSED, 1);
+    ResumeAccept(loop);
+  }
+  conn->dead = true;
+  if (conn->pending == 0)
+    FreeConnection(loop, conn);
+}
+
+/**
+ * Приведение маски epoll к состоянию соединения:
+ * чтение - пока есть место во входном буфере, запись - пока есть неотправленный ответ
+ */
+static void UpdateInterest(struct EventLoop *loop, struct Connection *conn) {
+  uint32_t events = 0;
+  if (!conn->read_closed && conn->in_len < INPUT_LIMIT)
+    events |= EPOLLIN;
+  if (conn->out_sent < conn->out_len)
+    events |= EPOLLOUT;
+  if (events == conn->events)
+    return;
+
+  struct epoll_event ev;
+  ev.events = events;
+  ev.data.ptr = conn;
+  epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+  conn->events = events;
+}
+
+/**
+ * Отправка накопленного ответа, сколько примет сокет
+ *
+ * @return false, если соединение нужно закрыть
+ */
+static bool FlushOutput(struct Connection *conn) {
+  while (conn->out_sent < conn->out_len) {
+    ssize_t sent = send(conn->fd, conn->out + conn->out_sent,
+                        conn->out_len - conn->out_sent, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      if (errno == EINTR)
+        continue;
+      LOG(LOG_LEVEL_WARN, "Can't send data to client");
+      return false;
+    }
+    conn->out_sent += (size_t)sent;
+    MetricsAdd(METRIC_BYTES_SENT, (uint64_t)sent);
+  }
+  conn->out_len = 0;
+  conn->out_sent = 0;
+  return true;
+}
+
+static bool AppendOutput(struct Connection *conn, const void *data, size_t size) {
+  if (conn->out_len + size > conn->out_cap) {
+    size_t cap = conn->out_cap ? conn->out_cap * 2 : 64;
+    while (cap < conn->out_len + size)
+      cap *= 2;
+    char *out = realloc(conn->out, cap);
+    if (out == NULL)
+      return false;
+    conn->out = out;
+    conn->out_cap = cap;
+  }
+  memcpy(conn->out + conn->out_len, data, size);
+  conn->out_len += size;
+  return true;
+}
+
+/**
+ * Передача запроса обработчику
+ *
+ * @return false при нехватке памяти
+ */
+static bool StartHandler(struct EventLoop *loop, struct Connection *conn, uint64_t id,
+                         uint64_t begin, uint64_t end, uint64_t mod) {
+  struct Request *req = malloc(sizeof(struct Request));
+  if (req == NULL) {
+    LOG(LOG_LEVEL_ERROR, "Out of memory for request");
+    return false;
+  }
+  req->args.begin = begin;
+  req->args.end = end;
+  req->args.mod = mod;
+  req->id = id;
+  req->result = 0;
+  req->conn = conn;
+  req->loop = loop;
+  req->start_ns = MetricsNowNs();
+  req->next = NULL;
+
+  conn->pending++;
+  MetricsAdd(METRIC_REQUESTS, 1);
+  loop->handler(req, loop->handler_ctx);
+  return true;
+}
+
+static void ConsumeInput(struct Connection *conn, size_t size) {
+  conn->in_len -= size;
+  memmove(conn->in, conn->in + size, conn->in_len);
+}
+
+/**
+ * Разбор запросов старого формата
+ * Старый протокол не содержит идентификаторов, поэтому ответы должны идти
+ * в порядке запросов: следующий запрос соединения запускается после ответа на предыдущий
+ */
+static bool DispatchLegacy(struct EventLoop *loop, struct Connection *conn) {
+  while (conn->pending == 0 && conn->in_len >= REQUEST_SIZE) {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    uint64_t mod = 0;
+    memcpy(&begin, conn->in, sizeof(uint64_t));
+    memcpy(&end, conn->in + sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&mod, conn->in + 2 * sizeof(uint64_t), sizeof(uint64_t));
+    ConsumeInput(conn, REQUEST_SIZE);
+
+    LOG(LOG_LEVEL_INFO, "Receive: %" PRIu64 " %" PRIu64 " %" PRIu64, begin, end, mod);
+
+    if (mod == 0 || end < begin) {
+      MetricsAdd(METRIC_REQUEST_ERRORS, 1);
+      LOG(LOG_LEVEL_WARN, "Client send invalid range or module");
+      return false;
+    }
+    if (!StartHandler(loop, conn, 0, begin, end, mod))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Разбор кадров: запросы запускаются сразу, не дожидаясь ответов на предыдущие
+ * Ошибки отдельного запроса возвращаются кадром OP_ERROR, соединение остается
+ */
+static bool DispatchFramed(struct EventLoop *loop, struct Connection *conn) {
+  while (conn->pending < PIPELINE_LIMIT && conn->in_len >= FRAME_HEADER_SIZE) {
+    struct FrameHeader header;
+    DecodeFrameHeader((const uint8_t *)conn->in, &header);
+    if (header.magic != PROTOCOL_MAGIC || header.length > FRAME_MAX_PAYLOAD) {
+      LOG(LOG_LEVEL_WARN, "Client send wrong frame");
+      MetricsAdd(METRIC_REQUEST_ERRORS, 1);
+      return false;
+    }
+    size_t frame_size = FRAME_HEADER_SIZE + header.length;
+    if (conn->in_len < frame_size)
+      break;  // Кадр пришел не целиком
+
+    const uint8_t *payload = (const uint8_t *)conn->in + FRAME_HEADER_SIZE;
+    uint32_t error = 0;
+    uint64_t begin = 0, end = 0, mod = 0;
+    if (header.version != PROTOCOL_VERSION) {
+      error = ERR_BAD_VERSION;
+    } else if (header.opcode != OP_RANGE) {
+      error = ERR_BAD_OPCODE;
+    } else if (header.length != RANGE_PAYLOAD_SIZE) {
+      error = ERR_BAD_REQUEST;
+    } else {
+      begin = GetU64(payload);
+      end = GetU64(payload + 8);
+      mod = GetU64(payload + 16);
+      LOG(LOG_LEVEL_INFO, "Receive: %" PRIu64 " %" PRIu64 " %" PRIu64 " (id %" PRIu64 ")",
+          begin, end, mod, header.request_id);
+      if (mod == 0 || end < begin)
+        error = ERR_BAD_REQUEST;
+    }
+    ConsumeInput(conn, frame_size);
+
+    if (error != 0) {
+      MetricsAdd(METRIC_REQUEST_ERRORS, 1);
+      uint8_t frame[FRAME_HEADER_SIZE + ERROR_PAYLOAD_SIZE];
+      size_t size = EncodeError(frame, header.request_id, error);
+      if (!AppendOutput(conn, frame, size))
+        return false;
+      continue;
+    }
+    if (!StartHandler(loop, conn, header.request_id, begin, end, mod))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Разбор полных запросов из входного буфера и передача их обработчику
+ * Протокол соединения определяется по первым байтам
+ *
+ * @return false, если клиент прислал некорректные данные
+ */
+static bool DispatchRequests(struct EventLoop *loop, struct Connection *conn) {
+  if (conn->proto == PROTO_UNKNOWN) {
+    if (conn->in_len < 8)
+      return true;
+    conn->proto = IsFramePrefix((const uint8_t *)conn->in) ? PROTO_FRAMED : PROTO_LEGACY;
+  }
+  if (conn->proto == PROTO_FRAMED)
+    return DispatchFramed(loop, conn);
+  return DispatchLegacy(loop, conn);
+}
+
+/**
+ * Ответ на запрос в протоколе соединения
+ */
+static bool AppendResult(struct Connection *conn, const struct Request *req) {
+  if (conn->proto == PROTO_FRAMED) {
+    uint8_t frame[FRAME_HEADER_SIZE + RESULT_PAYLOAD_SIZE];
+    size_t size = EncodeResult(frame, req->id, req->result);
+    return AppendOutput(conn, frame, size);
+  }
+  return AppendOutput(conn, &req->result, sizeof(req->result));
+}
+
+/**
+ * Чтение всех доступных данных из сокета с разбором запросов
+ */
+static void HandleReadable(struct EventLoop *loop, struct Connection *conn) {
+  while (conn->in_len < INPUT_LIMIT) {
+    ssize_t nread = recv(conn->fd, conn->in + conn->in_len,
+                         INPUT_LIMIT - conn->in_len, 0);
+    if (nread > 0) {
+      conn->in_len += (size_t)nread;
+      MetricsAdd(METRIC_BYTES_RECEIVED, (uint64_t)nread);
+      continue;
+    }
+    if (nread == 0) {  // Клиент закрыл соединение
+      conn->read_closed = true;
+      break;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    if (errno == EINTR)
+      continue;
+    LOG(LOG_LEVEL_WARN, "Client read failed");
+    CloseConnection(loop, conn);
+    return;
+  }
+
+  if (!DispatchRequests(loop, conn)) {
+    CloseConnection(loop, conn);
+    return;
+  }
+
+  // Клиент ушел и ответить больше нечего
+  if (conn->read_closed && conn->pending == 0 && conn->out_len == 0) {
+    if (conn->in_len > 0)
+      LOG(LOG_LEVEL_WARN, "Client send wrong data format");
+    CloseConnection(loop, conn);
+    return;
+  }
+  UpdateInterest(loop, conn);
+}
+
+static void HandleWritable(struct EventLoop *loop, struct Connection *conn) {
+  if (!FlushOutput(conn)) {
+    CloseConnection(loop, conn);
+    return;
+  }
+  if (conn->read_closed && conn->pending == 0 && conn->out_len == 0) {
+    CloseConnection(loop, conn);
+    return;
+  }
+  UpdateInterest(loop, conn);
+}
+
+/**
+ * Прием всех ожидающих соединений
+ * При нехватке дескрипторов или памяти прием приостанавливается
+ * на ACCEPT_RETRY_NS, а ошибка пишется в журнал один раз
+ */
+static void AcceptConnections(struct EventLoop *loop) {
+  while (true) {
+    struct sockaddr_in client;
+    socklen_t client_len = sizeof(client);
+    int client_fd = accept(loop->listen_fd, (struct sockaddr *)&client, &client_len);
+    if (client_fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        loop->accept_failing = false;
+        return;
+      }
+      if (!loop->accept_failing)
+        LOG(LOG_LEVEL_WARN, "Could not establish new connection: %s", strerror(errno));
+      loop->accept_failing = true;
+      PauseAccept(loop);
+      return;
+    }
+
+    // Ответы маленькие: отключаем алгоритм Нейгла ради задержки
+    int opt_val = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &opt_val, sizeof(opt_val));
+
+    struct Connection *conn = calloc(1, sizeof(struct Connection));
+    if (conn == NULL || SetNonBlocking(client_fd) < 0) {
+      LOG(LOG_LEVEL_WARN, "Could not set up new connection");
+      free(conn);
+      close(client_fd);
+      continue;
+    }
+    conn->fd = client_fd;
+    conn->events = EPOLLIN;
+
+    struct epoll_event ev;
+    ev.events = conn->events;
+    ev.data.ptr = conn;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+      perror("epoll_ctl");
+      free(conn);
+      close(client_fd);
+      continue;
+    }
+    loop->connections++;
+    MetricsAdd(METRIC_CONNECTIONS_OPENED, 1);
+  }
+}
+
+/**
+ * Отправка результатов, которые вернули рабочие потоки
+ */
+static void HandleCompletions(struct EventLoop *loop) {
+  uint64_t counter;
+  if (read(loop->wake_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+    perror("eventfd read");
+
+  pthread_mutex_lock(&loop->done_mutex);
+  struct Request *req = loop->done_head;
+  loop->done_head = NULL;
+  pthread_mutex_unlock(&loop->done_mutex);
+
+  while (req != NULL) {
+    struct Request *next = req->next;
+    struct Connection *conn = req->conn;
+    conn->pending--;
+    MetricsObserve(METRIC_REQUEST_TIME, MetricsNowNs() - req->start_ns);
+
+    if (conn->dead) {  // Клиент отключился, пока шло вычисление
+      if (conn->pending == 0)
+        FreeConnection(loop, conn);
+    } else if (!AppendResult(conn, req) || !DispatchRequests(loop, conn) ||
+               !FlushOutput(conn)) {
+      CloseConnection(loop, conn);
+    } else if (conn->read_closed && conn->pending == 0 && conn->out_len == 0) {
+      CloseConnection(loop, conn);
+    } else {
+      UpdateInterest(loop, conn);
+    }
+
+    free(req);
+    req = next;
+  }
+}
+
+/**
+ * Основной цикл сервера; возвращает управление только при ошибке epoll
+ */
+int EventLoopRun(struct EventLoop *loop) {
+  struct epoll_event events[MAX_EVENTS];
+
+  while (true) {
+    int timeout_ms = -1;
+    if (loop->accept_paused) {
+      uint64_t now = MetricsNowNs();
+      timeout_ms = now < loop->accept_resume_ns
+                       ? (int)((loop->accept_resume_ns - now + 999999) / 1000000)
+                       : 0;
+    }
+    int n = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      return -1;
+    }
+    if (loop->accept_paused && MetricsNowNs() >= loop->accept_resume_ns)
+      ResumeAccept(loop);
+
+    for (int i = 0; i < n; i++) {
+      void *ptr = events[i].data.ptr;
+      if (ptr == &listen_tag) {
+        AcceptConnections(loop);
+        continue;
+      }
+      if (ptr == &wake_tag) {
+        HandleCompletions(loop);
+        continue;
+      }
+
+      struct Connection *conn = (struct Connection *)ptr;
+      uint32_t ev = events[i].events;
+      if (conn->dead)  // Закрыто при обработке предыдущих событий пачки
+        continue;
+      // Клиент закрыл соединение полностью: ответы доставить некуда
+      if (ev & (EPOLLERR | EPOLLHUP)) {
+        CloseConnection(loop, conn);
+        continue;
+      }
+      if (ev & EPOLLIN)
+        HandleReadable(loop, conn);
+      // Соединение могло быть закрыто при чтении
+      if (!conn->dead && (ev & EPOLLOUT))
+        HandleWritable(loop, conn);
+    }
+    ReleaseGraveyard(loop);
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+struct Connection;
+struct EventLoop;
+
+/**
+ * Один запрос клиента, переданный на вычисление
+ * Обработчик обязан ровно один раз вызвать EventLoopComplete для запроса
+ */
+struct Request {
+  struct FactorialArgs args;  // Диапазон и модуль из запроса
+  uint64_t id;                // request_id кадра (в старом протоколе не используется)
+  uint64_t result;            // Результат, заполняется обработчиком
+  struct Connection *conn;    // Соединение, которому принадлежит запрос
+  struct EventLoop *loop;     // Цикл, в который вернется результат
+  uint64_t start_ns;          // Момент разбора запроса (MetricsNowNs)
+  struct Request *next;       // Связь в очереди завершенных запросов
+};
+
+/**
+ * Обработчик запроса: запускает вычисление (например, в пуле потоков)
+ * и не должен блокировать поток цикла событий
+ */
+typedef void (*RequestHandler)(struct Request *req, void *ctx);
+
+/**
+ * Однопоточный цикл событий на epoll, обслуживающий все соединения сервера
+ */
+struct EventLoop {
+  int epoll_fd;               // Дескриптор epoll
+  int listen_fd;              // Слушающий сокет (неблокирующий)
+  int wake_fd;                // eventfd для пробуждения при завершении запросов
+  RequestHandler handler;     // Обработчик запросов
+  void *handler_ctx;          // Контекст обработчика
+  pthread_mutex_t done_mutex; // Защищает очередь завершенных запросов
+  struct Request *done_head;  // Завершенные запросы, ожидающие отправки
+  struct Connection *graveyard;  // Закрытые соединения, освобождаемые после итерации
+  size_t connections;         // Количество открытых соединений
+  bool accept_paused;         // Слушающий сокет снят с EPOLLIN после ошибки accept
+  bool accept_failing;        // Ошибка accept уже в журнале, пока очередь не разобрана
+  uint64_t accept_resume_ns;  // Когда вернуть EPOLLIN (MetricsNowNs)
+};
+
+int EventLoopInit(struct EventLoop *loop, int listen_fd,
+                  RequestHandler handler, void *handler_ctx);
+int EventLoopRun(struct EventLoop *loop);
+void EventLoopComplete(struct Request *req);
+void EventLoopDestroy(struct EventLoop *loop);
+
+int SetNonBlocking(int fd);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * factorial.c - Анализ модуля перед вычислением произведения диапазона
+ *
+ * Перед перемножением диапазон [begin, end] сводится к более дешевому плану:
+ * - если в диапазоне есть число, кратное mod, ответ 0 без вычислений;
+ * - иначе числа диапазона заменяются остатками (диапазон не длиннее mod);
+ * - для простого mod, когда диапазон покрывает большую часть [1, p-1],
+ *   по теореме Вильсона (p-1)! = -1 перемножается дополнение диапазона,
+ *   а ответ получается обратным элементом.
+ */
+
+#include "factorial.h"
+
+#include <stddef.h>
+
+/**
+ * Детерминированный тест Миллера-Рабина для 64-битных чисел
+ * Набор оснований Джима Синклера дает верный ответ для всех n < 2^64
+ */
+bool IsPrime64(uint64_t n) {
+  static const uint64_t small_primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  static const uint64_t bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+
+  if (n < 2)
+    return false;
+  for (size_t i = 0; i < sizeof(small_primes) / sizeof(small_primes[0]); i++) {
+    if (n == small_primes[i])
+      return true;
+    if (n % small_primes[i] == 0)
+      return false;
+  }
+
+  // n - 1 = d * 2^s, d нечетное
+  uint64_t d = n - 1;
+  int s = 0;
+  while (d % 2 == 0) {
+    d /= 2;
+    s++;
+  }
+
+  struct ModContext ctx;
+  ModContextInit(&ctx, n);
+  for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+    uint64_t a = bases[i] % n;
+    if (a == 0)
+      continue;
+    uint64_t x = ModPow(&ctx, a, d);
+    if (x == 1 || x == n - 1)
+      continue;
+    bool composite = true;
+    for (int r = 1; r < s && composite; r++) {
+      x = ModMul(&ctx, x, x);
+      if (x == n - 1)
+        composite = false;
+    }
+    if (composite)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Построение плана вычисления begin * ... * end mod mod (begin <= end, mod > 0)
+ */
+void PlanFactorial(const struct FactorialArgs *args, struct FactorialPlan *plan) {
+  uint64_t mod = args->mod;
+  plan->mod = mod;
+  plan->zero = false;
+  plan->prime = false;
+  plan->invert = false;
+  plan->negate = false;
+  plan->ranges_num = 0;
+
+  // Диапазон длиной не меньше mod (или весь uint64_t) содержит кратное mod
+  uint64_t count = args->end - args->begin + 1;
+  if (mod == 1 || count == 0 || count >= mod) {
+    plan->zero = true;
+    return;
+  }
+
+  // Диапазон короче mod: остатки идут подряд, если не перешли через кратное mod
+  uint64_t b = args->begin % mod;
+  uint64_t e = args->end % mod;
+  if (b == 0 || e < b) {
+    plan->zero = true;
+    return;
+  }
+
+  plan->ranges_num = 1;
+  plan->ranges[0].begin = b;
+  plan->ranges[0].end = e;
+  plan->ranges[0].power = 1;
+
+  plan->prime = IsPrime64(mod);
+  if (!plan->prime)
+    return;
+
+  // b * ... * e = (p-1)! / ((b-1)! * (e+1) * ... * (p-1)), а по отражению
+  // (e+1) * ... * (p-1) = (-1)^y * y!, где y = p-1-e. С учетом (p-1)! = -1:
+  // b * ... * e = (-1)^(y+1) * ((b-1)! * y!)^-1
+  uint64_t x = b - 1;
+  uint64_t y = mod - 1 - e;
+  uint64_t lo = x < y ? x : y;
+  uint64_t hi = x < y ? y : x;
+  // Обратный элемент стоит около 2 * 64 умножений (ModPow)
+  if (hi + 128 >= e - b + 1)
+    return;
+
+  // (b-1)! * y! = (lo!)^2 * (lo+1) * ... * hi
+  plan->invert = true;
+  plan->negate = (y % 2 == 0);
+  plan->ranges_num = 0;
+  if (lo > 0) {
+    plan->ranges[plan->ranges_num].begin = 1;
+    plan->ranges[plan->ranges_num].end = lo;
+    plan->ranges[plan->ranges_num].power = 2;
+    plan->ranges_num++;
+  }
+  if (hi > lo) {
+    plan->ranges[plan->ranges_num].begin = lo + 1;
+    plan->ranges[plan->ranges_num].end = hi;
+    plan->ranges[plan->ranges_num].power = 1;
+    plan->ranges_num++;
+  }
+}
+
+/**
+ * Сведение произведений диапазонов плана (products[i] для ranges[i]) в ответ
+ */
+uint64_t FinishFactorialPlan(const struct FactorialPlan *plan, const struct ModContext *ctx,
+                             const uint64_t *products) {
+  if (plan->zero)
+    return 0;
+
+  uint64_t total = 1 % plan->mod;
+  for (int i = 0; i < plan->ranges_num; i++) {
+    uint64_t value = products[i];
+    if (plan->ranges[i].power == 2)
+      value = ModMul(ctx, value, value);
+    total = ModMul(ctx, total, value);
+  }
+  // Все множители меньше простого p, поэтому total != 0 и обратный существует
+  if (plan->invert)
+    total = ModPow(ctx, total, plan->mod - 2);
+  if (plan->negate)
+    total = (plan->mod - total) % plan->mod;
+  return total;
+}
+
+/**
+ * Последовательное вычисление произведения диапазона по плану
+ */
+uint64_t FactorialAnalyzed(const struct FactorialArgs *args) {
+  struct FactorialPlan plan;
+  PlanFactorial(args, &plan);
+  if (plan.zero)
+    return 0;
+
+  struct ModContext ctx;
+  ModContextInit(&ctx, plan.mod);
+  uint64_t products[PLAN_MAX_RANGES];
+  for (int i = 0; i < plan.ranges_num; i++)
+    products[i] = ModRangeProduct(&ctx, plan.ranges[i].begin, plan.ranges[i].end);
+  return FinishFactorialPlan(&plan, &ctx, products);
+}
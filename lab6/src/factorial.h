@@ -0,0 +1,44 @@
+#ifndef FACTORIAL_H
+#define FACTORIAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Максимум диапазонов в плане вычисления
+#define PLAN_MAX_RANGES 2
+
+/**
+ * Диапазон плана: в ответ входит (begin * ... * end)^power
+ */
+struct PlanRange {
+  uint64_t begin;
+  uint64_t end;
+  int power;
+};
+
+/**
+ * План вычисления произведения диапазона после анализа модуля
+ *
+ * result = sign * (произведение диапазонов в своих степенях), а при invert -
+ * sign * (то же произведение)^-1. Диапазоны перемножаются как обычно
+ * (в том числе параллельно), затем результаты сводятся FinishFactorialPlan.
+ */
+struct FactorialPlan {
+  uint64_t mod;
+  bool zero;                  // Ответ заведомо 0, перемножать ничего не нужно
+  bool prime;                 // Модуль простой
+  bool invert;                // Ответ - обратный элемент (отражение Вильсона)
+  bool negate;                // Ответ берется с минусом
+  int ranges_num;
+  struct PlanRange ranges[PLAN_MAX_RANGES];
+};
+
+bool IsPrime64(uint64_t n);
+void PlanFactorial(const struct FactorialArgs *args, struct FactorialPlan *plan);
+uint64_t FinishFactorialPlan(const struct FactorialPlan *plan, const struct ModContext *ctx,
+                             const uint64_t *products);
+uint64_t FactorialAnalyzed(const struct FactorialArgs *args);
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * flaky_server.c - Ненадежный сервер для проверки отказоустойчивости клиента
+ * Использование: ./flaky_server --port 20001 [--drop-rate 0.2] [--hang-rate 0.05]
+ *                               [--delay-ms 0] [--seed 1]
+ *
+ * Говорит на кадровом протоколе, как настоящий сервер, но на каждый запрос:
+ * - с вероятностью drop-rate разрывает соединение без ответа;
+ * - с вероятностью hang-rate перестает отвечать на этом соединении
+ *   (клиент должен сработать по таймауту);
+ * - иначе ждет случайное время до delay-ms и отвечает верным результатом.
+ * Каждое соединение обслуживает свой поток, произведение считается сразу
+ * в нем: скорость здесь не важна.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // nanosleep и rand_r при -std=c99
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "common.h"    // Умножение по модулю
+#include "protocol.h"  // Кадровый протокол
+
+/**
+ * Параметры отказов и состояние одного соединения
+ */
+struct FlakyConnection {
+  int fd;
+  double drop_rate;
+  double hang_rate;
+  int delay_ms;
+  unsigned int seed;
+};
+
+static double RandomUnit(unsigned int *seed) {
+  return (double)rand_r(seed) / ((double)RAND_MAX + 1.0);
+}
+
+static void SleepMs(int ms) {
+  struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+/**
+ * Обслуживание одного соединения до разрыва
+ */
+static void *ServeConnection(void *args) {
+  struct FlakyConnection *conn = (struct FlakyConnection *)args;
+  struct FrameHeader header;
+  uint8_t payload[FRAME_MAX_PAYLOAD];
+  uint8_t answer[FRAME_HEADER_SIZE + RESULT_PAYLOAD_SIZE];
+  bool hang = false;
+
+  while (RecvFrame(conn->fd, &header, payload, sizeof(payload))) {
+    if (hang)  // Запросы читаются, но ответов больше не будет
+      continue;
+
+    double roll = RandomUnit(&conn->seed);
+    if (roll < conn->drop_rate) {
+      printf("Dropping connection on request %llu\n", (unsigned long long)header.request_id);
+      break;
+    }
+    if (roll < conn->drop_rate + conn->hang_rate) {
+      printf("Hanging connection on request %llu\n", (unsigned long long)header.request_id);
+      hang = true;
+      continue;
+    }
+    if (conn->delay_ms > 0)
+      SleepMs(rand_r(&conn->seed) % (conn->delay_ms + 1));
+
+    size_t size;
+    struct FactorialArgs range = {GetU64(payload), GetU64(payload + 8), GetU64(payload + 16)};
+    if (header.opcode != OP_RANGE || header.length != RANGE_PAYLOAD_SIZE || range.mod == 0 ||
+        range.begin == 0 || range.begin > range.end) {
+      size = EncodeError(answer, header.request_id, ERR_BAD_REQUEST);
+    } else {
+      struct ModContext ctx;
+      ModContextInit(&ctx, range.mod);
+      size = EncodeResult(answer, header.request_id,
+                          ModRangeProduct(&ctx, range.begin, range.end));
+    }
+    if (!SendAll(conn->fd, answer, size))
+      break;
+  }
+
+  close(conn->fd);
+  free(conn);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  int port = -1;
+  double drop_rate = 0.2;   // Доля запросов, на которых рвется соединение
+  double hang_rate = 0.0;   // Доля запросов, после которых соединение молчит
+  int delay_ms = 0;         // Наибольшая случайная задержка ответа
+  unsigned int seed = (unsigned int)time(NULL);
+
+  // ПАРСИНГ АРГУМЕНТОВ КОМАНДНОЙ СТРОКИ
+
+  while (true) {
+    static struct option options[] = {
+      {"port", required_argument, 0, 0},       // Порт сервера
+      {"drop-rate", required_argument, 0, 0},  // Вероятность разрыва
+      {"hang-rate", required_argument, 0, 0},  // Вероятность зависания
+      {"delay-ms", required_argument, 0, 0},   // Наибольшая задержка ответа
+      {"seed", required_argument, 0, 0},       // Начальное значение генератора
+      {0, 0, 0, 0}
+    };
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+
+    if (c == -1)
+      break;
+
+    switch (c) {
+    case 0: {
+      switch (option_index) {
+      case 0:  // --port
+        port = atoi(optarg);
+        if (port <= 0) {
+          fprintf(stderr, "Port must be positive number\n");
+          return 1;
+        }
+        break;
+      case 1:  // --drop-rate
+        drop_rate = atof(optarg);
+        if (drop_rate < 0 || drop_rate > 1) {
+          fprintf(stderr, "Drop rate must be in [0, 1]\n");
+          return 1;
+        }
+        break;
+      case 2:  // --hang-rate
+        hang_rate = atof(optarg);
+        if (hang_rate < 0 || hang_rate > 1) {
+          fprintf(stderr, "Hang rate must be in [0, 1]\n");
+          return 1;
+        }
+        break;
+      case 3:  // --delay-ms
+        delay_ms = atoi(optarg);
+        if (delay_ms < 0) {
+          fprintf(stderr, "Delay must be non-negative number\n");
+          return 1;
+        }
+        break;
+      case 4:  // --seed
+        seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      default:
+        printf("Index %d is out of options\n", option_index);
+      }
+    } break;
+
+    case '?':
+      printf("Unknown argument\n");
+      break;
+    default:
+      fprintf(stderr, "getopt returned character code 0%o?\n", c);
+    }
+  }
+
+  if (port == -1) {
+    fprintf(stderr, "Using: %s --port 20001 [--drop-rate 0.2] [--hang-rate 0.05] "
+            "[--delay-ms 0] [--seed 1]\n", argv[0]);
+    return 1;
+  }
+
+  // НАСТРОЙКА СЕРВЕРНОГО СОКЕТА
+
+  int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    fprintf(stderr, "Can not create server socket!");
+    return 1;
+  }
+  int opt_val = 1;
+  setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+
+  struct sockaddr_in server;
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_port = htons((uint16_t)port);
+  server.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(server_fd, (struct sockaddr *)&server, sizeof(server)) < 0 ||
+      listen(server_fd, 128) < 0) {
+    fprintf(stderr, "Can not bind to port %d\n", port);
+    return 1;
+  }
+  printf("Flaky server listening at %d (drop %.2f, hang %.2f, delay up to %d ms)\n",
+         port, drop_rate, hang_rate, delay_ms);
+  fflush(stdout);
+
+  // ПРИЕМ СОЕДИНЕНИЙ: поток на каждое
+
+  while (true) {
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0)
+      continue;
+    struct FlakyConnection *conn = malloc(sizeof(*conn));
+    if (conn == NULL) {
+      close(client_fd);
+      continue;
+    }
+    conn->fd = client_fd;
+    conn->drop_rate = drop_rate;
+    conn->hang_rate = hang_rate;
+    conn->delay_ms = delay_ms;
+    conn->seed = seed + (unsigned int)rand_r(&seed);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ServeConnection, conn) != 0) {
+      close(client_fd);
+      free(conn);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+}
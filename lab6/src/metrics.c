@@ -0,0 +1,299 @@
+/**
+ * metrics.c - Шарды метрик по потокам и HTTP-выдача в формате Prometheus
+ */
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime и open_memstream при -std=c99
+
+#include "metrics.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "log.h"
+
+// Пауза перед новым accept, если он отказал не из-за сигнала или клиента
+#define ACCEPT_RETRY_NS 100000000
+
+struct HistogramData {
+  uint64_t buckets[METRICS_MAX_BUCKETS + 1];  // Не накопленные: последняя - +Inf
+  uint64_t sum;
+};
+
+/**
+ * Метрики одного потока; выравнивание исключает ложное разделение
+ * кэш-линий между потоками
+ */
+struct MetricsShard {
+  uint64_t counters[METRIC_COUNTERS];
+  struct HistogramData histograms[METRIC_HISTOGRAMS];
+} __attribute__((aligned(64)));
+
+// Последний шард - общий для потоков, которым не хватило своего
+static struct MetricsShard shards[METRICS_MAX_SHARDS + 1];
+static unsigned int shards_used = 0;
+static __thread struct MetricsShard *local_shard = NULL;
+
+struct CounterInfo {
+  const char *name;
+  const char *help;
+};
+
+static const struct CounterInfo counter_info[METRIC_COUNTERS] = {
+  {"factorial_requests_total", "Range requests accepted"},
+  {"factorial_request_errors_total", "Requests rejected with an error frame or a dropped connection"},
+  {"factorial_received_bytes_total", "Bytes read from client sockets"},
+  {"factorial_sent_bytes_total", "Bytes written to client sockets"},
+  {"factorial_connections_opened_total", "Client connections accepted"},
+  {"factorial_connections_closed_total", "Client connections closed"},
+  {"factorial_tasks_total", "Subrange tasks executed by the thread pool"},
+  {"factorial_cache_hits_total", "Blocks taken from the product cache"},
+  {"factorial_cache_misses_total", "Blocks computed because the product cache missed"},
+};
+
+struct HistogramInfo {
+  const char *name;
+  const char *help;
+  double scale;               // Делитель при выдаче (1e9: наносекунды в секунды)
+  int bounds_num;
+  uint64_t bounds[METRICS_MAX_BUCKETS];
+};
+
+#define NS_BOUNDS 14, {1000, 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, \
+                       50000000, 100000000, 500000000, 1000000000, 5000000000ull,  \
+                       10000000000ull}
+
+static const struct HistogramInfo histogram_info[METRIC_HISTOGRAMS] = {
+  {"factorial_range_size", "Numbers per range request", 1, 10,
+   {1, 16, 256, 4096, 65536, 1ull << 20, 1ull << 24, 1ull << 28, 1ull << 32, 1ull << 36}},
+  {"factorial_task_queue_wait_seconds", "Time a task waited in the pool queue", 1e9, NS_BOUNDS},
+  {"factorial_task_compute_seconds", "Time spent computing a task", 1e9, NS_BOUNDS},
+  {"factorial_request_duration_seconds", "Time from parsing a request to its answer", 1e9,
+   NS_BOUNDS},
+};
+
+uint64_t MetricsNowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static struct MetricsShard *LocalShard(void) {
+  if (local_shard == NULL) {
+    unsigned int idx = __atomic_fetch_add(&shards_used, 1, __ATOMIC_RELAXED);
+    local_shard = &shards[idx < METRICS_MAX_SHARDS ? idx : METRICS_MAX_SHARDS];
+  }
+  return local_shard;
+}
+
+/**
+ * Прибавление к ячейке шарда: у своего шарда писатель один, поэтому
+ * достаточно атомарной записи (читатель не увидит разорванное значение)
+ */
+static inline void Bump(struct MetricsShard *shard, uint64_t *slot, uint64_t value) {
+  if (shard == &shards[METRICS_MAX_SHARDS])
+    __atomic_fetch_add(slot, value, __ATOMIC_RELAXED);
+  else
+    __atomic_store_n(slot, *slot + value, __ATOMIC_RELAXED);
+}
+
+void MetricsAdd(enum MetricCounter counter, uint64_t value) {
+  struct MetricsShard *shard = LocalShard();
+  Bump(shard, &shard->counters[counter], value);
+}
+
+void MetricsObserve(enum MetricHistogram histogram, uint64_t value) {
+  const struct HistogramInfo *info = &histogram_info[histogram];
+  int bucket = 0;
+  while (bucket < info->bounds_num && value > info->bounds[bucket])
+    bucket++;
+
+  struct MetricsShard *shard = LocalShard();
+  struct HistogramData *data = &shard->histograms[histogram];
+  Bump(shard, &data->buckets[bucket], 1);
+  Bump(shard, &data->sum, value);
+}
+
+/**
+ * Сумма ячейки по всем шардам
+ */
+static uint64_t SumShards(size_t offset) {
+  unsigned int used = __atomic_load_n(&shards_used, __ATOMIC_RELAXED);
+  if (used > METRICS_MAX_SHARDS)
+    used = METRICS_MAX_SHARDS;
+  uint64_t sum = 0;
+  for (unsigned int i = 0; i < used; i++)
+    sum += __atomic_load_n((const uint64_t *)((const char *)&shards[i] + offset), __ATOMIC_RELAXED);
+  sum += __atomic_load_n((const uint64_t *)((const char *)&shards[METRICS_MAX_SHARDS] + offset),
+                         __ATOMIC_RELAXED);
+  return sum;
+}
+
+#define SHARD_OFFSET(field) ((size_t)((const char *)&shards[0].field - (const char *)&shards[0]))
+
+/**
+ * Текст всех метрик в формате экспозиции Prometheus
+ */
+static void RenderMetrics(FILE *out) {
+  uint64_t counters[METRIC_COUNTERS];
+  for (int c = 0; c < METRIC_COUNTERS; c++) {
+    counters[c] = SumShards(SHARD_OFFSET(counters[c]));
+    fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_info[c].name,
+            counter_info[c].help, counter_info[c].name, counter_info[c].name,
+            (unsigned long long)counters[c]);
+  }
+  uint64_t open = counters[METRIC_CONNECTIONS_OPENED] - counters[METRIC_CONNECTIONS_CLOSED];
+  fprintf(out, "# HELP factorial_connections_open Client connections currently open\n"
+               "# TYPE factorial_connections_open gauge\nfactorial_connections_open %llu\n",
+          (unsigned long long)open);
+
+  for (int h = 0; h < METRIC_HISTOGRAMS; h++) {
+    const struct HistogramInfo *info = &histogram_info[h];
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", info->name, info->help, info->name);
+    uint64_t cumulative = 0;
+    for (int b = 0; b <= info->bounds_num; b++) {
+      cumulative += SumShards(SHARD_OFFSET(histograms[h].buckets[b]));
+      if (b < info->bounds_num)
+        fprintf(out, "%s_bucket{le=\"%.9g\"} %llu\n", info->name,
+                (double)info->bounds[b] / info->scale, (unsigned long long)cumulative);
+      else
+        fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", info->name, (unsigned long long)cumulative);
+    }
+    // _count - сумма корзин, поэтому всегда совпадает с корзиной +Inf
+    fprintf(out, "%s_sum %.9g\n%s_count %llu\n", info->name,
+            (double)SumShards(SHARD_OFFSET(histograms[h].sum)) / info->scale,
+            info->name, (unsigned long long)cumulative);
+  }
+}
+
+static bool WriteAll(int fd, const char *buf, size_t size) {
+  while (size > 0) {
+    ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    buf += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+/**
+ * Ответ на один HTTP-запрос: GET /metrics (или /) - метрики, иначе 404
+ */
+static void AnswerScrape(int fd) {
+  char request[1024];
+  size_t len = 0;
+  while (len < sizeof(request) - 1) {
+    ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+    if (n <= 0)
+      break;
+    len += (size_t)n;
+    request[len] = '\0';
+    if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL)
+      break;
+  }
+  request[len] = '\0';
+
+  char *body = NULL;
+  size_t body_len = 0;
+  FILE *out = open_memstream(&body, &body_len);
+  if (out == NULL)
+    return;
+  const char *status = "200 OK";
+  if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+    RenderMetrics(out);
+  } else {
+    status = "404 Not Found";
+    fprintf(out, "Only GET /metrics is served\n");
+  }
+  fclose(out);
+
+  char header[256];
+  int header_len = snprintf(header, sizeof(header),
+                            "HTTP/1.0 %s\r\n"
+                            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                            "Content-Length: %zu\r\n"
+                            "Connection: close\r\n\r\n",
+                            status, body_len);
+  if (WriteAll(fd, header, (size_t)header_len))
+    WriteAll(fd, body, body_len);
+  free(body);
+}
+
+/**
+ * Поток HTTP-выдачи метрик: запросы редкие, обслуживаются по одному
+ * Постоянные ошибки accept (например, EMFILE) пишутся в журнал один раз
+ * и повторяются с паузой, чтобы поток не занимал ядро целиком
+ */
+static void *ServeMetrics(void *args) {
+  int listen_fd = *(int *)args;
+  free(args);
+  bool failing = false;
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (!failing)
+        LOG(LOG_LEVEL_WARN, "Metrics accept failed: %s", strerror(errno));
+      failing = true;
+      struct timespec pause = {0, ACCEPT_RETRY_NS};
+      nanosleep(&pause, NULL);
+      continue;
+    }
+    failing = false;
+    // Медленный клиент не должен надолго занимать поток
+    struct timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    AnswerScrape(fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+/**
+ * Запуск HTTP-выдачи метрик на 127.0.0.1:port в отдельном потоке
+ *
+ * @return 0 при успехе, -1 при ошибке
+ */
+int MetricsServe(int port) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    return -1;
+  int opt_val = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+
+  // Только локальный интерфейс: метрики не выставляются наружу
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int *arg = malloc(sizeof(int));
+  pthread_t thread;
+  if (arg == NULL || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listen_fd, 16) < 0) {
+    free(arg);
+    close(listen_fd);
+    return -1;
+  }
+  *arg = listen_fd;
+  if (pthread_create(&thread, NULL, ServeMetrics, arg) != 0) {
+    free(arg);
+    close(listen_fd);
+    return -1;
+  }
+  pthread_detach(thread);
+  return 0;
+}
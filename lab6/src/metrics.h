@@ -0,0 +1,52 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+/**
+ * Метрики сервера в текстовом формате Prometheus
+ *
+ * Каждый поток пишет в свой шард (выровненный по кэш-линии блок счетчиков),
+ * поэтому запись - обычное сложение без блокировок и без атомарных RMW.
+ * HTTP-поток метрик при запросе складывает шарды всех потоков.
+ * Потоки сверх METRICS_MAX_SHARDS делят один общий шард с атомарным сложением.
+ */
+
+// Шардов для потоков (цикл событий, пул, поток метрик)
+#define METRICS_MAX_SHARDS 256
+// Границ корзин гистограммы не больше этого (плюс корзина +Inf)
+#define METRICS_MAX_BUCKETS 16
+
+/**
+ * Счетчики (только растут)
+ */
+enum MetricCounter {
+  METRIC_REQUESTS,            // Принятые запросы диапазонов
+  METRIC_REQUEST_ERRORS,      // Отклоненные запросы (кадр OP_ERROR или разрыв)
+  METRIC_BYTES_RECEIVED,      // Байты, прочитанные из клиентских сокетов
+  METRIC_BYTES_SENT,          // Байты, отправленные клиентам
+  METRIC_CONNECTIONS_OPENED,
+  METRIC_CONNECTIONS_CLOSED,
+  METRIC_TASKS,               // Задачи, выполненные пулом
+  METRIC_CACHE_HITS,          // Блоки, взятые из кэша произведений
+  METRIC_CACHE_MISSES,        // Блоки, посчитанные заново при включенном кэше
+  METRIC_COUNTERS
+};
+
+/**
+ * Гистограммы
+ */
+enum MetricHistogram {
+  METRIC_RANGE_SIZE,          // Чисел в запросе
+  METRIC_QUEUE_WAIT,          // Ожидание задачи в очереди пула, нс
+  METRIC_COMPUTE_TIME,        // Вычисление задачи, нс
+  METRIC_REQUEST_TIME,        // От разбора запроса до готового ответа, нс
+  METRIC_HISTOGRAMS
+};
+
+uint64_t MetricsNowNs(void);
+void MetricsAdd(enum MetricCounter counter, uint64_t value);
+void MetricsObserve(enum MetricHistogram histogram, uint64_t value);
+int MetricsServe(int port);
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * pool.c - Пул рабочих потоков и защелка завершения
+ *
+ * Потоки создаются один раз при старте сервера и разбирают задачи
+ * из общей очереди, поэтому стоимость запроса не включает
+ * создание и уничтожение потоков.
+ */
+
+#include "pool.h"
+
+#include <stdlib.h>
+
+/**
+ * Основной цикл рабочего потока: ждет задачу, извлекает ее и выполняет
+ */
+static void *PoolWorker(void *arg) {
+  struct ThreadPool *pool = (struct ThreadPool *)arg;
+
+  while (true) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->head == NULL && !pool->stop)
+      pthread_cond_wait(&pool->cond, &pool->mutex);
+
+    if (pool->head == NULL) {  // Остановка и очередь пуста
+      pthread_mutex_unlock(&pool->mutex);
+      break;
+    }
+
+    struct Task *task = pool->head;
+    pool->head = task->next;
+    if (pool->head == NULL)
+      pool->tail = NULL;
+    pthread_mutex_unlock(&pool->mutex);
+
+    task->func(task);
+  }
+  return NULL;
+}
+
+/**
+ * Запуск tnum рабочих потоков
+ *
+ * @return 0 при успехе, -1 при ошибке создания потоков
+ */
+int ThreadPoolInit(struct ThreadPool *pool, int tnum) {
+  pool->threads = malloc(sizeof(pthread_t) * tnum);
+  if (pool->threads == NULL)
+    return -1;
+  pool->tnum = 0;
+  pool->head = NULL;
+  pool->tail = NULL;
+  pool->stop = false;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+
+  for (int i = 0; i < tnum; i++) {
+    if (pthread_create(&pool->threads[i], NULL, PoolWorker, pool)) {
+      ThreadPoolDestroy(pool);
+      return -1;
+    }
+    pool->tnum++;
+  }
+  return 0;
+}
+
+/**
+ * Постановка задачи в конец очереди
+ */
+void ThreadPoolSubmit(struct ThreadPool *pool, struct Task *task) {
+  task->next = NULL;
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->tail != NULL)
+    pool->tail->next = task;
+  else
+    pool->head = task;
+  pool->tail = task;
+  pthread_cond_signal(&pool->cond);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+/**
+ * Остановка пула: потоки дорабатывают оставшиеся задачи и завершаются
+ */
+void ThreadPoolDestroy(struct ThreadPool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (int i = 0; i < pool->tnum; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->cond);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool->threads);
+  pool->threads = NULL;
+  pool->tnum = 0;
+}
+
+void LatchInit(struct Latch *latch, int count, void (*on_zero)(struct Latch *)) {
+  pthread_mutex_init(&latch->mutex, NULL);
+  pthread_cond_init(&latch->cond, NULL);
+  latch->count = count;
+  latch->on_zero = on_zero;
+}
+
+/**
+ * Уменьшение счетчика; последний вызов будит ожидающий поток
+ * или вызывает on_zero (после него защелку трогать нельзя:
+ * обработчик может ее освободить)
+ */
+void LatchCountDown(struct Latch *latch) {
+  pthread_mutex_lock(&latch->mutex);
+  bool last = (--latch->count == 0);
+  if (last)
+    pthread_cond_broadcast(&latch->cond);
+  pthread_mutex_unlock(&latch->mutex);
+
+  if (last && latch->on_zero != NULL)
+    latch->on_zero(latch);
+}
+
+void LatchWait(struct Latch *latch) {
+  pthread_mutex_lock(&latch->mutex);
+  while (latch->count > 0)
+    pthread_cond_wait(&latch->cond, &latch->mutex);
+  pthread_mutex_unlock(&latch->mutex);
+}
+
+void LatchDestroy(struct Latch *latch) {
+  pthread_cond_destroy(&latch->cond);
+  pthread_mutex_destroy(&latch->mutex);
+}
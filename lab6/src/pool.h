@@ -0,0 +1,51 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * Задача для пула потоков.
+ * Структура встраивается в пользовательские данные (интрузивная очередь),
+ * поэтому постановка задачи в очередь не требует выделения памяти.
+ */
+struct Task {
+  void (*func)(struct Task *task);  // Функция, выполняемая рабочим потоком
+  struct Task *next;                // Следующая задача в очереди
+};
+
+/**
+ * Пул долгоживущих рабочих потоков с общей FIFO-очередью задач
+ */
+struct ThreadPool {
+  pthread_t *threads;      // Идентификаторы рабочих потоков
+  int tnum;                // Количество рабочих потоков
+  pthread_mutex_t mutex;   // Защищает очередь и флаг остановки
+  pthread_cond_t cond;     // Сигнал о появлении задач
+  struct Task *head;       // Начало очереди
+  struct Task *tail;       // Конец очереди
+  bool stop;               // Флаг завершения работы пула
+};
+
+/**
+ * Защелка завершения: когда счетчик опускается до нуля, ожидающий поток
+ * просыпается, а если задан on_zero - он вызывается в потоке,
+ * сделавшем последний отсчет (так результат возвращается без ожидания)
+ */
+struct Latch {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int count;
+  void (*on_zero)(struct Latch *latch);
+};
+
+int ThreadPoolInit(struct ThreadPool *pool, int tnum);
+void ThreadPoolSubmit(struct ThreadPool *pool, struct Task *task);
+void ThreadPoolDestroy(struct ThreadPool *pool);
+
+void LatchInit(struct Latch *latch, int count, void (*on_zero)(struct Latch *));
+void LatchCountDown(struct Latch *latch);
+void LatchWait(struct Latch *latch);
+void LatchDestroy(struct Latch *latch);
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * protocol.c - Кодирование кадров протокола и блокирующий обмен ими
+ */
+
+#include "protocol.h"
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+void PutU32(uint8_t *buf, uint32_t value) {
+  for (int i = 3; i >= 0; i--) {
+    buf[i] = (uint8_t)value;
+    value >>= 8;
+  }
+}
+
+void PutU64(uint8_t *buf, uint64_t value) {
+  for (int i = 7; i >= 0; i--) {
+    buf[i] = (uint8_t)value;
+    value >>= 8;
+  }
+}
+
+uint32_t GetU32(const uint8_t *buf) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++)
+    value = (value << 8) | buf[i];
+  return value;
+}
+
+uint64_t GetU64(const uint8_t *buf) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++)
+    value = (value << 8) | buf[i];
+  return value;
+}
+
+void EncodeFrameHeader(uint8_t *buf, uint8_t opcode, uint64_t request_id, uint32_t length) {
+  PutU32(buf, PROTOCOL_MAGIC);
+  buf[4] = PROTOCOL_VERSION;
+  buf[5] = opcode;
+  buf[6] = 0;  // Флаги зарезервированы
+  buf[7] = 0;
+  PutU64(buf + 8, request_id);
+  PutU32(buf + 16, length);
+}
+
+void DecodeFrameHeader(const uint8_t *buf, struct FrameHeader *header) {
+  header->magic = GetU32(buf);
+  header->version = buf[4];
+  header->opcode = buf[5];
+  header->flags = (uint16_t)((buf[6] << 8) | buf[7]);
+  header->request_id = GetU64(buf + 8);
+  header->length = GetU32(buf + 16);
+}
+
+/**
+ * Начинается ли поток с кадра (нужно не меньше 8 байт)
+ */
+bool IsFramePrefix(const uint8_t *buf) {
+  return GetU32(buf) == PROTOCOL_MAGIC && buf[6] == 0 && buf[7] == 0;
+}
+
+size_t EncodeRangeRequest(uint8_t *buf, uint64_t request_id, const struct FactorialArgs *args) {
+  EncodeFrameHeader(buf, OP_RANGE, request_id, RANGE_PAYLOAD_SIZE);
+  PutU64(buf + FRAME_HEADER_SIZE, args->begin);
+  PutU64(buf + FRAME_HEADER_SIZE + 8, args->end);
+  PutU64(buf + FRAME_HEADER_SIZE + 16, args->mod);
+  return FRAME_HEADER_SIZE + RANGE_PAYLOAD_SIZE;
+}
+
+size_t EncodeResult(uint8_t *buf, uint64_t request_id, uint64_t result) {
+  EncodeFrameHeader(buf, OP_RESULT, request_id, RESULT_PAYLOAD_SIZE);
+  PutU64(buf + FRAME_HEADER_SIZE, result);
+  return FRAME_HEADER_SIZE + RESULT_PAYLOAD_SIZE;
+}
+
+size_t EncodeError(uint8_t *buf, uint64_t request_id, uint32_t code) {
+  EncodeFrameHeader(buf, OP_ERROR, request_id, ERROR_PAYLOAD_SIZE);
+  PutU32(buf + FRAME_HEADER_SIZE, code);
+  return FRAME_HEADER_SIZE + ERROR_PAYLOAD_SIZE;
+}
+
+/**
+ * Запись/чтение ровно size байт на блокирующем сокете
+ */
+bool SendAll(int fd, const void *buf, size_t size) {
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t n = send(fd, (const char *)buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    sent += (size_t)n;
+  }
+  return true;
+}
+
+bool RecvAll(int fd, void *buf, size_t size) {
+  size_t got = 0;
+  while (got < size) {
+    ssize_t n = recv(fd, (char *)buf + got, size - got, 0);
+    if (n <= 0)
+      return false;
+    got += (size_t)n;
+  }
+  return true;
+}
+
+/**
+ * Чтение одного кадра; нагрузка длиннее capacity считается ошибкой протокола
+ */
+bool RecvFrame(int fd, struct FrameHeader *header, uint8_t *payload, size_t capacity) {
+  uint8_t buf[FRAME_HEADER_SIZE];
+  if (!RecvAll(fd, buf, sizeof(buf)))
+    return false;
+  DecodeFrameHeader(buf, header);
+  if (header->magic != PROTOCOL_MAGIC || header->length > capacity)
+    return false;
+  return RecvAll(fd, payload, header->length);
+}
@@ -0,0 +1,82 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * Кадровый протокол клиента и сервера (версия 1)
+ *
+ * Каждое сообщение - заголовок FRAME_HEADER_SIZE байт и полезная нагрузка
+ * длины length. Все поля передаются в сетевом порядке байт (big-endian):
+ *   magic (4) | version (1) | opcode (1) | flags (2) | request_id (8) | length (4)
+ * Клиент может отправить много запросов подряд по одному соединению,
+ * сервер отвечает по мере готовности в любом порядке, а ответ находится
+ * по request_id запроса.
+ *
+ * Старый формат (24 байта begin, end, mod без заголовка, ответ - 8 байт)
+ * сервер по-прежнему принимает: формат соединения определяется по первому
+ * сообщению - кадр начинается с magic и нулевых флагов. Старый запрос спутать
+ * с кадром можно только при begin < 2^48 с младшими байтами "FACT".
+ */
+
+#define PROTOCOL_MAGIC 0x46414354u  // "FACT"
+#define PROTOCOL_VERSION 1
+
+#define FRAME_HEADER_SIZE 20
+// Предел полезной нагрузки: кадр должен помещаться во входной буфер сервера
+#define FRAME_MAX_PAYLOAD 256
+
+// Полезная нагрузка запроса: begin, end, mod; ответа: результат
+#define RANGE_PAYLOAD_SIZE 24
+#define RESULT_PAYLOAD_SIZE 8
+#define ERROR_PAYLOAD_SIZE 4
+
+/**
+ * Тип сообщения
+ */
+enum Opcode {
+  OP_RANGE = 1,   // Запрос: произведение диапазона по модулю
+  OP_RESULT = 2,  // Ответ: результат запроса с тем же request_id
+  OP_ERROR = 3    // Ответ: запрос отклонен, в нагрузке код ошибки
+};
+
+/**
+ * Коды ошибок в ответе OP_ERROR
+ */
+enum ProtocolError {
+  ERR_BAD_VERSION = 1,  // Версия протокола не поддерживается
+  ERR_BAD_OPCODE = 2,   // Неизвестный тип сообщения
+  ERR_BAD_REQUEST = 3   // Некорректный диапазон, модуль или длина нагрузки
+};
+
+struct FrameHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t opcode;
+  uint16_t flags;
+  uint64_t request_id;
+  uint32_t length;
+};
+
+void PutU32(uint8_t *buf, uint32_t value);
+void PutU64(uint8_t *buf, uint64_t value);
+uint32_t GetU32(const uint8_t *buf);
+uint64_t GetU64(const uint8_t *buf);
+
+void EncodeFrameHeader(uint8_t *buf, uint8_t opcode, uint64_t request_id, uint32_t length);
+void DecodeFrameHeader(const uint8_t *buf, struct FrameHeader *header);
+bool IsFramePrefix(const uint8_t *buf);
+
+size_t EncodeRangeRequest(uint8_t *buf, uint64_t request_id, const struct FactorialArgs *args);
+size_t EncodeResult(uint8_t *buf, uint64_t request_id, uint64_t result);
+size_t EncodeError(uint8_t *buf, uint64_t request_id, uint32_t code);
+
+bool SendAll(int fd, const void *buf, size_t size);
+bool RecvAll(int fd, void *buf, size_t size);
+bool RecvFrame(int fd, struct FrameHeader *header, uint8_t *payload, size_t capacity);
+
+#endif
@@ -0,0 +1,250 @@
+/**
+ * range_kernel.c - Произведение диапазона на векторных аккумуляторах
+ * с выбором ядра по возможностям процессора
+ */
+
+#include "range_kernel.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define RANGE_KERNEL_X86 1
+#endif
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+// Векторных аккумуляторов в ядре: независимые цепочки перекрывают задержку
+#define VECTORS 4
+
+const char *RangeKernelName(enum RangeKernel kernel) {
+  switch (kernel) {
+  case RANGE_KERNEL_SERIAL:
+    return "serial";
+  case RANGE_KERNEL_SCALAR:
+    return "scalar";
+  case RANGE_KERNEL_AVX2:
+    return "avx2";
+  default:
+    return "ifma";
+  }
+}
+
+/**
+ * Прежняя реализация ModRangeProduct: одна цепочка, каждое умножение ждет
+ * предыдущее. Оставлена как точка отсчета для bench_range
+ */
+static uint64_t SerialProduct(const struct ModContext *ctx, uint64_t begin, uint64_t end) {
+  uint64_t mod = ctx->mod;
+  uint64_t ans = 1 % mod;
+  uint64_t i = begin;
+
+  if (ctx->kind == MOD_MONTGOMERY) {
+    // Редукция Монтгомери, как в common.c
+    do {
+      uint128_t t = (uint128_t)ans * i;
+      uint64_t q = (uint64_t)t * ctx->inv;
+      uint64_t hi = (uint64_t)(t >> 64);
+      uint64_t qm_hi = (uint64_t)(((uint128_t)q * mod) >> 64);
+      ans = hi - qm_hi + (hi < qm_hi ? mod : 0);
+    } while (i++ != end);
+    return ModMul(ctx, ans, ModPow(ctx, ctx->r1, end - begin + 1));
+  }
+
+  uint64_t r = begin % mod;
+  do {
+    ans = ModMul(ctx, ans, r);
+    if (++r == mod)
+      r = 0;
+  } while (i++ != end);
+  return ans;
+}
+
+#ifdef RANGE_KERNEL_X86
+
+/**
+ * Умножение Монтгомери на 52-битных дорожках: a * b * 2^-52 mod m
+ * для a, b < m < 2^52. minv = -m^-1 mod 2^52.
+ * lo + low52(q*m) делится на 2^52 и дает перенос 0 или 1 в старшую половину
+ */
+__attribute__((target("avx512f,avx512ifma")))
+static inline __m512i MontMul52(__m512i a, __m512i b, __m512i m, __m512i minv) {
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i lo = _mm512_madd52lo_epu64(zero, a, b);
+  __m512i hi = _mm512_madd52hi_epu64(zero, a, b);
+  __m512i q = _mm512_madd52lo_epu64(zero, lo, minv);
+  lo = _mm512_madd52lo_epu64(lo, q, m);
+  hi = _mm512_madd52hi_epu64(hi, q, m);
+  __m512i r = _mm512_add_epi64(hi, _mm512_srli_epi64(lo, 52));  // r < 2m
+  return _mm512_mask_sub_epi64(r, _mm512_cmpge_epu64_mask(r, m), r, m);
+}
+
+/**
+ * Ядро IFMA: blocks кругов по VECTORS * 8 чисел, начиная с begin
+ *
+ * @return произведение дорожек, умноженное на 2^(-52 * числа)
+ */
+__attribute__((target("avx512f,avx512ifma")))
+static uint64_t IfmaBlocks(const struct ModContext *ctx, uint64_t begin, uint64_t blocks) {
+  uint64_t mod = ctx->mod;
+  const __m512i m = _mm512_set1_epi64((long long)mod);
+  const __m512i minv = _mm512_set1_epi64((long long)((0 - ctx->inv) & ((1ull << 52) - 1)));
+  const __m512i step = _mm512_set1_epi64(VECTORS * 8);
+
+  // Дорожка l вектора v ведет числа begin + 8v + l + 32t (остатки по модулю)
+  __m512i acc[VECTORS], x[VECTORS];
+  uint64_t base = begin % mod;
+  for (int v = 0; v < VECTORS; v++) {
+    uint64_t lanes[8];
+    for (int l = 0; l < 8; l++)
+      lanes[l] = (base + (uint64_t)(8 * v + l)) % mod;
+    x[v] = _mm512_loadu_si512(lanes);
+    acc[v] = _mm512_set1_epi64(1);
+  }
+
+  for (uint64_t t = 0; t < blocks; t++) {
+    for (int v = 0; v < VECTORS; v++) {
+      acc[v] = MontMul52(acc[v], x[v], m, minv);
+      // x + 32 < 2m при m >= 64: одного вычитания достаточно
+      x[v] = _mm512_add_epi64(x[v], step);
+      x[v] = _mm512_mask_sub_epi64(x[v], _mm512_cmpge_epu64_mask(x[v], m), x[v], m);
+    }
+  }
+
+  uint64_t ans = 1;
+  for (int v = 0; v < VECTORS; v++) {
+    uint64_t lanes[8];
+    _mm512_storeu_si512(lanes, acc[v]);
+    for (int l = 0; l < 8; l++)
+      ans = ModMul(ctx, ans, lanes[l]);
+  }
+  return ans;
+}
+
+/**
+ * Умножение Монтгомери на 32-битных дорожках: a * b * 2^-32 mod m
+ * для a, b < m < 2^32. minv = m^-1 mod 2^32.
+ * Младшие 32 бита t и q*m совпадают, поэтому результат - разность
+ * старших половин, как в скалярном MontRedc
+ */
+__attribute__((target("avx2")))
+static inline __m256i MontMul32(__m256i a, __m256i b, __m256i m, __m256i minv) {
+  __m256i t = _mm256_mul_epu32(a, b);
+  __m256i q = _mm256_mul_epu32(t, minv);
+  __m256i qm = _mm256_mul_epu32(q, m);
+  __m256i t_hi = _mm256_srli_epi64(t, 32);
+  __m256i qm_hi = _mm256_srli_epi64(qm, 32);
+  __m256i r = _mm256_sub_epi64(t_hi, qm_hi);
+  __m256i borrow = _mm256_cmpgt_epi64(qm_hi, t_hi);  // Обе половины < 2^32
+  return _mm256_add_epi64(r, _mm256_and_si256(borrow, m));
+}
+
+/**
+ * Ядро AVX2: blocks кругов по VECTORS * 4 чисел, начиная с begin
+ *
+ * @return произведение дорожек, умноженное на 2^(-32 * числа)
+ */
+__attribute__((target("avx2")))
+static uint64_t Avx2Blocks(const struct ModContext *ctx, uint64_t begin, uint64_t blocks) {
+  uint64_t mod = ctx->mod;
+  const __m256i m = _mm256_set1_epi64x((long long)mod);
+  const __m256i m_minus_one = _mm256_set1_epi64x((long long)mod - 1);
+  const __m256i minv = _mm256_set1_epi64x((long long)(uint32_t)ctx->inv);
+  const __m256i step = _mm256_set1_epi64x(VECTORS * 4);
+
+  __m256i acc[VECTORS], x[VECTORS];
+  uint64_t base = begin % mod;
+  for (int v = 0; v < VECTORS; v++) {
+    long long lanes[4];
+    for (int l = 0; l < 4; l++)
+      lanes[l] = (long long)((base + (uint64_t)(4 * v + l)) % mod);
+    x[v] = _mm256_loadu_si256((const __m256i *)lanes);
+    acc[v] = _mm256_set1_epi64x(1);
+  }
+
+  for (uint64_t t = 0; t < blocks; t++) {
+    for (int v = 0; v < VECTORS; v++) {
+      acc[v] = MontMul32(acc[v], x[v], m, minv);
+      x[v] = _mm256_add_epi64(x[v], step);
+      __m256i wrap = _mm256_cmpgt_epi64(x[v], m_minus_one);
+      x[v] = _mm256_sub_epi64(x[v], _mm256_and_si256(wrap, m));
+    }
+  }
+
+  uint64_t ans = 1;
+  for (int v = 0; v < VECTORS; v++) {
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc[v]);
+    for (int l = 0; l < 4; l++)
+      ans = ModMul(ctx, ans, lanes[l]);
+  }
+  return ans;
+}
+
+#endif
+
+/**
+ * Может ли ядро считать по модулю контекста на этом процессоре
+ */
+bool RangeKernelAvailable(enum RangeKernel kernel, const struct ModContext *ctx) {
+  switch (kernel) {
+  case RANGE_KERNEL_SERIAL:
+  case RANGE_KERNEL_SCALAR:
+    return true;
+#ifdef RANGE_KERNEL_X86
+  case RANGE_KERNEL_AVX2:
+    return ctx->kind == MOD_MONTGOMERY && ctx->mod >= 64 && ctx->mod < (1ull << 32) &&
+           __builtin_cpu_supports("avx2");
+  case RANGE_KERNEL_IFMA:
+    return ctx->kind == MOD_MONTGOMERY && ctx->mod >= 64 && ctx->mod < (1ull << 52) &&
+           __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+#endif
+  default:
+    return false;
+  }
+}
+
+/**
+ * Самое быстрое доступное ядро для модуля контекста
+ */
+enum RangeKernel RangeKernelSelect(const struct ModContext *ctx) {
+  if (RangeKernelAvailable(RANGE_KERNEL_IFMA, ctx))
+    return RANGE_KERNEL_IFMA;
+  if (RangeKernelAvailable(RANGE_KERNEL_AVX2, ctx))
+    return RANGE_KERNEL_AVX2;
+  return RANGE_KERNEL_SCALAR;
+}
+
+/**
+ * Произведение begin * ... * end (begin <= end) заданным ядром
+ * Векторное ядро берет целые круги с начала диапазона, остаток досчитывается
+ * скалярно; множитель 2^(-w) каждого векторного умножения снимается одним ModPow
+ */
+uint64_t RangeKernelProduct(enum RangeKernel kernel, const struct ModContext *ctx,
+                            uint64_t begin, uint64_t end) {
+  if (kernel == RANGE_KERNEL_SERIAL)
+    return SerialProduct(ctx, begin, end);
+  uint64_t count = end - begin + 1;
+  if (kernel == RANGE_KERNEL_SCALAR || begin == 0 || count < RANGE_KERNEL_MIN_COUNT ||
+      !RangeKernelAvailable(kernel, ctx))
+    return ModRangeProduct(ctx, begin, end);
+
+#ifdef RANGE_KERNEL_X86
+  int lanes = kernel == RANGE_KERNEL_IFMA ? 8 : 4;
+  int width = kernel == RANGE_KERNEL_IFMA ? 52 : 32;
+  uint64_t per_block = (uint64_t)VECTORS * lanes;
+  uint64_t blocks = count / per_block;
+  uint64_t done = blocks * per_block;
+
+  uint64_t ans = kernel == RANGE_KERNEL_IFMA ? IfmaBlocks(ctx, begin, blocks)
+                                             : Avx2Blocks(ctx, begin, blocks);
+  ans = ModMul(ctx, ans, ModPow(ctx, (1ull << width) % ctx->mod, done));
+  if (done < count)
+    ans = ModMul(ctx, ans, ModRangeProduct(ctx, begin + done, end));
+  return ans;
+#else
+  return ModRangeProduct(ctx, begin, end);
+#endif
+}
+
+uint64_t RangeProduct(const struct ModContext *ctx, uint64_t begin, uint64_t end) {
+  return RangeKernelProduct(RangeKernelSelect(ctx), ctx, begin, end);
+}
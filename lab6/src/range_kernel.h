@@ -0,0 +1,38 @@
+#ifndef RANGE_KERNEL_H
+#define RANGE_KERNEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * Векторные ядра произведения диапазона по модулю
+ *
+ * Для нечетного модуля числа раздаются по кругу дорожкам нескольких
+ * векторных аккумуляторов, каждая дорожка ведет свою цепочку умножений
+ * Монтгомери, а в конце дорожки перемножаются обычным ModMul.
+ * Ядро выбирается во время работы по возможностям процессора:
+ *   IFMA   - AVX-512 IFMA, 52-битные умножения, 8 дорожек, модуль < 2^52
+ *   AVX2   - 32-битные умножения, 4 дорожки, модуль < 2^32
+ *   SCALAR - ModRangeProduct: RANGE_CHAINS скалярных цепочек, любой модуль
+ */
+
+enum RangeKernel {
+  RANGE_KERNEL_SERIAL,  // Одна цепочка умножений (прежняя реализация, для сравнения)
+  RANGE_KERNEL_SCALAR,
+  RANGE_KERNEL_AVX2,
+  RANGE_KERNEL_IFMA
+};
+
+// Короче этого диапазоны считаются скалярно: векторная подготовка не окупается
+#define RANGE_KERNEL_MIN_COUNT 256
+
+const char *RangeKernelName(enum RangeKernel kernel);
+bool RangeKernelAvailable(enum RangeKernel kernel, const struct ModContext *ctx);
+enum RangeKernel RangeKernelSelect(const struct ModContext *ctx);
+uint64_t RangeKernelProduct(enum RangeKernel kernel, const struct ModContext *ctx,
+                            uint64_t begin, uint64_t end);
+uint64_t RangeProduct(const struct ModContext *ctx, uint64_t begin, uint64_t end);
+
+#endif
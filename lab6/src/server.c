@@ -28,36 +28,251 @@
 
 #include "pthread.h"
 #include "common.h"  // Общие структуры и функции
+#include "pool.h"    // Пул рабочих потоков
+#include "event_loop.h"  // Неблокирующий слой соединений
+#include "cache.h"   // Кэш произведений блоков
+#include "factorial.h"  // Анализ модуля и план вычисления
+#include "sublinear.h"  // Сублинейный движок для простого модуля
+#include "range_kernel.h"  // Векторные ядра произведения диапазона
+#include "metrics.h"  // Метрики для Prometheus
+#include "log.h"     // Асинхронный журнал
 
 /**
  * Вычисление частичного факториала для диапазона чисел [begin, end] по модулю
  * Вычисляет произведение: begin * (begin+1) * ... * end mod mod
  * 
  * @param args - структура с параметрами вычисления (диапазон и модуль)
+ * @param cache - кэш произведений блоков или NULL
  * @return результат вычисления произведения диапазона по модулю
  */
-uint64_t Factorial(const struct FactorialArgs *args) {
-  uint64_t ans = 1;
-  // Последовательное перемножение всех чисел в диапазоне с применением модуля
-  for (uint64_t i = args->begin; i <= args->end; i++) {
-    ans = MultModulo(ans, i, args->mod);
+uint64_t Factorial(const struct FactorialArgs *args, struct PrefixCache *cache) {
+  // Контекст умножения готовится один раз на весь поддиапазон
+  struct ModContext ctx;
+  ModContextInit(&ctx, args->mod);
+  if (cache != NULL)
+    return CacheRangeProduct(cache, &ctx, args->begin, args->end);
+  return RangeProduct(&ctx, args->begin, args->end);
+}
+
+/**
+ * Общее состояние сервера, доступное обработчику запросов
+ */
+struct ServerContext {
+  struct ThreadPool pool;      // Пул рабочих потоков
+  struct PrefixCache *cache;   // Кэш произведений блоков (NULL - выключен)
+  bool sublinear;              // Движок --engine sublinear для простых модулей
+};
+
+/**
+ * Задача вычисления одного поддиапазона в пуле потоков
+ * Поле task должно быть первым: пул передает указатель на него
+ */
+struct FactorialTask {
+  struct Task task;           // Узел очереди пула
+  struct FactorialArgs args;  // Поддиапазон и модуль
+  struct PrefixCache *cache;  // Кэш произведений блоков (NULL - выключен)
+  bool sublinear;             // Весь диапазон плана одним сублинейным вычислением
+  int range;                  // Номер диапазона плана, к которому относится задача
+  uint64_t result;            // Результат для поддиапазона
+  uint64_t submit_ns;         // Момент постановки в очередь пула
+  struct Latch *latch;        // Защелка запроса, к которому относится задача
+};
+
+/**
+ * Вычисление одного запроса клиента: план, набор задач-поддиапазонов
+ * и защелка, срабатывающая после завершения последней из них
+ * Поле latch должно быть первым: обработчик защелки получает указатель на него
+ */
+struct RangeJob {
+  struct Latch latch;
+  struct Request *req;             // Запрос из цикла событий
+  struct FactorialPlan plan;       // План вычисления после анализа модуля
+  int parts;                       // Количество задач
+  struct FactorialTask tasks[];    // Задачи запроса
+};
+
+/**
+ * Функция, выполняемая рабочим потоком пула
+ * Сохраняет результат в задаче и отмечает ее завершение в защелке запроса
+ */
+static void RunFactorialTask(struct Task *task) {
+  struct FactorialTask *ftask = (struct FactorialTask *)task;
+  uint64_t start_ns = MetricsNowNs();
+  MetricsObserve(METRIC_QUEUE_WAIT, start_ns - ftask->submit_ns);
+  if (ftask->sublinear) {
+    struct ModContext ctx;
+    ModContextInit(&ctx, ftask->args.mod);
+    ftask->result = SublinearRangeProduct(&ctx, ftask->args.begin, ftask->args.end);
+  } else {
+    ftask->result = Factorial(&ftask->args, ftask->cache);
   }
-  return ans;
+  MetricsObserve(METRIC_COMPUTE_TIME, MetricsNowNs() - start_ns);
+  MetricsAdd(METRIC_TASKS, 1);
+  LatchCountDown(ftask->latch);
 }
 
 /**
- * Функция-обертка для выполнения вычислений в отдельном потоке
- * Создает копию результата в куче для безопасной передачи между потоками
- * 
- * @param args - указатель на структуру FactorialArgs с параметрами вычислений
- * @return указатель на результат вычисления (выделяется в куче)
+ * Обработчик защелки: объединяет результаты задач и возвращает
+ * ответ в цикл событий; вызывается потоком, завершившим последнюю задачу
+ */
+static void FinishRangeJob(struct Latch *latch) {
+  struct RangeJob *job = (struct RangeJob *)latch;
+  struct ModContext ctx;
+  ModContextInit(&ctx, job->plan.mod);
+
+  // Произведения диапазонов плана из результатов их задач
+  uint64_t products[PLAN_MAX_RANGES];
+  for (int r = 0; r < job->plan.ranges_num; r++)
+    products[r] = 1 % ctx.mod;  // Нейтральный элемент для умножения
+  for (int i = 0; i < job->parts; i++) {
+    // Умножение текущего результата на результат задачи по модулю
+    int r = job->tasks[i].range;
+    products[r] = ModMul(&ctx, products[r], job->tasks[i].result);
+  }
+  uint64_t total = FinishFactorialPlan(&job->plan, &ctx, products);
+
+  // Логирование окончательного результата
+  LOG(LOG_LEVEL_INFO, "Total: %" PRIu64, total);
+
+  job->req->result = total;
+  EventLoopComplete(job->req);
+
+  LatchDestroy(&job->latch);
+  free(job);
+}
+
+/**
+ * Деление диапазона [begin, end] на parts непустых поддиапазонов
+ * С кэшем границы выравниваются по контрольным точкам, чтобы поддиапазоны
+ * состояли из целых блоков без лишних хвостов
+ */
+static void SplitRange(uint64_t begin, uint64_t end, int parts, bool align,
+                       struct FactorialTask *tasks) {
+  // Вычисление общего количества чисел в диапазоне
+  uint64_t numbers_count = end - begin + 1;
+  // Базовое количество чисел на задачу
+  uint64_t numbers_per_thread = numbers_count / parts;
+  // Остаток чисел для распределения по первым задачам
+  uint64_t remainder = numbers_count % parts;
+  uint64_t current_begin = begin;  // Текущее начало диапазона
+
+  for (int i = 0; i < parts; i++) {
+    // Определение количества чисел для текущей задачи
+    uint64_t numbers_for_this_thread = numbers_per_thread;
+    if ((uint64_t)i < remainder) {  // Распределение остатка
+      numbers_for_this_thread++;
+    }
+
+    uint64_t part_end = current_begin + numbers_for_this_thread - 1;
+    if (i == parts - 1) {
+      part_end = end;  // Последняя задача забирает все, что осталось после выравнивания
+    } else if (align && numbers_per_thread >= CACHE_BLOCK_SIZE) {
+      part_end = ((part_end + 1) & ~(CACHE_BLOCK_SIZE - 1)) - 1;
+    }
+
+    tasks[i].args.begin = current_begin;
+    tasks[i].args.end = part_end;
+    current_begin = part_end + 1;  // Сдвиг для следующей задачи
+  }
+}
+
+/**
+ * Обработчик запросов цикла событий: анализирует модуль, делит диапазоны
+ * плана на поддиапазоны и ставит их в очередь пула, не дожидаясь результата
  */
-void *ThreadFactorial(void *args) {
-  struct FactorialArgs *fargs = (struct FactorialArgs *)args;
-  // Выделение памяти для результата, который будет передан обратно в главный поток
-  uint64_t *result = malloc(sizeof(uint64_t));
-  *result = Factorial(fargs);
-  return (void *)result;
+static void StartRequest(struct Request *req, void *ctx) {
+  struct ServerContext *server = (struct ServerContext *)ctx;
+  struct ThreadPool *pool = &server->pool;
+
+  // АНАЛИЗ МОДУЛЯ
+  
+  MetricsObserve(METRIC_RANGE_SIZE, req->args.end - req->args.begin + 1);
+  struct FactorialPlan plan;
+  PlanFactorial(&req->args, &plan);
+  if (plan.zero || plan.ranges_num == 0) {
+    // Ответ известен без перемножения (кратное mod в диапазоне
+    // или пустое дополнение по теореме Вильсона)
+    struct ModContext mod_ctx;
+    ModContextInit(&mod_ctx, plan.mod);
+    req->result = FinishFactorialPlan(&plan, &mod_ctx, NULL);
+    LOG(LOG_LEVEL_INFO, "Total: %" PRIu64, req->result);
+    EventLoopComplete(req);
+    return;
+  }
+
+  // РАСПРЕДЕЛЕНИЕ РАБОТЫ МЕЖДУ ПОТОКАМИ ПУЛА
+  
+  // Задачи делятся между диапазонами плана пропорционально их длине;
+  // задач не больше, чем чисел: пустые поддиапазоны не ставятся в очередь.
+  // Длинный диапазон по простому модулю сублинейный движок считает одной задачей
+  uint64_t counts[PLAN_MAX_RANGES];
+  bool range_sublinear[PLAN_MAX_RANGES];
+  double total_count = 0;
+  for (int r = 0; r < plan.ranges_num; r++) {
+    counts[r] = plan.ranges[r].end - plan.ranges[r].begin + 1;
+    range_sublinear[r] = server->sublinear && plan.prime && SublinearSupported(plan.mod) &&
+                         counts[r] >= SUBLINEAR_MIN_COUNT;
+    total_count += (double)counts[r];
+  }
+  int range_parts[PLAN_MAX_RANGES];
+  int parts = 0;
+  for (int r = 0; r < plan.ranges_num; r++) {
+    if (range_sublinear[r]) {
+      range_parts[r] = 1;
+      parts++;
+      continue;
+    }
+    uint64_t share = (uint64_t)((double)pool->tnum * (double)counts[r] / total_count + 0.5);
+    if (share == 0)
+      share = 1;
+    if (share > counts[r])
+      share = counts[r];
+    range_parts[r] = (int)share;
+    parts += range_parts[r];
+  }
+
+  struct RangeJob *job = malloc(sizeof(struct RangeJob) + sizeof(struct FactorialTask) * parts);
+  if (job == NULL) {
+    LOG(LOG_LEVEL_ERROR, "Out of memory for request");
+    req->result = 0;
+    EventLoopComplete(req);
+    return;
+  }
+  job->req = req;
+  job->plan = plan;
+  job->parts = parts;
+  LatchInit(&job->latch, parts, FinishRangeJob);
+
+  int first = 0;
+  for (int r = 0; r < plan.ranges_num; r++) {
+    SplitRange(plan.ranges[r].begin, plan.ranges[r].end, range_parts[r],
+               server->cache != NULL, job->tasks + first);
+    for (int i = first; i < first + range_parts[r]; i++) {
+      job->tasks[i].range = r;
+      job->tasks[i].sublinear = range_sublinear[r];
+    }
+    first += range_parts[r];
+  }
+
+  for (int i = 0; i < parts; i++) {
+    // Настройка параметров для текущей задачи
+    job->tasks[i].task.func = RunFactorialTask;
+    job->tasks[i].args.mod = plan.mod;
+    job->tasks[i].cache = server->cache;
+    job->tasks[i].latch = &job->latch;
+
+    // Логирование распределения работы
+    LOG(LOG_LEVEL_INFO, "Thread %d: numbers from %" PRIu64 " to %" PRIu64,
+        i, job->tasks[i].args.begin, job->tasks[i].args.end);
+  }
+
+  // Задачи ставятся после полной подготовки: как только выполнится
+  // последняя из них, job будет освобожден рабочим потоком
+  uint64_t submit_ns = MetricsNowNs();
+  for (int i = 0; i < parts; i++)
+    job->tasks[i].submit_ns = submit_ns;
+  for (int i = 0; i < parts; i++)
+    ThreadPoolSubmit(pool, &job->tasks[i].task);
 }
 
 /**
@@ -67,6 +282,12 @@ void *ThreadFactorial(void *args) {
 int main(int argc, char **argv) {
   int tnum = -1;  // Количество потоков для вычислений (инициализация невалидным значением)
   int port = -1;   // Порт для прослушивания (инициализация невалидным значением)
+  int cache_mb = 0;  // Бюджет кэша в мегабайтах (0 - кэш выключен)
+  bool sublinear = false;  // Движок вычисления: linear (по умолчанию) или sublinear
+  int metrics_port = 0;  // Порт HTTP-выдачи метрик (0 - выключена)
+  enum LogLevel log_level = LOG_LEVEL_INFO;  // Минимальный уровень журнала
+  unsigned int log_sample = 1;  // Выводить каждое N-е сообщение ниже WARN
+  bool log_sync = false;  // Форматировать журнал в рабочих потоках (для сравнения)
 
   // ПАРСИНГ АРГУМЕНТОВ КОМАНДНОЙ СТРОКИ
   
@@ -76,6 +297,13 @@ int main(int argc, char **argv) {
     static struct option options[] = {
       {"port", required_argument, 0, 0},  // Порт сервера
       {"tnum", required_argument, 0, 0},  // Количество потоков
+      {"cache-mb", required_argument, 0, 0},  // Бюджет кэша произведений
+      {"engine", required_argument, 0, 0},  // Движок вычисления
+      {"metrics-port", required_argument, 0, 0},  // Порт метрик Prometheus
+      {"quiet", no_argument, 0, 0},  // То же, что --log-level warn
+      {"log-level", required_argument, 0, 0},  // Уровень журнала
+      {"log-sample", required_argument, 0, 0},  // Выборка сообщений журнала
+      {"log-sync", no_argument, 0, 0},  // Синхронный журнал
       {0, 0, 0, 0}                        // Конец списка опций
     };
 
@@ -104,6 +332,51 @@ int main(int argc, char **argv) {
           return 1;
         }
         break;
+      case 2:  // --cache-mb
+        cache_mb = atoi(optarg);
+        // Проверка корректности бюджета кэша
+        if (cache_mb < 0) {
+          fprintf(stderr, "Cache size must be non-negative number\n");
+          return 1;
+        }
+        break;
+      case 3:  // --engine
+        // Проверка названия движка
+        if (strcmp(optarg, "linear") == 0) {
+          sublinear = false;
+        } else if (strcmp(optarg, "sublinear") == 0) {
+          sublinear = true;
+        } else {
+          fprintf(stderr, "Engine must be linear or sublinear\n");
+          return 1;
+        }
+        break;
+      case 4:  // --metrics-port
+        metrics_port = atoi(optarg);
+        if (metrics_port <= 0 || metrics_port > 65535) {
+          fprintf(stderr, "Metrics port must be in 1..65535\n");
+          return 1;
+        }
+        break;
+      case 5:  // --quiet
+        log_level = LOG_LEVEL_WARN;
+        break;
+      case 6:  // --log-level
+        if (!LogParseLevel(optarg, &log_level)) {
+          fprintf(stderr, "Log level must be debug, info, warn, error or off\n");
+          return 1;
+        }
+        break;
+      case 7:  // --log-sample
+        if (atoi(optarg) <= 0) {
+          fprintf(stderr, "Log sample must be positive number\n");
+          return 1;
+        }
+        log_sample = (unsigned int)atoi(optarg);
+        break;
+      case 8:  // --log-sync
+        log_sync = true;
+        break;
       default:
         printf("Index %d is out of options\n", option_index);
       }
@@ -119,10 +392,34 @@ int main(int argc, char **argv) {
 
   // ПРОВЕРКА ОБЯЗАТЕЛЬНЫХ ПАРАМЕТРОВ
   if (port == -1 || tnum == -1) {
-    fprintf(stderr, "Using: %s --port 20001 --tnum 4\n", argv[0]);
+    fprintf(stderr, "Using: %s --port 20001 --tnum 4 [--cache-mb 64] [--engine linear|sublinear] [--metrics-port 9100] [--quiet] [--log-level info] [--log-sample 1] [--log-sync]\n", argv[0]);
+    return 1;
+  }
+
+  // Сообщения о запросах форматирует и выводит фоновый поток журнала
+  if (LogInit(log_level, log_sample, log_sync) != 0) {
+    fprintf(stderr, "Error: can not start log writer!\n");
     return 1;
   }
 
+  // ЗАПУСК ПУЛА РАБОЧИХ ПОТОКОВ
+  
+  // Потоки создаются один раз и обслуживают все последующие запросы
+  struct ServerContext server_ctx;
+  server_ctx.sublinear = sublinear;
+  if (ThreadPoolInit(&server_ctx.pool, tnum) != 0) {
+    fprintf(stderr, "Error: can not start thread pool!\n");
+    return 1;
+  }
+
+  // Кэш произведений блоков для повторяющихся диапазонов (по флагу --cache-mb)
+  struct PrefixCache cache;
+  server_ctx.cache = NULL;
+  if (cache_mb > 0) {
+    CacheInit(&cache, (size_t)cache_mb << 20);
+    server_ctx.cache = &cache;
+  }
+
   // СОЗДАНИЕ И НАСТРОЙКА СЕРВЕРНОГО СОКЕТА
   
   // Создание TCP сокета для IPv4
@@ -150,8 +447,9 @@ int main(int argc, char **argv) {
   }
 
   // Начало прослушивания входящих соединений
-  // 128 - максимальная длина очереди ожидающих соединений
-  err = listen(server_fd, 128);
+  // SOMAXCONN - максимальная длина очереди, которую допускает система:
+  // при массовом подключении клиентов очередь 128 переполняется
+  err = listen(server_fd, SOMAXCONN);
   if (err < 0) {
     fprintf(stderr, "Could not listen on socket\n");
     return 1;
@@ -159,132 +457,32 @@ int main(int argc, char **argv) {
 
   printf("Server listening at %d\n", port);
 
-  // ОСНОВНОЙ ЦИКЛ ОБРАБОТКИ СОЕДИНЕНИЙ
-  
-  // Бесконечный цикл для непрерывной работы сервера
-  while (true) {
-    // Принятие входящего соединения от клиента
-    struct sockaddr_in client;
-    socklen_t client_len = sizeof(client);
-    int client_fd = accept(server_fd, (struct sockaddr *)&client, &client_len);
-
-    if (client_fd < 0) {
-      fprintf(stderr, "Could not establish new connection\n");
-      continue; // Продолжаем принимать соединения несмотря на ошибку
-    }
-
-    // ЦИКЛ ОБРАБОТКИ ЗАПРОСОВ ОТ КОНКРЕТНОГО КЛИЕНТА
-    
-    // Обработка нескольких запросов в рамках одного соединения
-    while (true) {
-      // Размер буфера для приема данных: 3 числа uint64_t (begin, end, mod)
-      size_t buffer_size = sizeof(uint64_t) * 3;
-      char from_client[buffer_size];
-      
-      // Прием данных от клиента
-      ssize_t read = recv(client_fd, from_client, buffer_size, 0);
-
-      if (!read)  // Клиент закрыл соединение
-        break;
-      if (read < 0) {  // Ошибка при чтении
-        fprintf(stderr, "Client read failed\n");
-        break;
-      }
-      // Проверка полноты полученных данных
-      if ((size_t)read < buffer_size) {
-        fprintf(stderr, "Client send wrong data format\n");
-        break;
-      }
-
-      // ПОДГОТОВКА К ПАРАЛЛЕЛЬНЫМ ВЫЧИСЛЕНИЯМ
-      
-      pthread_t threads[tnum];  // Массив идентификаторов потоков
-
-      // Извлечение параметров из полученных бинарных данных
-      uint64_t begin = 0;
-      uint64_t end = 0;
-      uint64_t mod = 0;
-      memcpy(&begin, from_client, sizeof(uint64_t));
-      memcpy(&end, from_client + sizeof(uint64_t), sizeof(uint64_t));
-      memcpy(&mod, from_client + 2 * sizeof(uint64_t), sizeof(uint64_t));
-
-      // Логирование полученных параметров (PRIu64 - правильный формат для uint64_t)
-      fprintf(stdout, "Receive: %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", begin, end, mod);
-
-      struct FactorialArgs args[tnum];  // Аргументы для каждого потока
-      
-      // РАСПРЕДЕЛЕНИЕ РАБОТЫ МЕЖДУ ПОТОКАМИ
-      
-      // Вычисление общего количества чисел в диапазоне
-      uint64_t numbers_count = end - begin + 1;
-      // Базовое количество чисел на поток
-      uint64_t numbers_per_thread = numbers_count / tnum;
-      // Остаток чисел для распределения по первым потокам
-      uint64_t remainder = numbers_count % tnum;
-      uint64_t current_begin = begin;  // Текущее начало диапазона
-
-      // Создание потоков для параллельных вычислений
-      for (int i = 0; i < tnum; i++) {
-        // Определение количества чисел для текущего потока
-        uint64_t numbers_for_this_thread = numbers_per_thread;
-        if ((uint64_t)i < remainder) {  // Распределение остатка
-          numbers_for_this_thread++;
-        }
-
-        // Настройка параметров для текущего потока
-        args[i].begin = current_begin;
-        args[i].end = current_begin + numbers_for_this_thread - 1;
-        args[i].mod = mod;
-        current_begin += numbers_for_this_thread;  // Сдвиг для следующего потока
-
-        // Логирование распределения работы
-        printf("Thread %d: numbers from %" PRIu64 " to %" PRIu64 "\n", 
-               i, args[i].begin, args[i].end);
-
-        // Создание потока для вычисления части факториала
-        if (pthread_create(&threads[i], NULL, ThreadFactorial, (void *)&args[i])) {
-          printf("Error: pthread_create failed!\n");
-          return 1;
-        }
-      }
-
-      // СБОР РЕЗУЛЬТАТОВ И ВЫЧИСЛЕНИЕ ОКОНЧАТЕЛЬНОГО РЕЗУЛЬТАТА
-      
-      uint64_t total = 1;  // Нейтральный элемент для умножения
-      
-      // Ожидание завершения всех потоков и сбор результатов
-      for (int i = 0; i < tnum; i++) {
-        uint64_t *result = NULL;
-        // Ожидание завершения потока и получение результата
-        pthread_join(threads[i], (void **)&result);
-        if (result != NULL) {
-          // Умножение текущего результата на результат потока по модулю
-          total = MultModulo(total, *result, mod);
-          free(result);  // Освобождение памяти, выделенной в потоке
-        }
-      }
-
-      // Логирование окончательного результата
-      printf("Total: %" PRIu64 "\n", total);
-
-      // ОТПРАВКА РЕЗУЛЬТАТА КЛИЕНТУ
-      
-      char buffer[sizeof(total)];
-      memcpy(buffer, &total, sizeof(total));  // Упаковка результата в бинарный формат
-      err = send(client_fd, buffer, sizeof(total), 0);
-      if (err < 0) {
-        fprintf(stderr, "Can't send data to client\n");
-        break;
-      }
+  // Метрики отдаются отдельным потоком только на локальном интерфейсе
+  if (metrics_port > 0) {
+    if (MetricsServe(metrics_port) != 0) {
+      fprintf(stderr, "Can not serve metrics on port %d\n", metrics_port);
+      return 1;
     }
+    printf("Metrics at http://127.0.0.1:%d/metrics\n", metrics_port);
+  }
 
-    // ЗАВЕРШЕНИЕ РАБОТЫ С КЛИЕНТОМ
-    
-    shutdown(client_fd, SHUT_RDWR);  // Отключение передачи в обоих направлениях
-    close(client_fd);  // Закрытие файлового дескриптора клиента
+  // ОСНОВНОЙ ЦИКЛ ОБРАБОТКИ СОЕДИНЕНИЙ
+  
+  // Все клиенты обслуживаются одним неблокирующим циклом на epoll,
+  // вычисления выполняются пулом потоков
+  struct EventLoop loop;
+  if (EventLoopInit(&loop, server_fd, StartRequest, &server_ctx) != 0) {
+    fprintf(stderr, "Can not start event loop!\n");
+    return 1;
   }
+  err = EventLoopRun(&loop);
 
-  // Закрытие серверного сокета (эта строка никогда не выполнится в бесконечном цикле)
+  // Освобождение ресурсов (выполняется только при ошибке цикла событий)
+  EventLoopDestroy(&loop);
   close(server_fd);
-  return 0;
-}
\ No newline at end of file
+  ThreadPoolDestroy(&server_ctx.pool);
+  if (server_ctx.cache != NULL)
+    CacheDestroy(server_ctx.cache);
+  LogShutdown();
+  return err ? 1 : 0;
+}
@@ -0,0 +1,420 @@
+/**
+ * sublinear.c - Вычисление n! mod p за O(sqrt(n) log n) сдвигом точек многочлена
+ *
+ * Для шага v берется многочлен g_d(x) = (x+1)(x+2)...(x+d). Тогда
+ * (k*v)! = g_v(0) * g_v(v) * ... * g_v((k-1)v), то есть достаточно значений
+ * h(i) = g_v(i*v). Они строятся удвоением d: по значениям h(0..d) интерполяцией
+ * Лагранжа получаются значения в сдвинутых точках, а g_2d(x) = g_d(x) * g_d(x+d).
+ * Интерполяция в сдвинутых точках сводится к одной свертке, которая считается
+ * NTT по трем простым модулям с восстановлением по китайской теореме об остатках.
+ *
+ * Работает для простого p < 2^62: нужны обратные элементы, а свертки 32-битных
+ * половин чисел должны помещаться в произведение модулей NTT (~2^85).
+ */
+
+#include "sublinear.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "factorial.h"
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+// Простые модули NTT вида c * 2^k + 1 и их первообразные корни
+#define NTT_PRIMES 3
+static const uint32_t ntt_primes[NTT_PRIMES] = {167772161, 469762049, 754974721};
+static const uint32_t ntt_roots[NTT_PRIMES] = {3, 3, 11};
+// Наибольшая длина NTT: 754974721 - 1 делится только на 2^24
+#define NTT_MAX_SIZE (1u << 24)
+
+// Оставшиеся блоки добираются сдвигом точек, только если их не меньше этого
+#define SUBLINEAR_SHIFT_BLOCKS 1024
+
+static uint32_t PowMod32(uint32_t base, uint64_t exp, uint32_t mod) {
+  uint64_t res = 1;
+  uint64_t x = base % mod;
+  while (exp > 0) {
+    if (exp & 1)
+      res = res * x % mod;
+    x = x * x % mod;
+    exp >>= 1;
+  }
+  return (uint32_t)res;
+}
+
+/**
+ * Умножение на фиксированный корень w по Шоупу: ws = floor(w * 2^32 / mod)
+ * заранее, поэтому деление заменяется умножением (mod < 2^30)
+ */
+static inline uint32_t MulShoup(uint32_t a, uint32_t w, uint32_t ws, uint32_t mod) {
+  uint32_t q = (uint32_t)(((uint64_t)a * ws) >> 32);
+  uint32_t r = a * w - q * mod;
+  return r >= mod ? r - mod : r;
+}
+
+/**
+ * Таблица корней для NTT длины n: roots[half + j] = w^j, где w - корень
+ * степени 2*half, и множители Шоупа к ним
+ */
+static void NttRoots(uint32_t *roots, uint32_t *shoup, size_t n, uint32_t mod, uint32_t g) {
+  for (size_t half = 1; half < n; half *= 2) {
+    uint32_t w = PowMod32(g, (mod - 1) / (2 * half), mod);
+    uint64_t cur = 1;
+    for (size_t j = 0; j < half; j++) {
+      roots[half + j] = (uint32_t)cur;
+      shoup[half + j] = (uint32_t)((cur << 32) / mod);
+      cur = cur * w % mod;
+    }
+  }
+}
+
+/**
+ * Прямое NTT длины n (степень двойки) на месте
+ */
+static void Ntt(uint32_t *a, size_t n, const uint32_t *roots, const uint32_t *shoup, uint32_t mod) {
+  // Перестановка с обращением порядка бит индекса
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      uint32_t t = a[i];
+      a[i] = a[j];
+      a[j] = t;
+    }
+  }
+
+  for (size_t half = 1; half < n; half *= 2) {
+    for (size_t i = 0; i < n; i += 2 * half) {
+      for (size_t j = 0; j < half; j++) {
+        uint32_t u = a[i + j];
+        uint32_t v = MulShoup(a[i + j + half], roots[half + j], shoup[half + j], mod);
+        a[i + j] = u + v >= mod ? u + v - mod : u + v;
+        a[i + j + half] = u >= v ? u - v : u + mod - v;
+      }
+    }
+  }
+}
+
+/**
+ * Обратное NTT: прямое преобразование, разворот a[1..n-1] и деление на n
+ */
+static void InverseNtt(uint32_t *a, size_t n, const uint32_t *roots, const uint32_t *shoup,
+                       uint32_t mod) {
+  Ntt(a, n, roots, shoup, mod);
+  for (size_t i = 1, j = n - 1; i < j; i++, j--) {
+    uint32_t t = a[i];
+    a[i] = a[j];
+    a[j] = t;
+  }
+  uint64_t inv_n = PowMod32((uint32_t)(n % mod), mod - 2, mod);
+  for (size_t i = 0; i < n; i++)
+    a[i] = (uint32_t)(a[i] * inv_n % mod);
+}
+
+/**
+ * Восстановление числа x < m0*m1*m2 по остаткам (метод Гарнера) и его остаток по p
+ */
+static uint64_t CrtModP(const struct ModContext *ctx, const uint32_t *r, uint64_t inv01,
+                        uint64_t inv012) {
+  uint64_t m0 = ntt_primes[0], m1 = ntt_primes[1], m2 = ntt_primes[2];
+  uint64_t t1 = (r[1] + m1 - r[0] % m1) % m1 * inv01 % m1;
+  uint64_t low = r[0] + m0 * t1;  // x mod m0*m1
+  uint64_t t2 = (r[2] + m2 - low % m2) % m2 * inv012 % m2;
+  uint128_t x = (uint128_t)low + (uint128_t)(m0 * m1) * t2;
+  return (uint64_t)(x % ctx->mod);
+}
+
+/**
+ * Фрагмент свертки по модулю контекста: out[t] = sum f[i] * g[from + t - i]
+ * для t < count. Числа делятся на 32-битные половины; каждая из трех
+ * сверток половин меньше произведения модулей NTT и восстанавливается точно
+ */
+static bool Convolve(const struct ModContext *ctx, const uint64_t *f, size_t fn,
+                     const uint64_t *g, size_t gn, size_t from, size_t count, uint64_t *out) {
+  // Циклическая свертка длины n не искажает индексы [from, from + count),
+  // если переносы i + j - n < from: n + from >= fn + gn - 1
+  size_t n = 1;
+  while (n < from + count || n + from < fn + gn - 1 || n < fn || n < gn)
+    n *= 2;
+  if (n > NTT_MAX_SIZE)
+    return false;
+
+  uint32_t *buf = malloc(sizeof(uint32_t) * (6 * n + 3 * NTT_PRIMES * count));
+  if (buf == NULL)
+    return false;
+  uint32_t *fh = buf, *fl = buf + n, *gh = buf + 2 * n, *gl = buf + 3 * n;
+  uint32_t *roots = buf + 4 * n, *shoup = buf + 5 * n;
+  uint32_t *res = buf + 6 * n;  // res[(part * NTT_PRIMES + prime) * count + t]
+
+  for (int q = 0; q < NTT_PRIMES; q++) {
+    uint32_t mod = ntt_primes[q];
+    NttRoots(roots, shoup, n, mod, ntt_roots[q]);
+    for (size_t i = 0; i < n; i++) {
+      fh[i] = i < fn ? (uint32_t)((f[i] >> 32) % mod) : 0;
+      fl[i] = i < fn ? (uint32_t)((f[i] & UINT32_MAX) % mod) : 0;
+      gh[i] = i < gn ? (uint32_t)((g[i] >> 32) % mod) : 0;
+      gl[i] = i < gn ? (uint32_t)((g[i] & UINT32_MAX) % mod) : 0;
+    }
+    Ntt(fh, n, roots, shoup, mod);
+    Ntt(fl, n, roots, shoup, mod);
+    Ntt(gh, n, roots, shoup, mod);
+    Ntt(gl, n, roots, shoup, mod);
+    // Произведения старших, смешанных и младших половин
+    for (size_t i = 0; i < n; i++) {
+      uint64_t a1 = fh[i], a0 = fl[i], b1 = gh[i], b0 = gl[i];
+      fh[i] = (uint32_t)(a1 * b1 % mod);
+      fl[i] = (uint32_t)((a1 * b0 + a0 * b1 % mod) % mod);
+      gh[i] = (uint32_t)(a0 * b0 % mod);
+    }
+    uint32_t *parts[3] = {fh, fl, gh};
+    for (int part = 0; part < 3; part++) {
+      InverseNtt(parts[part], n, roots, shoup, mod);
+      for (size_t t = 0; t < count; t++)
+        res[((size_t)part * NTT_PRIMES + q) * count + t] = parts[part][from + t];
+    }
+  }
+
+  uint64_t m0 = ntt_primes[0], m1 = ntt_primes[1], m2 = ntt_primes[2];
+  uint64_t inv01 = PowMod32((uint32_t)(m0 % m1), m1 - 2, (uint32_t)m1);
+  uint64_t inv012 = PowMod32((uint32_t)(m0 * m1 % m2), m2 - 2, (uint32_t)m2);
+  uint64_t mod = ctx->mod;
+  uint64_t shift32 = (1ull << 32) % mod;
+  uint64_t shift64 = (0 - mod) % mod;  // 2^64 mod p
+  for (size_t t = 0; t < count; t++) {
+    uint64_t value[3];
+    for (int part = 0; part < 3; part++) {
+      uint32_t r[NTT_PRIMES];
+      for (int q = 0; q < NTT_PRIMES; q++)
+        r[q] = res[((size_t)part * NTT_PRIMES + q) * count + t];
+      value[part] = CrtModP(ctx, r, inv01, inv012);
+    }
+    uint64_t sum = ModMul(ctx, value[0], shift64);
+    uint64_t mid = ModMul(ctx, value[1], shift32);
+    sum = sum >= mod - mid ? sum - (mod - mid) : sum + mid;
+    sum = sum >= mod - value[2] ? sum - (mod - value[2]) : sum + value[2];
+    out[t] = sum;
+  }
+
+  free(buf);
+  return true;
+}
+
+/**
+ * Сдвиг точек: по значениям h(0), ..., h(d) многочлена степени не выше d
+ * вычисляет h(m), ..., h(m + count - 1). Числа m-d, ..., m+count-1
+ * не должны делиться на p, ifact[i] = (i!)^-1 для i <= d
+ *
+ * h(m+k) = prod_{j=0..d} (m+k-j) * sum_i f_i / (m+k-i),
+ * f_i = h(i) / (i! (d-i)! (-1)^(d-i)), а сумма - свертка f с 1/(m-d+t)
+ */
+static bool ShiftSamples(const struct ModContext *ctx, const uint64_t *ifact, const uint64_t *h,
+                         uint64_t d, uint64_t m, uint64_t count, uint64_t *out) {
+  uint64_t p = ctx->mod;
+  size_t gn = d + count;
+  uint64_t *f = malloc(sizeof(uint64_t) * (d + 1 + 2 * gn + count));
+  if (f == NULL)
+    return false;
+  uint64_t *g = f + d + 1;
+  uint64_t *pre = g + gn;
+  uint64_t *conv = pre + gn;
+
+  for (uint64_t i = 0; i <= d; i++) {
+    f[i] = ModMul(ctx, ModMul(ctx, h[i], ifact[i]), ifact[d - i]);
+    if ((d - i) % 2 == 1 && f[i] != 0)
+      f[i] = p - f[i];
+  }
+
+  // Знаменатели m-d+t и их обратные одним возведением в степень
+  uint64_t base = m >= d ? m - d : m + p - d;
+  uint64_t raw = base;
+  for (size_t t = 0; t < gn; t++) {
+    g[t] = raw;
+    pre[t] = t == 0 ? raw : ModMul(ctx, pre[t - 1], raw);
+    if (++raw == p)
+      raw = 0;
+  }
+  uint64_t inv = ModPow(ctx, pre[gn - 1], p - 2);
+  for (size_t t = gn - 1; t > 0; t--) {
+    uint64_t inv_t = ModMul(ctx, inv, pre[t - 1]);
+    inv = ModMul(ctx, inv, g[t]);
+    g[t] = inv_t;
+  }
+  g[0] = inv;
+
+  if (!Convolve(ctx, f, d + 1, g, gn, d, count, conv)) {
+    free(f);
+    return false;
+  }
+
+  // prod_k = (m-d+k) * ... * (m+k) обновляется скользящим окном
+  uint64_t prod = pre[d];
+  for (uint64_t k = 0; k < count; k++) {
+    out[k] = ModMul(ctx, conv[k], prod);
+    if (k + 1 < count) {
+      uint64_t next = (base + k + d + 1) % p;
+      prod = ModMul(ctx, ModMul(ctx, prod, next), g[k]);
+    }
+  }
+  free(f);
+  return true;
+}
+
+/**
+ * Значения h[i] = g_v(i*v) = (iv+1)...(iv+v) для i = 0..v (массив из v+1 элементов)
+ */
+static bool SampleBlocks(const struct ModContext *ctx, const uint64_t *ifact, uint64_t v,
+                         uint64_t *h) {
+  uint64_t p = ctx->mod;
+  uint64_t inv_v = ModPow(ctx, v, p - 2);
+  uint64_t *ext = malloc(sizeof(uint64_t) * (v + 1) * 2);
+  if (ext == NULL)
+    return false;
+  uint64_t *half = ext + v + 1;
+
+  int top = 63;
+  while (((v >> top) & 1) == 0)
+    top--;
+
+  h[0] = 1;
+  h[1] = (v + 1) % p;
+  uint64_t d = 1;
+  for (int bit = top - 1; bit >= 0; bit--) {
+    // Удвоение: g_2d(iv) = g_d(iv) * g_d(iv + d), i = 0..2d;
+    // g_d(iv + d) - значения h в точках, сдвинутых на d/v
+    if (!ShiftSamples(ctx, ifact, h, d, d + 1, d, ext) ||
+        !ShiftSamples(ctx, ifact, h, d, ModMul(ctx, d, inv_v), 2 * d + 1, half)) {
+      free(ext);
+      return false;
+    }
+    for (uint64_t i = 0; i <= d; i++)
+      h[i] = ModMul(ctx, h[i], half[i]);
+    for (uint64_t i = d + 1; i <= 2 * d; i++)
+      h[i] = ModMul(ctx, ext[i - d - 1], half[i]);
+    d *= 2;
+
+    if ((v >> bit) & 1) {
+      // Шаг d -> d+1: множитель (iv + d + 1) и новая точка i = d + 1
+      for (uint64_t i = 0; i <= d; i++)
+        h[i] = ModMul(ctx, h[i], i * v + d + 1);
+      h[d + 1] = ModRangeProduct(ctx, (d + 1) * v + 1, (d + 1) * v + d + 1);
+      d++;
+    }
+  }
+  free(ext);
+  return true;
+}
+
+/**
+ * Подходит ли модуль для сублинейного вычисления (простоту проверяет вызывающий)
+ */
+bool SublinearSupported(uint64_t mod) {
+  return mod > 2 && mod < (1ull << 62);
+}
+
+/**
+ * n! mod p для простого p: по блокам из v чисел, где v ~ sqrt(n),
+ * хвост короче v перемножается напрямую
+ */
+static bool BlockFactorial(const struct ModContext *ctx, uint64_t n, uint64_t *result) {
+  uint64_t p = ctx->mod;
+
+  uint64_t v = 1;
+  while ((v + 1) * (v + 1) <= n && v < SUBLINEAR_MAX_STEP)
+    v++;
+  // Сдвиг на d/v корректен, пока |t| * v + d не достигает p
+  while (v > 1 && (v + 2) * (v + 2) > p)
+    v--;
+  if (v < 2)
+    return false;
+
+  uint64_t *ifact = malloc(sizeof(uint64_t) * (3 * (v + 1)));
+  if (ifact == NULL)
+    return false;
+  uint64_t *h = ifact + v + 1;
+  uint64_t *next = h + v + 1;
+
+  // Обратные факториалы 0..v
+  uint64_t fact = 1;
+  for (uint64_t i = 1; i <= v; i++)
+    fact = ModMul(ctx, fact, i);
+  ifact[v] = ModPow(ctx, fact, p - 2);
+  for (uint64_t i = v; i > 0; i--)
+    ifact[i - 1] = ModMul(ctx, ifact[i], i);
+
+  bool ok = SampleBlocks(ctx, ifact, v, h);
+  uint64_t blocks = n / v;
+  uint64_t covered = blocks < v + 1 ? blocks : v + 1;
+  uint64_t ans = 1 % p;
+  for (uint64_t i = 0; ok && i < covered; i++)
+    ans = ModMul(ctx, ans, h[i]);
+
+  // Шаг ограничен по памяти: остальные блоки - те же точки, сдвинутые на covered
+  while (ok && blocks - covered >= SUBLINEAR_SHIFT_BLOCKS) {
+    uint64_t count = blocks - covered < v + 1 ? blocks - covered : v + 1;
+    ok = ShiftSamples(ctx, ifact, h, v, covered, count, next);
+    for (uint64_t i = 0; ok && i < count; i++)
+      ans = ModMul(ctx, ans, next[i]);
+    covered += count;
+  }
+  free(ifact);
+  if (!ok)
+    return false;
+
+  if (covered * v < n)
+    ans = ModMul(ctx, ans, ModRangeProduct(ctx, covered * v + 1, n));
+  *result = ans;
+  return true;
+}
+
+/**
+ * n! mod p для простого модуля контекста
+ * Короткие и неподходящие случаи, а также нехватка памяти - прямым перемножением
+ */
+uint64_t SublinearFactorial(const struct ModContext *ctx, uint64_t n) {
+  uint64_t p = ctx->mod;
+  if (n >= p)
+    return 0;
+  if (n == 0)
+    return 1 % p;
+
+  uint64_t result;
+  if (n >= SUBLINEAR_MIN_COUNT && SublinearSupported(p) && BlockFactorial(ctx, n, &result))
+    return result;
+  return ModRangeProduct(ctx, 1, n);
+}
+
+/**
+ * begin * ... * end mod p для простого p (1 <= begin <= end < p) как end! / (begin-1)!
+ */
+uint64_t SublinearRangeProduct(const struct ModContext *ctx, uint64_t begin, uint64_t end) {
+  if (end - begin + 1 < SUBLINEAR_MIN_COUNT || !SublinearSupported(ctx->mod))
+    return ModRangeProduct(ctx, begin, end);
+  uint64_t num = SublinearFactorial(ctx, end);
+  uint64_t den = SublinearFactorial(ctx, begin - 1);
+  return ModMul(ctx, num, ModPow(ctx, den, ctx->mod - 2));
+}
+
+/**
+ * Последовательное вычисление произведения диапазона по плану,
+ * диапазоны плана при простом модуле - сублинейно
+ */
+uint64_t FactorialSublinear(const struct FactorialArgs *args) {
+  struct FactorialPlan plan;
+  PlanFactorial(args, &plan);
+  if (plan.zero)
+    return 0;
+
+  struct ModContext ctx;
+  ModContextInit(&ctx, plan.mod);
+  uint64_t products[PLAN_MAX_RANGES];
+  for (int i = 0; i < plan.ranges_num; i++) {
+    if (plan.prime)
+      products[i] = SublinearRangeProduct(&ctx, plan.ranges[i].begin, plan.ranges[i].end);
+    else
+      products[i] = ModRangeProduct(&ctx, plan.ranges[i].begin, plan.ranges[i].end);
+  }
+  return FinishFactorialPlan(&plan, &ctx, products);
+}
@@ -0,0 +1,19 @@
+#ifndef SUBLINEAR_H
+#define SUBLINEAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+// Короче этого диапазоны выгоднее перемножать напрямую
+#define SUBLINEAR_MIN_COUNT (1ull << 20)
+// Предел шага v (значений многочлена в памяти): больше - сдвигом тех же точек
+#define SUBLINEAR_MAX_STEP (1ull << 20)
+
+bool SublinearSupported(uint64_t mod);
+uint64_t SublinearFactorial(const struct ModContext *ctx, uint64_t n);
+uint64_t SublinearRangeProduct(const struct ModContext *ctx, uint64_t begin, uint64_t end);
+uint64_t FactorialSublinear(const struct FactorialArgs *args);
+
+#endif
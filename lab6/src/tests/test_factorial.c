@@ -0,0 +1,233 @@
+/**
+ * test_factorial.c - Проверка анализа модуля, быстрых путей умножения
+ * и векторных ядер против прямого перемножения
+ *
+ * Запуск: make test-factorial
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "common.h"
+#include "factorial.h"
+#include "sublinear.h"
+#include "range_kernel.h"
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+static int failures = 0;
+
+#define CHECK(cond, ...)              \
+  do {                                \
+    if (!(cond)) {                    \
+      printf("FAIL: " __VA_ARGS__);   \
+      printf("\n");                   \
+      failures++;                     \
+    }                                 \
+  } while (0)
+
+/**
+ * Прямое перемножение диапазона - эталон для сравнения
+ */
+static uint64_t BruteForce(uint64_t begin, uint64_t end, uint64_t mod) {
+  uint64_t ans = 1 % mod;
+  for (uint64_t i = begin; i <= end; i++)
+    ans = MultModulo(ans, i, mod);
+  return ans;
+}
+
+static bool IsPrimeTrial(uint64_t n) {
+  if (n < 2)
+    return false;
+  for (uint64_t d = 2; d * d <= n; d++) {
+    if (n % d == 0)
+      return false;
+  }
+  return true;
+}
+
+static uint64_t Random64(void) {
+  return ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^ (uint64_t)rand();
+}
+
+void testIsPrime(void) {
+  for (uint64_t n = 0; n < 200000; n++)
+    CHECK(IsPrime64(n) == IsPrimeTrial(n), "IsPrime64(%" PRIu64 ")", n);
+
+  // Простые около 2^61 и 2^64, числа Кармайкла и сильные псевдопростые
+  CHECK(IsPrime64(2305843009213693951ull), "2^61 - 1 is prime");
+  CHECK(IsPrime64(18446744073709551557ull), "2^64 - 59 is prime");
+  CHECK(IsPrime64(1000000007ull), "1000000007 is prime");
+  CHECK(!IsPrime64(561), "561 is Carmichael");
+  CHECK(!IsPrime64(3215031751ull), "3215031751 is strong pseudoprime");
+  CHECK(!IsPrime64(3825123056546413051ull), "3825123056546413051 is strong pseudoprime");
+  CHECK(!IsPrime64(18446744073709551555ull), "2^64 - 61 is divisible by 5");
+  CHECK(!IsPrime64(4294967291ull * 4294967279ull), "product of two 32-bit primes");
+}
+
+void testModMul(void) {
+  const uint64_t mods[] = {1, 2, 3, 65522, 4294967295ull, 4294967296ull,
+                           1000000007ull, 281474976710598ull, 18446744073709551557ull,
+                           18446744073709551558ull, UINT64_MAX};
+  for (size_t m = 0; m < sizeof(mods) / sizeof(mods[0]); m++) {
+    struct ModContext ctx;
+    ModContextInit(&ctx, mods[m]);
+    for (int i = 0; i < 2000; i++) {
+      uint64_t a = Random64();
+      uint64_t b = Random64();
+      uint64_t expected = (uint64_t)(((uint128_t)a * b) % mods[m]);
+      CHECK(ModMul(&ctx, a, b) == expected, "ModMul mod %" PRIu64, mods[m]);
+      CHECK(MultModulo(a, b, mods[m]) == expected, "MultModulo mod %" PRIu64, mods[m]);
+    }
+    uint64_t begin = Random64() % 1000000 + 1;
+    uint64_t end = begin + Random64() % 5000;
+    CHECK(ModRangeProduct(&ctx, begin, end) == BruteForce(begin, end, mods[m]),
+          "ModRangeProduct [%" PRIu64 ", %" PRIu64 "] mod %" PRIu64, begin, end, mods[m]);
+  }
+}
+
+void testRangeKernels(void) {
+  // Границы применимости ядер: 64, 2^32 и 2^52 - и по обе стороны от них
+  const uint64_t mods[] = {3, 63, 65, 65521, 998244353, 4294967291ull, 4294967297ull,
+                           281474976710597ull, 4503599627370449ull, 4503599627370497ull,
+                           1000000008ull, 18446744073709551557ull};
+  const enum RangeKernel kernels[] = {RANGE_KERNEL_SCALAR, RANGE_KERNEL_AVX2, RANGE_KERNEL_IFMA};
+  for (size_t m = 0; m < sizeof(mods) / sizeof(mods[0]); m++) {
+    struct ModContext ctx;
+    ModContextInit(&ctx, mods[m]);
+    for (int i = 0; i < 20; i++) {
+      // Длины вокруг кратных размеру круга и диапазоны у конца uint64_t
+      uint64_t len = i < 6 ? RANGE_KERNEL_MIN_COUNT + (uint64_t)i * 7 : Random64() % 3000;
+      uint64_t begin = i % 5 == 4 ? UINT64_MAX - 1 - len : Random64() % (mods[m] * 2) + 1;
+      uint64_t end = begin + len;
+      uint64_t expected = BruteForce(begin, end, mods[m]);
+      for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        CHECK(RangeKernelProduct(kernels[k], &ctx, begin, end) == expected,
+              "%s [%" PRIu64 ", %" PRIu64 "] mod %" PRIu64,
+              RangeKernelName(kernels[k]), begin, end, mods[m]);
+      }
+    }
+  }
+}
+
+void testFactorialPlan(void) {
+  // Малые модули: все диапазоны, включая переходы через кратные mod
+  for (uint64_t mod = 1; mod <= 60; mod++) {
+    for (uint64_t begin = 1; begin <= 130; begin++) {
+      for (uint64_t end = begin; end <= 130; end++) {
+        struct FactorialArgs args = {begin, end, mod};
+        CHECK(FactorialAnalyzed(&args) == BruteForce(begin, end, mod),
+              "[%" PRIu64 ", %" PRIu64 "] mod %" PRIu64, begin, end, mod);
+      }
+    }
+  }
+
+  // Диапазоны около простого p, где срабатывает отражение Вильсона
+  const uint64_t primes[] = {10007, 65537, 1000003};
+  for (size_t i = 0; i < sizeof(primes) / sizeof(primes[0]); i++) {
+    uint64_t p = primes[i];
+    for (int t = 0; t < 200; t++) {
+      uint64_t begin = 1 + Random64() % 300;
+      uint64_t end = p - 1 - Random64() % 300;
+      if (t % 4 == 0)
+        begin += p * (1 + Random64() % 1000);  // Тот же диапазон остатков
+      if (t % 4 == 0)
+        end += begin - begin % p;
+      struct FactorialArgs args = {begin, end, p};
+      struct FactorialPlan plan;
+      PlanFactorial(&args, &plan);
+      CHECK(plan.invert, "Wilson reflection for [%" PRIu64 ", %" PRIu64 "] mod %" PRIu64,
+            begin, end, p);
+      CHECK(FactorialAnalyzed(&args) == BruteForce(begin, end, p),
+            "[%" PRIu64 ", %" PRIu64 "] mod %" PRIu64, begin, end, p);
+    }
+  }
+
+  // Случайные диапазоны с составными и простыми модулями
+  for (int t = 0; t < 3000; t++) {
+    uint64_t mod = 2 + Random64() % 20000;
+    uint64_t begin = 1 + Random64() % 100000;
+    uint64_t end = begin + Random64() % 25000;
+    struct FactorialArgs args = {begin, end, mod};
+    CHECK(FactorialAnalyzed(&args) == BruteForce(begin, end, mod),
+          "[%" PRIu64 ", %" PRIu64 "] mod %" PRIu64, begin, end, mod);
+  }
+
+  // Огромный диапазон без вычислений: содержит кратное mod
+  struct FactorialArgs huge = {1, UINT64_MAX, 1000000007};
+  CHECK(FactorialAnalyzed(&huge) == 0, "huge range is zero");
+  struct FactorialArgs full = {0, UINT64_MAX, 3};
+  CHECK(FactorialAnalyzed(&full) == 0, "full range is zero");
+}
+
+void testSublinear(void) {
+  // Против прямого перемножения: простые до 2^62, в том числе около 2^20,
+  // где шаг v уменьшается из-за условия (v+2)^2 <= p
+  const uint64_t primes[] = {1048583ull, 998244353ull, 1000000007ull,
+                             2305843009213693951ull, 4611686018427387847ull};
+  for (size_t i = 0; i < sizeof(primes) / sizeof(primes[0]); i++) {
+    struct ModContext ctx;
+    ModContextInit(&ctx, primes[i]);
+    for (int t = 0; t < 3; t++) {
+      uint64_t n = SUBLINEAR_MIN_COUNT + Random64() % (3 * SUBLINEAR_MIN_COUNT);
+      if (n >= primes[i])
+        n = primes[i] - 1 - Random64() % 1000;
+      CHECK(SublinearFactorial(&ctx, n) == ModRangeProduct(&ctx, 1, n),
+            "SublinearFactorial(%" PRIu64 ") mod %" PRIu64, n, primes[i]);
+    }
+    uint64_t begin = 1 + Random64() % 100000;
+    uint64_t end = begin + SUBLINEAR_MIN_COUNT + Random64() % 1000;
+    if (end < primes[i])
+      CHECK(SublinearRangeProduct(&ctx, begin, end) == ModRangeProduct(&ctx, begin, end),
+            "SublinearRangeProduct [%" PRIu64 ", %" PRIu64 "] mod %" PRIu64, begin, end, primes[i]);
+  }
+
+  // Теорема Вильсона на всем диапазоне: (p-1)! = -1, (p-2)! = 1.
+  // При p ~ 2^41 шаг упирается в SUBLINEAR_MAX_STEP и оставшиеся блоки
+  // считаются сдвигом тех же точек
+  const int wilson_bits[] = {34, 41};
+  for (size_t i = 0; i < sizeof(wilson_bits) / sizeof(wilson_bits[0]); i++) {
+    uint64_t p = (1ull << wilson_bits[i]) + 1;
+    while (!IsPrime64(p))
+      p += 2;
+    struct ModContext ctx;
+    ModContextInit(&ctx, p);
+    CHECK(SublinearFactorial(&ctx, p - 1) == p - 1, "(p-1)! = -1 mod %" PRIu64, p);
+    if (i == 0)
+      CHECK(SublinearFactorial(&ctx, p - 2) == 1, "(p-2)! = 1 mod %" PRIu64, p);
+  }
+
+  // Через план: составной модуль и короткие диапазоны - прямым перемножением
+  for (int t = 0; t < 200; t++) {
+    uint64_t mod = 2 + Random64() % 20000;
+    uint64_t begin = 1 + Random64() % 100000;
+    uint64_t end = begin + Random64() % 25000;
+    struct FactorialArgs args = {begin, end, mod};
+    CHECK(FactorialSublinear(&args) == BruteForce(begin, end, mod),
+          "FactorialSublinear [%" PRIu64 ", %" PRIu64 "] mod %" PRIu64, begin, end, mod);
+  }
+  struct FactorialArgs wide = {12345, 3 * SUBLINEAR_MIN_COUNT, 1000000007};
+  struct ModContext wide_ctx;
+  ModContextInit(&wide_ctx, wide.mod);
+  CHECK(FactorialSublinear(&wide) == ModRangeProduct(&wide_ctx, wide.begin, wide.end),
+        "FactorialSublinear wide range");
+}
+
+int main(void) {
+  srand(12345);
+
+  testIsPrime();
+  testModMul();
+  testRangeKernels();
+  testFactorialPlan();
+  testSublinear();
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("All factorial tests passed\n");
+  return 0;
+}
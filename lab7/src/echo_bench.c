@@ -0,0 +1,100 @@
+#define _POSIX_C_SOURCE 200809L  // clock_gettime при -std=c99
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SADDR struct sockaddr
+
+// Ожидание ответа, после которого датаграмма считается потерянной
+#define REPLY_TIMEOUT_MS 100
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Пропускная способность эхо-сервера UDP: COUNT датаграмм по BUFSIZE байт,
+ * следующая отправляется после ответа на предыдущую
+ */
+int main(int argc, char **argv) {
+  // Проверка аргументов командной строки
+  if (argc != 5) {
+    printf("Usage: %s <IP> <PORT> <BUFSIZE> <COUNT>\n", argv[0]);
+    exit(1);
+  }
+
+  // Парсинг аргументов
+  char *ip = argv[1];
+  int port = atoi(argv[2]);
+  int bufsize = atoi(argv[3]);
+  int count = atoi(argv[4]);
+
+  // Валидация аргументов
+  if (port <= 0 || bufsize <= 0 || count <= 0) {
+    printf("Invalid port, buffer size or count\n");
+    exit(1);
+  }
+
+  int sockfd;
+  char *sendline = malloc(bufsize);
+  char *recvline = malloc(bufsize);
+  struct sockaddr_in servaddr;
+
+  // Настройка адреса сервера
+  memset(&servaddr, 0, sizeof(servaddr));
+  servaddr.sin_family = AF_INET;
+  servaddr.sin_port = htons(port);
+
+  if (inet_pton(AF_INET, ip, &servaddr.sin_addr) <= 0) {
+    perror("inet_pton problem");
+    free(sendline);
+    free(recvline);
+    exit(1);
+  }
+
+  // Создание UDP сокета; connect оставляет в нем только ответы сервера
+  if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 ||
+      connect(sockfd, (SADDR *)&servaddr, sizeof(servaddr)) < 0) {
+    perror("socket problem");
+    free(sendline);
+    free(recvline);
+    exit(1);
+  }
+  struct timeval tv = {0, REPLY_TIMEOUT_MS * 1000};
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  // Печатные символы: сервер выводит содержимое в журнал
+  for (int i = 0; i < bufsize; i++)
+    sendline[i] = (char)('a' + i % 26);
+
+  int lost = 0;
+  double start = NowSec();
+  for (int i = 0; i < count; i++) {
+    if (send(sockfd, sendline, bufsize, 0) < 0) {
+      perror("send problem");
+      break;
+    }
+    if (recv(sockfd, recvline, bufsize, 0) < 0)
+      lost++;
+  }
+  double elapsed = NowSec() - start;
+
+  printf("%d echoes of %d bytes in %.3f s: %.0f echoes/s, %d lost\n",
+         count - lost, bufsize, elapsed, (double)(count - lost) / elapsed, lost);
+
+  // Очистка ресурсов
+  free(sendline);
+  free(recvline);
+  close(sockfd);
+  return 0;
+}
@@ -0,0 +1,611 @@
+#define _POSIX_C_SOURCE 200809L  // clock_gettime при -std=c99
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SADDR struct sockaddr
+
+// Ожидание ответа, после которого датаграммы потока считаются потерянными
+#define REPLY_TIMEOUT_NS (100 * 1000000ull)
+// Событий epoll за один вызов
+#define MAX_EVENTS 256
+
+/**
+ * Генератор нагрузки для tcpserver и udpserver
+ *
+ * UDP: CONNS потоков датаграмм (у каждого свой сокет), в начале каждой
+ * датаграммы время отправки, эхо-сервер возвращает его обратно. Задержка -
+ * от отправки до ответа.
+ * TCP: соединение отправляет SIZE байт, закрывает запись и ждет, пока
+ * сервер закроет соединение (значит, данные прочитаны). Задержка - от
+ * connect до закрытия.
+ *
+ * Замкнутый цикл (по умолчанию): новая отправка только после ответа,
+ * в полете не больше WINDOW датаграмм на поток UDP и CONNS соединений TCP.
+ * Открытый цикл (--rate R): отправки идут по расписанию R в секунду
+ * независимо от ответов, а задержка считается от запланированного момента,
+ * так что в нее попадает и отставание генератора от расписания.
+ *
+ * Работа делится поровну между THREADS потоками. Задержки копятся
+ * в гистограммах с логарифмически-линейными корзинами (как HdrHistogram),
+ * в конце гистограммы потоков складываются.
+ */
+
+// ГИСТОГРАММА ЗАДЕРЖЕК
+
+// Корзин на каждую степень двойки: относительная ошибка меньше 1%
+#define HIST_SUB_BITS 7
+#define HIST_HALF (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_HALF * (64 - HIST_SUB_BITS + 1))
+
+struct Histogram {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+  double sum;
+};
+
+static void HistInit(struct Histogram *h) {
+  memset(h, 0, sizeof(*h));
+  h->min = UINT64_MAX;
+}
+
+/**
+ * Значения меньше 2 * HIST_HALF хранятся точно, дальше каждая степень
+ * двойки делится на HIST_HALF равных корзин
+ */
+static unsigned HistIndex(uint64_t v) {
+  if (v < 2 * HIST_HALF)
+    return (unsigned)v;
+  unsigned e = 63 - (unsigned)__builtin_clzll(v) - HIST_SUB_BITS;
+  return HIST_HALF * e + (unsigned)(v >> e);
+}
+
+// Наибольшее значение, попадающее в корзину
+static uint64_t HistValue(unsigned i) {
+  if (i < 2 * HIST_HALF)
+    return i;
+  unsigned e = i / HIST_HALF - 1;
+  uint64_t sub = i - HIST_HALF * e;
+  return ((sub + 1) << e) - 1;
+}
+
+static void HistRecord(struct Histogram *h, uint64_t v) {
+  h->counts[HistIndex(v)]++;
+  h->total++;
+  h->sum += (double)v;
+  if (v < h->min)
+    h->min = v;
+  if (v > h->max)
+    h->max = v;
+}
+
+static void HistMerge(struct Histogram *dst, const struct Histogram *src) {
+  for (unsigned i = 0; i < HIST_BUCKETS; i++)
+    dst->counts[i] += src->counts[i];
+  dst->total += src->total;
+  dst->sum += src->sum;
+  if (src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+}
+
+/**
+ * Значение перцентиля p (0..100), не больше точного максимума
+ */
+static uint64_t HistPercentile(const struct Histogram *h, double p) {
+  if (h->total == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+  if (rank < 1)
+    rank = 1;
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank)
+      return HistValue(i) < h->max ? HistValue(i) : h->max;
+  }
+  return h->max;
+}
+
+// ОБЩЕЕ
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Таймаут epoll до момента due, в миллисекундах с округлением вверх
+static int WaitMs(uint64_t due, uint64_t now) {
+  return due > now ? (int)((due - now + 999999) / 1000000) : 0;
+}
+
+static void PrintUsage(const char *name) {
+  printf("Usage: %s <IP> <PORT> [--udp | --tcp] [--count N] [--size BYTES] [--window W] "
+         "[--conns C] [--threads T] [--rate R] [--json]\n", name);
+}
+
+/**
+ * Нагрузка одного потока генератора и ее итоги
+ */
+struct Worker {
+  pthread_t thread;
+  struct sockaddr_in servaddr;
+  bool udp;
+  long count;                // Датаграмм UDP или соединений TCP
+  int size;
+  int window;
+  int conns;                 // Потоков UDP или одновременных соединений TCP
+  double rate;               // В секунду; 0 - замкнутый цикл
+  long ok;
+  long lost;                 // UDP: без ответа; TCP: ошибка соединения
+  struct Histogram hist;
+  int err;
+};
+
+// UDP
+
+/**
+ * Поток датаграмм: свой сокет, а значит, свой порт отправителя
+ */
+struct UdpFlow {
+  int fd;
+  int inflight;
+  uint64_t last_ns;          // Последняя отправка или ответ
+};
+
+static void UdpSend(struct Worker *w, struct UdpFlow *flow, char *payload, uint64_t ts) {
+  memcpy(payload, &ts, sizeof(ts));
+  if (send(flow->fd, payload, w->size, 0) < 0 && errno != EAGAIN && errno != ENOBUFS) {
+    perror("send");
+    w->err = 1;
+  }
+  // Неотправленная датаграмма тоже в полете: без ответа она станет потерей
+  flow->inflight++;
+  flow->last_ns = NowNs();
+}
+
+static void *RunUdp(void *arg) {
+  struct Worker *w = arg;
+  char *payload = calloc(1, w->size);
+  char *reply = malloc(w->size);
+  struct UdpFlow *flows = calloc(w->conns, sizeof(struct UdpFlow));
+  int epfd = epoll_create1(0);
+  if (payload == NULL || reply == NULL || flows == NULL || epfd < 0) {
+    perror("udp setup");
+    w->err = 1;
+    return NULL;
+  }
+  for (int i = sizeof(uint64_t); i < w->size; i++)
+    payload[i] = (char)('a' + i % 26);
+  for (int i = 0; i < w->conns; i++) {
+    flows[i].fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (flows[i].fd < 0 ||
+        connect(flows[i].fd, (const SADDR *)&w->servaddr, sizeof(w->servaddr)) < 0) {
+      perror("udp socket");
+      w->err = 1;
+      return NULL;
+    }
+    // Окно целиком должно помещаться в буфер приема
+    int rcvbuf = w->window * (w->size + 512);
+    setsockopt(flows[i].fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    int flags = fcntl(flows[i].fd, F_GETFL, 0);
+    fcntl(flows[i].fd, F_SETFL, flags | O_NONBLOCK);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &flows[i];
+    epoll_ctl(epfd, EPOLL_CTL_ADD, flows[i].fd, &ev);
+  }
+
+  long sent = 0;
+  uint64_t interval = w->rate > 0 ? (uint64_t)(1e9 / w->rate) : 0;
+  uint64_t next_due = NowNs();
+  struct epoll_event events[MAX_EVENTS];
+  while (w->err == 0 && w->ok + w->lost < w->count) {
+    // Отправка: по расписанию или пока в окне потока есть место
+    uint64_t now = NowNs();
+    if (interval > 0) {
+      while (sent < w->count && next_due <= now) {
+        UdpSend(w, &flows[sent % w->conns], payload, next_due);
+        sent++;
+        next_due += interval;
+      }
+    } else {
+      for (int i = 0; i < w->conns; i++) {
+        while (flows[i].inflight < w->window && sent < w->count) {
+          UdpSend(w, &flows[i], payload, now);
+          sent++;
+        }
+      }
+    }
+
+    // Ожидание ответов, но не дольше следующей отправки по расписанию
+    int timeout = 10;
+    if (interval > 0 && sent < w->count && WaitMs(next_due, now) < timeout)
+      timeout = WaitMs(next_due, now);
+    int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      w->err = 1;
+      break;
+    }
+    now = NowNs();
+    for (int i = 0; i < n; i++) {
+      struct UdpFlow *flow = events[i].data.ptr;
+      while (recv(flow->fd, reply, w->size, 0) >= (ssize_t)sizeof(uint64_t)) {
+        // Поздний ответ на датаграмму, уже признанную потерянной, не считается
+        if (flow->inflight == 0)
+          continue;
+        uint64_t ts;
+        memcpy(&ts, reply, sizeof(ts));
+        HistRecord(&w->hist, now > ts ? now - ts : 0);
+        flow->inflight--;
+        flow->last_ns = now;
+        w->ok++;
+      }
+    }
+
+    // Поток без ответов дольше REPLY_TIMEOUT_NS: все, что в полете, потеряно
+    for (int i = 0; i < w->conns; i++) {
+      if (flows[i].inflight > 0 && now - flows[i].last_ns > REPLY_TIMEOUT_NS) {
+        w->lost += flows[i].inflight;
+        flows[i].inflight = 0;
+      }
+    }
+  }
+
+  for (int i = 0; i < w->conns; i++)
+    close(flows[i].fd);
+  close(epfd);
+  free(payload);
+  free(reply);
+  free(flows);
+  return NULL;
+}
+
+// TCP
+
+/**
+ * Соединение TCP генератора: отправлено sent байт из size; fd -1 - свободно
+ */
+struct TcpConn {
+  int fd;
+  int sent;
+  bool writing;
+  uint64_t start;            // Момент connect, в открытом цикле - по расписанию
+};
+
+static int StartConn(int epfd, const struct sockaddr_in *servaddr, struct TcpConn *conn,
+                     uint64_t start) {
+  conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (conn->fd < 0)
+    return -1;
+  int flags = fcntl(conn->fd, F_GETFL, 0);
+  fcntl(conn->fd, F_SETFL, flags | O_NONBLOCK);
+  conn->sent = 0;
+  conn->writing = true;
+  conn->start = start;
+  // Чтение включено и во время отправки: эхо-сервер перестает читать,
+  // пока ответ не забран, и без этого большой size зависал бы
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLOUT;
+  ev.data.ptr = conn;
+  if ((connect(conn->fd, (const SADDR *)servaddr, sizeof(*servaddr)) < 0 &&
+       errno != EINPROGRESS) ||
+      epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev) < 0) {
+    close(conn->fd);
+    conn->fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+static void *RunTcp(void *arg) {
+  struct Worker *w = arg;
+  char *payload = malloc(w->size);
+  char sink[4096];
+  struct TcpConn *pool = calloc(w->conns, sizeof(struct TcpConn));
+  struct TcpConn **idle = calloc(w->conns, sizeof(struct TcpConn *));
+  int epfd = epoll_create1(0);
+  if (payload == NULL || pool == NULL || idle == NULL || epfd < 0) {
+    perror("tcp setup");
+    w->err = 1;
+    return NULL;
+  }
+  for (int i = 0; i < w->size; i++)
+    payload[i] = (char)('a' + i % 26);
+  int idle_num = 0;
+  for (int i = 0; i < w->conns; i++) {
+    pool[i].fd = -1;
+    idle[idle_num++] = &pool[i];
+  }
+
+  long started = 0;
+  uint64_t interval = w->rate > 0 ? (uint64_t)(1e9 / w->rate) : 0;
+  uint64_t next_due = NowNs();
+  struct epoll_event events[MAX_EVENTS];
+  while (w->ok + w->lost < w->count) {
+    // Новые соединения: по расписанию или на место закрытых
+    uint64_t now = NowNs();
+    while (started < w->count && idle_num > 0 && (interval == 0 || next_due <= now)) {
+      struct TcpConn *conn = idle[--idle_num];
+      if (StartConn(epfd, &w->servaddr, conn, interval > 0 ? next_due : now) < 0) {
+        w->lost++;
+        idle[idle_num++] = conn;
+      }
+      started++;
+      next_due += interval;
+    }
+
+    // Без расписания ждать нечего, кроме ответов: секунда тишины - остановка
+    bool scheduled = interval > 0 && started < w->count && idle_num > 0;
+    int timeout = scheduled ? WaitMs(next_due, now) : 1000;
+    int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      w->err = 1;
+      break;
+    }
+    if (n == 0 && !scheduled) {
+      printf("tcp: no progress for 1 s, stopping\n");
+      w->err = 1;
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      struct TcpConn *conn = events[i].data.ptr;
+      uint32_t revents = events[i].events;
+      bool finished = false, error = (revents & EPOLLERR) != 0;
+
+      // Ответ сервера выбрасывается; закрытие до конца отправки - ошибка
+      if (!error && (revents & (EPOLLIN | EPOLLHUP))) {
+        ssize_t r;
+        while ((r = read(conn->fd, sink, sizeof(sink))) > 0) {
+        }
+        if (r == 0 && !conn->writing)
+          finished = true;
+        else if (r == 0 || errno != EAGAIN)
+          error = true;
+      }
+
+      if (!error && !finished && conn->writing && (revents & EPOLLOUT)) {
+        ssize_t sent = send(conn->fd, payload + conn->sent, w->size - conn->sent, MSG_NOSIGNAL);
+        if (sent > 0)
+          conn->sent += (int)sent;
+        else if (sent < 0 && errno != EAGAIN)
+          error = true;
+        if (!error && conn->sent == w->size) {
+          // Все отправлено: ждем закрытия соединения сервером
+          shutdown(conn->fd, SHUT_WR);
+          conn->writing = false;
+          struct epoll_event ev;
+          ev.events = EPOLLIN;
+          ev.data.ptr = conn;
+          epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+        }
+      }
+
+      if (finished || error) {
+        close(conn->fd);
+        conn->fd = -1;
+        if (finished) {
+          uint64_t end = NowNs();
+          HistRecord(&w->hist, end > conn->start ? end - conn->start : 0);
+          w->ok++;
+        } else {
+          w->lost++;
+        }
+        idle[idle_num++] = conn;
+      }
+    }
+  }
+
+  for (int i = 0; i < w->conns; i++) {
+    if (pool[i].fd >= 0)
+      close(pool[i].fd);
+  }
+  close(epfd);
+  free(payload);
+  free(pool);
+  free(idle);
+  return NULL;
+}
+
+// ОТЧЕТ
+
+static void Report(const struct Worker *total, int threads, int conns, double rate,
+                   double elapsed, bool json) {
+  const struct Histogram *h = &total->hist;
+  const char *proto = total->udp ? "udp" : "tcp";
+  double per_sec = (double)total->ok / elapsed;
+  double mb_per_sec = (double)total->ok * total->size / elapsed / 1e6;
+  double min = h->total ? (double)h->min / 1e3 : 0;
+  double mean = h->total ? h->sum / (double)h->total / 1e3 : 0;
+  double p50 = (double)HistPercentile(h, 50) / 1e3;
+  double p90 = (double)HistPercentile(h, 90) / 1e3;
+  double p99 = (double)HistPercentile(h, 99) / 1e3;
+  double p999 = (double)HistPercentile(h, 99.9) / 1e3;
+  double p9999 = (double)HistPercentile(h, 99.99) / 1e3;
+  double max = (double)h->max / 1e3;
+
+  if (json) {
+    // Одна строка на запуск: такие строки удобно копить в файле и сравнивать
+    printf("{\"proto\":\"%s\",\"mode\":\"%s\",\"threads\":%d,\"conns\":%d,\"window\":%d,"
+           "\"rate\":%.0f,\"size\":%d,\"ok\":%ld,\"lost\":%ld,\"seconds\":%.6f,"
+           "\"per_sec\":%.1f,\"mb_per_sec\":%.3f,\"latency_us\":{\"min\":%.3f,\"mean\":%.3f,"
+           "\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p99.9\":%.3f,\"p99.99\":%.3f,"
+           "\"max\":%.3f}}\n",
+           proto, rate > 0 ? "open" : "closed", threads, conns, total->window, rate,
+           total->size, total->ok, total->lost, elapsed, per_sec, mb_per_sec,
+           min, mean, p50, p90, p99, p999, p9999, max);
+    return;
+  }
+
+  if (total->udp)
+    printf("udp: %ld datagrams of %d bytes, %d threads, %d flows, window %d, in %.3f s: "
+           "%.0f datagrams/s, %ld lost\n",
+           total->ok, total->size, threads, conns, total->window, elapsed, per_sec, total->lost);
+  else
+    printf("tcp: %ld connections of %d bytes, %d threads, %d at once, in %.3f s: "
+           "%.0f connections/s, %.1f MB/s, %ld failed\n",
+           total->ok, total->size, threads, conns, elapsed, per_sec, mb_per_sec, total->lost);
+  if (rate > 0)
+    printf("%s: open loop, %.0f per second scheduled\n", proto, rate);
+  printf("%s latency, us: min %.1f, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, "
+         "p99.99 %.1f, max %.1f\n", proto, min, mean, p50, p90, p99, p999, p9999, max);
+}
+
+int main(int argc, char **argv) {
+  bool udp = true;
+  bool json = false;
+  long count = 100000;
+  int size = 64;
+  int window = 32;
+  int conns = 0;             // По умолчанию 1 поток UDP или 64 соединения TCP
+  int threads = 1;
+  double rate = 0;
+
+  while (1) {
+    static struct option options[] = {
+      {"udp", no_argument, 0, 0},
+      {"tcp", no_argument, 0, 0},
+      {"count", required_argument, 0, 0},
+      {"size", required_argument, 0, 0},
+      {"window", required_argument, 0, 0},
+      {"conns", required_argument, 0, 0},
+      {"threads", required_argument, 0, 0},
+      {"rate", required_argument, 0, 0},
+      {"json", no_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c != 0) {
+      PrintUsage(argv[0]);
+      exit(1);
+    }
+    switch (option_index) {
+    case 0:
+      udp = true;
+      break;
+    case 1:
+      udp = false;
+      break;
+    case 2:
+      count = atol(optarg);
+      break;
+    case 3:
+      size = atoi(optarg);
+      break;
+    case 4:
+      window = atoi(optarg);
+      break;
+    case 5:
+      conns = atoi(optarg);
+      break;
+    case 6:
+      threads = atoi(optarg);
+      break;
+    case 7:
+      rate = atof(optarg);
+      break;
+    default:
+      json = true;
+      break;
+    }
+  }
+
+  // Проверка аргументов командной строки
+  if (argc - optind != 2) {
+    PrintUsage(argv[0]);
+    exit(1);
+  }
+  if (conns == 0)
+    conns = udp ? 1 : 64;
+  if (count <= 0 || size <= 0 || window <= 0 || conns <= 0 || threads <= 0 || rate < 0) {
+    printf("Count, size, window, conns and threads must be positive, rate non-negative\n");
+    exit(1);
+  }
+  if (udp && size < (int)sizeof(uint64_t)) {
+    printf("UDP size must be at least %d bytes to carry a timestamp\n", (int)sizeof(uint64_t));
+    exit(1);
+  }
+  // Каждому потоку генератора хотя бы одно соединение и одно сообщение
+  if (conns > count)
+    conns = (int)count;
+  if (threads > conns)
+    threads = conns;
+
+  // Настройка адреса сервера
+  struct sockaddr_in servaddr;
+  memset(&servaddr, 0, sizeof(servaddr));
+  servaddr.sin_family = AF_INET;
+  servaddr.sin_port = htons(atoi(argv[optind + 1]));
+  if (inet_pton(AF_INET, argv[optind], &servaddr.sin_addr) <= 0) {
+    printf("Bad address %s\n", argv[optind]);
+    exit(1);
+  }
+
+  // Сообщения, соединения и темп делятся между потоками поровну
+  struct Worker *workers = calloc(threads, sizeof(struct Worker));
+  struct Worker *total = calloc(1, sizeof(struct Worker));
+  if (workers == NULL || total == NULL) {
+    printf("Can not allocate workers\n");
+    exit(1);
+  }
+  uint64_t start = NowNs();
+  for (int i = 0; i < threads; i++) {
+    struct Worker *w = &workers[i];
+    w->servaddr = servaddr;
+    w->udp = udp;
+    w->count = count / threads + (i < count % threads ? 1 : 0);
+    w->size = size;
+    w->window = window;
+    w->conns = conns / threads + (i < conns % threads ? 1 : 0);
+    w->rate = rate / threads;
+    HistInit(&w->hist);
+    if (pthread_create(&w->thread, NULL, udp ? RunUdp : RunTcp, w) != 0) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+
+  total->udp = udp;
+  total->size = size;
+  total->window = window;
+  HistInit(&total->hist);
+  for (int i = 0; i < threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    total->ok += workers[i].ok;
+    total->lost += workers[i].lost;
+    total->err |= workers[i].err;
+    HistMerge(&total->hist, &workers[i].hist);
+  }
+  double elapsed = (double)(NowNs() - start) / 1e9;
+
+  Report(total, threads, conns, rate, elapsed, json);
+  int err = total->err;
+  free(workers);
+  free(total);
+  return err;
+}
@@ -0,0 +1,684 @@
+/**
+ * rudp.c - Надежная передача поверх UDP: номера пакетов, SACK, таймер
+ * повтора, окно перегрузки и имитатор потерь
+ */
+
+#define _GNU_SOURCE  // sendmmsg и clock_gettime при -std=c99
+
+#include "rudp.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TYPE_DATA 1
+#define TYPE_ACK 2
+#define FLAG_FIN 1
+
+#define MS 1000000ull
+// Границы таймера повтора; на loopback RTT - десятки микросекунд,
+// поэтому нижняя граница много меньше секунды из RFC 6298
+#define RTO_MIN_NS (20 * MS)
+#define RTO_MAX_NS (2000 * MS)
+#define RTO_INITIAL_NS (200 * MS)
+// Столько таймаутов подряд без подтверждений - получатель пропал
+#define MAX_TIMEOUTS 10
+// Начальное окно перегрузки в пакетах
+#define INITIAL_CWND 10.0
+// Датаграмм в одном sendmmsg и принимаемых за один проход
+#define SEND_BATCH 32
+#define RECV_BATCH 64
+// Получатель: ожидание повторов после FIN и тишины посреди передачи
+#define LINGER_MS 300
+#define IDLE_MS 5000
+
+struct Header {
+  uint8_t type;
+  uint8_t flags;
+  uint16_t len;              // Данных в пакете
+  uint32_t conn;             // Номер передачи
+  uint32_t seq;              // DATA: номер пакета; ACK: следующий ожидаемый
+  uint32_t nsack;            // ACK: число блоков SACK после заголовка
+  uint64_t ts;               // DATA: время отправки; ACK: его эхо
+};
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void Put32(unsigned char *p, uint32_t v) {
+  p[0] = (unsigned char)(v >> 24);
+  p[1] = (unsigned char)(v >> 16);
+  p[2] = (unsigned char)(v >> 8);
+  p[3] = (unsigned char)v;
+}
+
+static uint32_t Get32(const unsigned char *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Поля в сетевом порядке байт, без выравнивания
+static void PackHeader(unsigned char *p, const struct Header *h) {
+  p[0] = h->type;
+  p[1] = h->flags;
+  p[2] = (unsigned char)(h->len >> 8);
+  p[3] = (unsigned char)h->len;
+  Put32(p + 4, h->conn);
+  Put32(p + 8, h->seq);
+  Put32(p + 12, h->nsack);
+  Put32(p + 16, (uint32_t)(h->ts >> 32));
+  Put32(p + 20, (uint32_t)h->ts);
+}
+
+static void UnpackHeader(const unsigned char *p, struct Header *h) {
+  h->type = p[0];
+  h->flags = p[1];
+  h->len = (uint16_t)(p[2] << 8 | p[3]);
+  h->conn = Get32(p + 4);
+  h->seq = Get32(p + 8);
+  h->nsack = Get32(p + 12);
+  h->ts = (uint64_t)Get32(p + 16) << 32 | Get32(p + 20);
+}
+
+/**
+ * Имитатор потерь: xorshift64* дает равномерное число в [0, 1)
+ */
+static bool ShimDrop(struct RudpSocket *rs, struct RudpStats *stats) {
+  if (rs->loss <= 0)
+    return false;
+  rs->rng ^= rs->rng >> 12;
+  rs->rng ^= rs->rng << 25;
+  rs->rng ^= rs->rng >> 27;
+  uint64_t r = rs->rng * 2685821657736338717ull;
+  if ((double)(r >> 11) / 9007199254740992.0 >= rs->loss)
+    return false;
+  stats->dropped++;
+  return true;
+}
+
+int RudpInit(struct RudpSocket *rs, int fd, int mss) {
+  if (mss <= 0 || mss > RUDP_MAX_PAYLOAD)
+    return -1;
+  memset(rs, 0, sizeof(*rs));
+  rs->fd = fd;
+  rs->mss = mss;
+  rs->rng = 1;
+  // Окно целиком должно помещаться в буферы сокета; ядро может урезать
+  // размер до net.core.rmem_max, тогда излишек станет потерями
+  int size = RUDP_MAX_WINDOW * (mss + RUDP_HEADER + 512);
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  return 0;
+}
+
+void RudpSetLoss(struct RudpSocket *rs, double loss, uint64_t seed) {
+  rs->loss = loss;
+  rs->rng = seed != 0 ? seed : 1;
+}
+
+// ОТПРАВИТЕЛЬ
+
+enum PacketState {
+  PKT_UNSENT,
+  PKT_INFLIGHT,
+  PKT_LOST,
+  PKT_ACKED
+};
+
+struct SentPacket {
+  uint64_t sent_ns;
+  uint8_t state;
+};
+
+/**
+ * Пачка датаграмм для одного sendmmsg; данные берутся прямо из буфера
+ * пользователя вторым элементом iovec
+ */
+struct SendBatch {
+  struct mmsghdr msgs[SEND_BATCH];
+  struct iovec iovs[SEND_BATCH][2];
+  unsigned char headers[SEND_BATCH][RUDP_HEADER];
+  int n;
+};
+
+static void BatchFlush(struct RudpSocket *rs, struct SendBatch *batch) {
+  int sent = 0;
+  while (sent < batch->n) {
+    int m = sendmmsg(rs->fd, batch->msgs + sent, batch->n - sent, 0);
+    if (m < 0) {
+      // Переполнение очереди - та же потеря, ее исправит повтор
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != ENOBUFS)
+        perror("sendmmsg");
+      break;
+    }
+    sent += m;
+  }
+  batch->n = 0;
+}
+
+static void BatchAdd(struct RudpSocket *rs, struct SendBatch *batch, const struct sockaddr_in *peer,
+                     const struct Header *h, const char *payload, struct RudpStats *stats) {
+  if (ShimDrop(rs, stats))
+    return;
+  int i = batch->n++;
+  PackHeader(batch->headers[i], h);
+  batch->iovs[i][0].iov_base = batch->headers[i];
+  batch->iovs[i][0].iov_len = RUDP_HEADER;
+  batch->iovs[i][1].iov_base = (void *)payload;
+  batch->iovs[i][1].iov_len = h->len;
+  memset(&batch->msgs[i], 0, sizeof(batch->msgs[i]));
+  batch->msgs[i].msg_hdr.msg_name = (void *)peer;
+  batch->msgs[i].msg_hdr.msg_namelen = sizeof(*peer);
+  batch->msgs[i].msg_hdr.msg_iov = batch->iovs[i];
+  batch->msgs[i].msg_hdr.msg_iovlen = 2;
+  if (batch->n == SEND_BATCH)
+    BatchFlush(rs, batch);
+}
+
+/**
+ * Состояние отправителя одной передачи
+ */
+struct Sender {
+  struct RudpSocket *rs;
+  const struct sockaddr_in *peer;
+  const char *data;
+  size_t len;
+  uint32_t conn;
+  uint32_t count;            // Пакетов в передаче
+  struct SentPacket *pkts;
+  uint32_t una;              // Первый неподтвержденный
+  uint32_t nxt;              // Следующий новый
+  uint32_t inflight;
+  // Окно перегрузки
+  double cwnd;
+  double ssthresh;
+  bool recovery;
+  uint32_t recovery_point;   // Восстановление кончится, когда una дойдет сюда
+  // Время
+  uint64_t srtt;
+  uint64_t rttvar;
+  uint64_t min_rtt;
+  uint64_t rto;
+  uint64_t rto_deadline;     // 0 - таймер не запущен
+  uint64_t probe_deadline;   // 0 - проба хвоста отправлена или не нужна
+  uint64_t rack_ns;          // Самое позднее время отправки среди подтвержденных
+  struct RudpStats *stats;
+};
+
+/**
+ * Срок пробы хвоста: два RTT без подтверждений; пока RTT неизвестен,
+ * остается только RTO
+ */
+static uint64_t ProbeTimeout(const struct Sender *s) {
+  if (s->srtt == 0)
+    return 0;
+  return 2 * s->srtt > MS ? 2 * s->srtt : MS;
+}
+
+static void SendPacket(struct Sender *s, struct SendBatch *batch, uint32_t seq, uint64_t now) {
+  size_t offset = (size_t)seq * s->rs->mss;
+  size_t left = s->len - offset;
+  struct Header h;
+  memset(&h, 0, sizeof(h));
+  h.type = TYPE_DATA;
+  h.flags = seq == s->count - 1 ? FLAG_FIN : 0;
+  h.len = (uint16_t)(left < (size_t)s->rs->mss ? left : (size_t)s->rs->mss);
+  h.conn = s->conn;
+  h.seq = seq;
+  h.ts = now;
+  BatchAdd(s->rs, batch, s->peer, &h, s->data + offset, s->stats);
+
+  if (s->pkts[seq].state != PKT_UNSENT)
+    s->stats->retransmits++;
+  s->pkts[seq].state = PKT_INFLIGHT;
+  s->pkts[seq].sent_ns = now;
+  s->inflight++;
+  s->stats->packets++;
+  if (s->rto_deadline == 0) {
+    s->rto_deadline = now + s->rto;
+    uint64_t pto = ProbeTimeout(s);
+    s->probe_deadline = pto != 0 ? now + pto : 0;
+  }
+}
+
+/**
+ * Проба хвоста (как TLP в TCP): потерю последних пакетов окна не выявить
+ * по более поздним подтверждениям, поэтому через два RTT тишины уходит
+ * новый пакет или повтор последнего; ACK на него покажет, что потеряно,
+ * без ожидания RTO
+ */
+static void SendProbe(struct Sender *s, struct SendBatch *batch, uint64_t now) {
+  if (s->nxt < s->count && s->nxt - s->una < RUDP_MAX_WINDOW) {
+    SendPacket(s, batch, s->nxt++, now);
+  } else {
+    uint32_t seq = s->nxt;
+    while (seq > s->una && s->pkts[seq - 1].state != PKT_INFLIGHT)
+      seq--;
+    if (seq == s->una)
+      return;
+    s->pkts[seq - 1].state = PKT_LOST;
+    s->inflight--;
+    SendPacket(s, batch, seq - 1, now);
+  }
+  BatchFlush(s->rs, batch);
+}
+
+static bool MarkAcked(struct Sender *s, uint32_t seq) {
+  struct SentPacket *pkt = &s->pkts[seq];
+  if (pkt->state == PKT_ACKED || pkt->state == PKT_UNSENT)
+    return false;
+  if (pkt->state == PKT_INFLIGHT)
+    s->inflight--;
+  pkt->state = PKT_ACKED;
+  if (pkt->sent_ns > s->rack_ns)
+    s->rack_ns = pkt->sent_ns;
+  return true;
+}
+
+static void UpdateRtt(struct Sender *s, uint64_t rtt) {
+  if (rtt < s->min_rtt)
+    s->min_rtt = rtt;
+  if (s->srtt == 0) {
+    s->srtt = rtt;
+    s->rttvar = rtt / 2;
+  } else {
+    uint64_t diff = s->srtt > rtt ? s->srtt - rtt : rtt - s->srtt;
+    s->rttvar = (3 * s->rttvar + diff) / 4;
+    s->srtt = (7 * s->srtt + rtt) / 8;
+  }
+  uint64_t var = 4 * s->rttvar > MS ? 4 * s->rttvar : MS;
+  s->rto = s->srtt + var;
+  if (s->rto < RTO_MIN_NS)
+    s->rto = RTO_MIN_NS;
+  if (s->rto > RTO_MAX_NS)
+    s->rto = RTO_MAX_NS;
+}
+
+/**
+ * Разбор ACK: накопительное подтверждение и блоки SACK
+ *
+ * @return число впервые подтвержденных пакетов
+ */
+static uint32_t HandleAck(struct Sender *s, const unsigned char *buf, ssize_t r) {
+  struct Header h;
+  UnpackHeader(buf, &h);
+  if (h.type != TYPE_ACK || h.conn != s->conn || h.nsack > RUDP_SACK_BLOCKS ||
+      r < (ssize_t)(RUDP_HEADER + 8 * h.nsack))
+    return 0;
+
+  // Эхо времени отправки: RTT без неоднозначности повторов
+  uint64_t now = NowNs();
+  if (h.ts != 0 && h.ts <= now)
+    UpdateRtt(s, now - h.ts);
+
+  uint32_t acked = 0;
+  uint32_t cum = h.seq < s->nxt ? h.seq : s->nxt;
+  for (uint32_t seq = s->una; seq < cum; seq++)
+    acked += MarkAcked(s, seq);
+  for (uint32_t i = 0; i < h.nsack; i++) {
+    uint32_t start = Get32(buf + RUDP_HEADER + 8 * i);
+    uint32_t end = Get32(buf + RUDP_HEADER + 8 * i + 4);
+    if (start < s->una)
+      start = s->una;
+    if (end > s->nxt)
+      end = s->nxt;
+    for (uint32_t seq = start; seq < end; seq++)
+      acked += MarkAcked(s, seq);
+  }
+  while (s->una < s->nxt && s->pkts[s->una].state == PKT_ACKED)
+    s->una++;
+  return acked;
+}
+
+/**
+ * Потерян пакет в полете, отправленный раньше самого позднего
+ * подтвержденного больше чем на четверть минимального RTT
+ */
+static bool DetectLoss(struct Sender *s) {
+  uint64_t reo = s->min_rtt / 4;
+  bool lost = false;
+  for (uint32_t seq = s->una; seq < s->nxt; seq++) {
+    struct SentPacket *pkt = &s->pkts[seq];
+    if (pkt->state == PKT_INFLIGHT && pkt->sent_ns + reo < s->rack_ns) {
+      pkt->state = PKT_LOST;
+      s->inflight--;
+      lost = true;
+    }
+  }
+  return lost;
+}
+
+static void EnterRecovery(struct Sender *s) {
+  s->ssthresh = s->cwnd / 2 > 2 ? s->cwnd / 2 : 2;
+  s->cwnd = s->ssthresh;
+  s->recovery = true;
+  s->recovery_point = s->nxt;
+}
+
+/**
+ * Надежная отправка len байт из data; возвращается, когда получатель
+ * подтвердил все, включая FIN
+ *
+ * @return 0 при успехе, -1 при ошибке или пропаже получателя
+ */
+int RudpSend(struct RudpSocket *rs, const struct sockaddr_in *peer, const char *data, size_t len,
+             struct RudpStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  struct Sender s;
+  memset(&s, 0, sizeof(s));
+  s.rs = rs;
+  s.peer = peer;
+  s.data = data;
+  s.len = len;
+  s.stats = stats;
+  s.count = len == 0 ? 1 : (uint32_t)((len + rs->mss - 1) / rs->mss);
+  s.conn = (uint32_t)(NowNs() * 2654435761u) ^ (uint32_t)getpid();
+  if (s.conn == 0 || s.conn == rs->last_conn)
+    s.conn++;
+  s.cwnd = INITIAL_CWND;
+  s.ssthresh = RUDP_MAX_WINDOW;
+  s.min_rtt = UINT64_MAX;
+  s.rto = RTO_INITIAL_NS;
+  s.pkts = calloc(s.count, sizeof(struct SentPacket));
+  struct SendBatch *batch = malloc(sizeof(struct SendBatch));
+  if (s.pkts == NULL || batch == NULL) {
+    free(s.pkts);
+    free(batch);
+    return -1;
+  }
+  batch->n = 0;
+
+  unsigned char ackbuf[RUDP_HEADER + 8 * RUDP_SACK_BLOCKS];
+  int timeouts_in_row = 0;
+  int err = 0;
+  uint64_t start = NowNs();
+  while (s.una < s.count) {
+    // Сначала повторы потерянных, затем новые пакеты, пока пускает окно
+    uint64_t now = NowNs();
+    uint32_t wnd = s.cwnd < RUDP_MAX_WINDOW ? (uint32_t)s.cwnd : RUDP_MAX_WINDOW;
+    if (wnd < 1)
+      wnd = 1;
+    for (uint32_t seq = s.una; seq < s.nxt && s.inflight < wnd; seq++) {
+      if (s.pkts[seq].state == PKT_LOST)
+        SendPacket(&s, batch, seq, now);
+    }
+    while (s.nxt < s.count && s.inflight < wnd && s.nxt - s.una < RUDP_MAX_WINDOW)
+      SendPacket(&s, batch, s.nxt++, now);
+    BatchFlush(rs, batch);
+
+    // Ожидание ACK не дольше срока пробы или таймера
+    now = NowNs();
+    uint64_t deadline = s.rto_deadline;
+    if (s.probe_deadline != 0 && s.probe_deadline < deadline)
+      deadline = s.probe_deadline;
+    int wait_ms = 0;
+    if (deadline > now)
+      wait_ms = (int)((deadline - now + MS - 1) / MS);
+    struct pollfd pfd = {rs->fd, POLLIN, 0};
+    if (poll(&pfd, 1, wait_ms) < 0 && errno != EINTR) {
+      perror("poll");
+      err = -1;
+      break;
+    }
+
+    // Все пришедшие ACK
+    uint32_t acked = 0;
+    ssize_t r;
+    while ((r = recv(rs->fd, ackbuf, sizeof(ackbuf), MSG_DONTWAIT)) >= RUDP_HEADER)
+      acked += HandleAck(&s, ackbuf, r);
+
+    // Рост окна: медленный старт до ssthresh, затем на пакет за окно
+    if (acked > 0 && !s.recovery) {
+      s.cwnd += s.cwnd < s.ssthresh ? acked : acked / s.cwnd;
+      if (s.cwnd > RUDP_MAX_WINDOW)
+        s.cwnd = RUDP_MAX_WINDOW;
+    }
+    if (s.recovery && s.una >= s.recovery_point)
+      s.recovery = false;
+    if (DetectLoss(&s) && !s.recovery)
+      EnterRecovery(&s);
+
+    // Таймер: перезапуск при подтверждении, при истечении - все в полете потеряно
+    now = NowNs();
+    if (acked > 0) {
+      timeouts_in_row = 0;
+      s.rto_deadline = s.inflight > 0 ? now + s.rto : 0;
+      uint64_t pto = ProbeTimeout(&s);
+      s.probe_deadline = s.inflight > 0 && pto != 0 ? now + pto : 0;
+    } else if (s.probe_deadline != 0 && now >= s.probe_deadline && now < s.rto_deadline) {
+      s.probe_deadline = 0;
+      SendProbe(&s, batch, now);
+    } else if (s.rto_deadline != 0 && now >= s.rto_deadline) {
+      stats->timeouts++;
+      if (++timeouts_in_row > MAX_TIMEOUTS) {
+        err = -1;
+        break;
+      }
+      for (uint32_t seq = s.una; seq < s.nxt; seq++) {
+        if (s.pkts[seq].state == PKT_INFLIGHT)
+          s.pkts[seq].state = PKT_LOST;
+      }
+      // Медленный старт заново с одного пакета, как в TCP после RTO
+      s.inflight = 0;
+      s.ssthresh = s.cwnd / 2 > 2 ? s.cwnd / 2 : 2;
+      s.cwnd = 1;
+      s.recovery = false;
+      s.rto = s.rto * 2 < RTO_MAX_NS ? s.rto * 2 : RTO_MAX_NS;
+      s.rto_deadline = 0;
+      s.probe_deadline = 0;
+    }
+  }
+
+  stats->bytes = err == 0 ? (long long)len : 0;
+  stats->seconds = (double)(NowNs() - start) / 1e9;
+  stats->srtt_ms = (double)s.srtt / 1e6;
+  free(s.pkts);
+  free(batch);
+  return err;
+}
+
+// ПОЛУЧАТЕЛЬ
+
+/**
+ * Ответ ACK: следующий ожидаемый пакет и блоки принятых за дырой
+ */
+static void SendAck(struct RudpSocket *rs, const struct sockaddr_in *peer, uint32_t conn,
+                    uint32_t expected, uint32_t highest, const bool *have, uint64_t ts,
+                    struct RudpStats *stats) {
+  unsigned char buf[RUDP_HEADER + 8 * RUDP_SACK_BLOCKS];
+  uint32_t nsack = 0;
+  uint32_t seq = expected + 1;
+  while (seq < highest && nsack < RUDP_SACK_BLOCKS) {
+    if (!have[seq % RUDP_MAX_WINDOW]) {
+      seq++;
+      continue;
+    }
+    uint32_t start = seq;
+    while (seq < highest && have[seq % RUDP_MAX_WINDOW])
+      seq++;
+    Put32(buf + RUDP_HEADER + 8 * nsack, start);
+    Put32(buf + RUDP_HEADER + 8 * nsack + 4, seq);
+    nsack++;
+  }
+
+  struct Header h;
+  memset(&h, 0, sizeof(h));
+  h.type = TYPE_ACK;
+  h.conn = conn;
+  h.seq = expected;
+  h.nsack = nsack;
+  h.ts = ts;
+  PackHeader(buf, &h);
+  if (ShimDrop(rs, stats))
+    return;
+  sendto(rs->fd, buf, RUDP_HEADER + 8 * nsack, 0, (const struct sockaddr *)peer, sizeof(*peer));
+}
+
+/**
+ * Прием одной передачи: ждет ее первый пакет, отдает данные по порядку
+ * в deliver и после FIN еще LINGER_MS (или до начала следующей передачи)
+ * отвечает на повторы, если последний ACK потерялся
+ *
+ * @return 0 при успехе, -1 при ошибке, отказе deliver или пропаже отправителя
+ */
+int RudpRecv(struct RudpSocket *rs, RudpDeliver deliver, void *ctx, struct sockaddr_in *peer,
+             struct RudpStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  size_t max_packet = RUDP_HEADER + RUDP_MAX_PAYLOAD;
+  unsigned char *packet = malloc(max_packet);
+  char *store = NULL;        // Пакеты не по порядку: RUDP_MAX_WINDOW мест по slot байт
+  uint16_t *lens = calloc(RUDP_MAX_WINDOW, sizeof(uint16_t));
+  bool *have = calloc(RUDP_MAX_WINDOW, sizeof(bool));
+  if (packet == NULL || lens == NULL || have == NULL) {
+    free(packet);
+    free(lens);
+    free(have);
+    return -1;
+  }
+
+  bool started = false, done = false;
+  uint32_t conn = 0, expected = 0, highest = 0, fin_seq = UINT32_MAX;
+  size_t slot = 0;
+  uint64_t start = 0, finish = 0;
+  int err = 0;
+  while (1) {
+    struct pollfd pfd = {rs->fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, !started ? -1 : done ? LINGER_MS : IDLE_MS);
+    if (ready < 0 && errno != EINTR) {
+      perror("poll");
+      err = -1;
+      break;
+    }
+    if (ready == 0) {
+      // Тишина: после FIN - конец, посреди передачи - отправитель пропал
+      err = done ? 0 : -1;
+      break;
+    }
+
+    bool need_ack = false, next = false;
+    uint64_t ack_ts = 0;
+    for (int i = 0; i < RECV_BATCH && err == 0; i++) {
+      struct sockaddr_in from;
+      socklen_t fromlen = sizeof(from);
+      // После FIN пакет новой передачи остается в сокете для следующего вызова
+      if (done && recv(rs->fd, packet, RUDP_HEADER, MSG_DONTWAIT | MSG_PEEK) == RUDP_HEADER &&
+          packet[0] == TYPE_DATA && Get32(packet + 4) != conn) {
+        next = true;
+        break;
+      }
+      ssize_t r = recvfrom(rs->fd, packet, max_packet, MSG_DONTWAIT, (struct sockaddr *)&from,
+                           &fromlen);
+      if (r < 0)
+        break;
+      struct Header h;
+      if (r < RUDP_HEADER)
+        continue;
+      UnpackHeader(packet, &h);
+      if (h.type != TYPE_DATA || r != RUDP_HEADER + h.len)
+        continue;
+
+      // Отправитель прошлой передачи не получил последний ACK
+      if (!started && h.conn == rs->last_conn) {
+        SendAck(rs, &from, h.conn, rs->last_end, 0, have, h.ts, stats);
+        continue;
+      }
+      // Новая передача начинается только с пакета 0
+      if (!started) {
+        if (h.seq != 0)
+          continue;
+        started = true;
+        conn = h.conn;
+        *peer = from;
+        start = NowNs();
+      }
+      if (h.conn != conn)
+        continue;
+      stats->packets++;
+      need_ack = true;
+      ack_ts = h.ts;
+
+      uint32_t seq = h.seq;
+      if (seq < expected || (seq > expected && seq < highest && have[seq % RUDP_MAX_WINDOW])) {
+        stats->duplicates++;
+        continue;
+      }
+      if (seq >= expected + RUDP_MAX_WINDOW)
+        continue;
+      if (h.flags & FLAG_FIN)
+        fin_seq = seq;
+      const char *payload = (const char *)packet + RUDP_HEADER;
+
+      if (seq == expected) {
+        // По порядку: сразу получателю, затем накопленные следом
+        if (deliver(ctx, payload, h.len) != 0)
+          err = -1;
+        stats->bytes += h.len;
+        expected++;
+        while (err == 0 && expected < highest && have[expected % RUDP_MAX_WINDOW]) {
+          uint32_t k = expected % RUDP_MAX_WINDOW;
+          if (deliver(ctx, store + k * slot, lens[k]) != 0)
+            err = -1;
+          stats->bytes += lens[k];
+          have[k] = false;
+          expected++;
+        }
+      } else {
+        // Место под пакет - по размеру первого отложенного: все пакеты,
+        // кроме последнего, одного размера
+        if (store == NULL) {
+          slot = h.len;
+          if ((h.flags & FLAG_FIN) && slot < (size_t)rs->mss)
+            slot = rs->mss;
+          if (slot == 0)
+            slot = 1;
+          if ((store = malloc(RUDP_MAX_WINDOW * slot)) == NULL) {
+            err = -1;
+            break;
+          }
+        }
+        if (h.len > slot)
+          continue;
+        uint32_t k = seq % RUDP_MAX_WINDOW;
+        memcpy(store + k * slot, payload, h.len);
+        lens[k] = h.len;
+        have[k] = true;
+      }
+      if (seq + 1 > highest)
+        highest = seq + 1;
+      if (highest < expected)
+        highest = expected;
+      if (!done && expected > fin_seq) {
+        done = true;
+        finish = NowNs();
+      }
+    }
+
+    if (need_ack)
+      SendAck(rs, peer, conn, expected, highest, have, ack_ts, stats);
+    if (err != 0 || next)
+      break;
+  }
+
+  if (done) {
+    rs->last_conn = conn;
+    rs->last_end = expected;
+  }
+  stats->seconds = done ? (double)(finish - start) / 1e9 : 0;
+  free(packet);
+  free(store);
+  free(lens);
+  free(have);
+  return err;
+}
@@ -0,0 +1,70 @@
+#ifndef RUDP_H
+#define RUDP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <netinet/in.h>
+
+/**
+ * Надежная передача потока байт поверх UDP
+ *
+ * Поток режется на пакеты по mss байт с номерами 0, 1, ...; последний
+ * помечен FIN. Получатель отдает данные строго по порядку и отвечает ACK
+ * с номером следующего ожидаемого пакета, блоками уже принятых пакетов
+ * за дырой (SACK) и эхом времени отправки для замера RTT.
+ *
+ * Отправитель держит в полете не больше окна перегрузки (cwnd): медленный
+ * старт, затем линейный рост, при потере окно делится пополам. Пакет
+ * считается потерянным, если подтвержден пакет, отправленный заметно
+ * позже (как RACK в TCP), или по таймеру RTO (RFC 6298), после которого
+ * окно сбрасывается до одного пакета.
+ *
+ * Имитатор потерь выбрасывает заданную долю исходящих датаграмм
+ * (и данных, и ACK) для проверки на loopback.
+ */
+
+// Заголовок датаграммы: тип, флаги, длина, передача, номер, число SACK, время
+#define RUDP_HEADER 24
+#define RUDP_MAX_PAYLOAD (65507 - RUDP_HEADER)
+// Наибольшее число пакетов в полете и в буфере получателя
+#define RUDP_MAX_WINDOW 1024
+// Блоков SACK в одном ACK
+#define RUDP_SACK_BLOCKS 8
+
+struct RudpSocket {
+  int fd;
+  int mss;                   // Данных в одном пакете
+  double loss;               // Доля выбрасываемых исходящих датаграмм
+  uint64_t rng;              // Состояние генератора имитатора потерь
+  uint32_t last_conn;        // Завершенная передача: ее повторы не начинают новую,
+  uint32_t last_end;         // а получают ACK на все ее пакеты
+};
+
+/**
+ * Итоги одной передачи
+ */
+struct RudpStats {
+  long long bytes;
+  uint32_t packets;          // Отправлено пакетов данных с повторами / принято
+  uint32_t retransmits;
+  uint32_t timeouts;
+  uint32_t duplicates;       // Повторно принятые пакеты
+  uint32_t dropped;          // Выброшено имитатором потерь
+  double seconds;
+  double srtt_ms;
+};
+
+/**
+ * Получатель данных: 0 - успех, иначе передача прерывается
+ */
+typedef int (*RudpDeliver)(void *ctx, const char *data, size_t len);
+
+int RudpInit(struct RudpSocket *rs, int fd, int mss);
+void RudpSetLoss(struct RudpSocket *rs, double loss, uint64_t seed);
+int RudpSend(struct RudpSocket *rs, const struct sockaddr_in *peer, const char *data, size_t len,
+             struct RudpStats *stats);
+int RudpRecv(struct RudpSocket *rs, RudpDeliver deliver, void *ctx, struct sockaddr_in *peer,
+             struct RudpStats *stats);
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * slab.c - Пул буферов одного размера, выделяемых пластинами
+ */
+
+#define _POSIX_C_SOURCE 200809L  // posix_memalign при -std=c99
+
+#include "slab.h"
+
+#include <stdlib.h>
+
+// Выравнивание буферов: соседние буферы не делят строку кэша
+#define SLAB_ALIGN 64
+
+void SlabInit(struct SlabPool *pool, size_t buf_size) {
+  if (buf_size < sizeof(void *))
+    buf_size = sizeof(void *);
+  pool->buf_size = (buf_size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+  pool->free_list = NULL;
+  pool->slabs = NULL;
+  pool->slabs_num = 0;
+  pool->slabs_cap = 0;
+  pool->in_use = 0;
+}
+
+/**
+ * Новая пластина: все ее буферы добавляются в список свободных
+ */
+static int SlabGrow(struct SlabPool *pool) {
+  if (pool->slabs_num == pool->slabs_cap) {
+    int cap = pool->slabs_cap * 2 + 8;
+    void **grown = realloc(pool->slabs, cap * sizeof(void *));
+    if (grown == NULL)
+      return -1;
+    pool->slabs = grown;
+    pool->slabs_cap = cap;
+  }
+  void *slab;
+  if (posix_memalign(&slab, SLAB_ALIGN, pool->buf_size * SLAB_PER_SLAB) != 0)
+    return -1;
+  pool->slabs[pool->slabs_num++] = slab;
+  for (int i = SLAB_PER_SLAB - 1; i >= 0; i--) {
+    void **buf = (void **)((char *)slab + (size_t)i * pool->buf_size);
+    *buf = pool->free_list;
+    pool->free_list = buf;
+  }
+  return 0;
+}
+
+void *SlabAlloc(struct SlabPool *pool) {
+  if (pool->free_list == NULL && SlabGrow(pool) < 0)
+    return NULL;
+  void **buf = pool->free_list;
+  pool->free_list = *buf;
+  pool->in_use++;
+  return buf;
+}
+
+void SlabFree(struct SlabPool *pool, void *buf) {
+  *(void **)buf = pool->free_list;
+  pool->free_list = buf;
+  pool->in_use--;
+}
+
+void SlabDestroy(struct SlabPool *pool) {
+  for (int i = 0; i < pool->slabs_num; i++)
+    free(pool->slabs[i]);
+  free(pool->slabs);
+  SlabInit(pool, pool->buf_size);
+}
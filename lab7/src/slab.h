@@ -0,0 +1,34 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+/**
+ * Пул буферов одного размера
+ *
+ * Память берется у системы пластинами (slab) по SLAB_PER_SLAB буферов,
+ * свободные буферы связаны в список через свои первые байты, так что
+ * выдача и возврат - несколько инструкций без malloc. Пластины
+ * не возвращаются до SlabDestroy: память пула равна наибольшему числу
+ * одновременно занятых буферов, а не числу соединений.
+ *
+ * Пул не потокобезопасен: у каждого потока сервера свой.
+ */
+
+#define SLAB_PER_SLAB 64
+
+struct SlabPool {
+  size_t buf_size;           // Размер буфера, выровненный до строки кэша
+  void *free_list;
+  void **slabs;
+  int slabs_num;
+  int slabs_cap;
+  int in_use;                // Выданных буферов
+};
+
+void SlabInit(struct SlabPool *pool, size_t buf_size);
+void *SlabAlloc(struct SlabPool *pool);
+void SlabFree(struct SlabPool *pool, void *buf);
+void SlabDestroy(struct SlabPool *pool);
+
+#endif
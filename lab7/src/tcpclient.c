@@ -1,25 +1,270 @@
+#define _GNU_SOURCE  // MSG_ZEROCOPY и clock_gettime при -std=c99
+
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define HAVE_MSG_ZEROCOPY 1
+#endif
+
 #define SADDR struct sockaddr
 
+/**
+ * Способ передачи данных в сокет
+ * copy     - read в буфер BUFSIZE и write из него (две копии через пользователя)
+ * sendfile - ядро само передает файл в сокет порциями по BUFSIZE
+ * zerocopy - send(MSG_ZEROCOPY) из отображенного файла: ядро отправляет
+ *            страницы файла, завершение приходит в очередь ошибок сокета
+ */
+enum SendMode {
+  SEND_COPY,
+  SEND_SENDFILE,
+  SEND_ZEROCOPY
+};
+
+static const char *send_mode_names[] = {"copy", "sendfile", "zerocopy"};
+
+static void PrintUsage(const char *name) {
+  printf("Usage: %s <IP> <PORT> <BUFSIZE> [--file PATH] [--send copy|sendfile|zerocopy]\n",
+         name);
+}
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Передача через буфер вместе с приемом ответа: poll ждет и источник,
+ * и сокет, так что ответ эхо-сервера читается, пока данные еще уходят.
+ * Без этого клиент, не читающий ответ, и сервер, не читающий новые
+ * данные до отправки ответа, ждут друг друга, как только заполнятся
+ * буферы сокетов. Ответ выводится, если print_replies; после конца
+ * источника запись закрывается и ответ читается до закрытия сервером
+ */
+static long long SendCopy(int fd, int in, char *buf, int bufsize, bool print_replies) {
+  char *reply = malloc(bufsize);
+  if (reply == NULL) {
+    perror("malloc");
+    return -1;
+  }
+  long long total = 0;
+  int len = 0, off = 0;      // Неотправленная часть buf: [off; len)
+  bool in_eof = false, sock_eof = false, failed = false;
+  while (!sock_eof && !failed) {
+    // Новая порция читается из источника, только когда прежняя отправлена
+    bool want_in = !in_eof && off == len;
+    struct pollfd pfds[2] = {
+      {fd, (short)(POLLIN | (off < len ? POLLOUT : 0)), 0},
+      {in, POLLIN, 0}
+    };
+    if (poll(pfds, want_in ? 2 : 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("poll");
+      failed = true;
+      continue;
+    }
+
+    if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t r = recv(fd, reply, bufsize, MSG_DONTWAIT);
+      if (r > 0 && print_replies) {
+        fwrite(reply, 1, r, stdout);
+        fflush(stdout);
+      } else if (r == 0) {
+        sock_eof = true;
+      } else if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("read");
+        failed = true;
+      }
+    }
+
+    // Сокет может принять не все: остаток ждет следующего POLLOUT
+    if (!failed && off < len && (pfds[0].revents & POLLOUT)) {
+      ssize_t w = send(fd, buf + off, len - off, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (w > 0)
+        off += (int)w;
+      else if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("write");
+        failed = true;
+      }
+    }
+
+    if (!failed && want_in && (pfds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+      int nread = read(in, buf, bufsize);
+      if (nread < 0) {
+        perror("read");
+        failed = true;
+      } else if (nread == 0) {
+        // Все отправлено: сервер закроет соединение, когда прочитает и ответит
+        in_eof = true;
+        shutdown(fd, SHUT_WR);
+      } else {
+        len = nread;
+        off = 0;
+        total += nread;
+      }
+    }
+  }
+  free(reply);
+  return failed ? -1 : total;
+}
+
+static long long SendFile(int fd, int in, off_t size, int bufsize) {
+  off_t offset = 0;
+  while (offset < size) {
+    size_t chunk = size - offset < bufsize ? (size_t)(size - offset) : (size_t)bufsize;
+    if (sendfile(fd, in, &offset, chunk) <= 0) {
+      perror("sendfile");
+      return -1;
+    }
+  }
+  return offset;
+}
+
+#ifdef HAVE_MSG_ZEROCOPY
+
+/**
+ * Разбор уведомлений MSG_ZEROCOPY из очереди ошибок сокета
+ *
+ * @return номер последнего завершенного вызова send плюс один; copied
+ * увеличивается, если ядро все же скопировало данные (так на loopback)
+ */
+static unsigned ReapZerocopy(int fd, unsigned completed, unsigned *copied, bool wait) {
+  while (1) {
+    if (wait) {
+      struct pollfd pfd = {fd, 0, 0};  // POLLERR приходит без запроса
+      poll(&pfd, 1, 1000);
+    }
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+      return completed;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+      struct sock_extended_err *err = (struct sock_extended_err *)CMSG_DATA(cm);
+      if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      // Завершены вызовы с номерами ee_info..ee_data
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        *copied += err->ee_data - err->ee_info + 1;
+      completed = err->ee_data + 1;
+    }
+    wait = false;
+  }
+}
+
+/**
+ * Страницы файла нельзя освобождать, пока ядро не сообщит о завершении
+ * всех отправок
+ */
+static long long SendZerocopy(int fd, int in, off_t size, int bufsize, unsigned *sends,
+                              unsigned *copied) {
+  int one = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+    perror("SO_ZEROCOPY");
+    return -1;
+  }
+  // Пустой файл нечего отображать: mmap нулевой длины - ошибка
+  *sends = 0;
+  *copied = 0;
+  if (size == 0)
+    return 0;
+  char *data = mmap(NULL, size, PROT_READ, MAP_SHARED, in, 0);
+  if (data == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+  off_t offset = 0;
+  unsigned issued = 0, completed = 0;
+  *copied = 0;
+  while (offset < size) {
+    size_t chunk = size - offset < bufsize ? (size_t)(size - offset) : (size_t)bufsize;
+    ssize_t w = send(fd, data + offset, chunk, MSG_ZEROCOPY);
+    if (w < 0 && errno == ENOBUFS) {
+      // Исчерпан лимит закрепленной памяти: ждем завершения прежних отправок
+      completed = ReapZerocopy(fd, completed, copied, true);
+      continue;
+    }
+    if (w < 0) {
+      perror("send");
+      munmap(data, size);
+      return -1;
+    }
+    offset += w;
+    issued++;
+    completed = ReapZerocopy(fd, completed, copied, false);
+  }
+  while (completed != issued)
+    completed = ReapZerocopy(fd, completed, copied, true);
+  munmap(data, size);
+  *sends = issued;
+  return offset;
+}
+
+#endif
+
 int main(int argc, char *argv[]) {
+  // Необязательные параметры: передача файла и способ передачи
+  const char *path = NULL;
+  enum SendMode mode = SEND_COPY;
+  while (1) {
+    static struct option options[] = {
+      {"file", required_argument, 0, 0},
+      {"send", required_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c != 0) {
+      PrintUsage(argv[0]);
+      exit(1);
+    }
+    if (option_index == 0)
+      path = optarg;
+    if (option_index == 1) {
+      int i = 0;
+      while (i < 3 && strcmp(optarg, send_mode_names[i]) != 0)
+        i++;
+      if (i == 3) {
+        printf("Send mode must be copy, sendfile or zerocopy\n");
+        exit(1);
+      }
+      mode = (enum SendMode)i;
+    }
+  }
+
   // Проверка аргументов командной строки
-  if (argc < 4) {
-    printf("Usage: %s <IP> <PORT> <BUFSIZE>\n", argv[0]);
+  if (argc - optind < 3) {
+    PrintUsage(argv[0]);
     exit(1);
   }
 
   // Парсинг аргументов
-  char *ip = argv[1];
-  int port = atoi(argv[2]);
-  int bufsize = atoi(argv[3]);
+  char *ip = argv[optind];
+  int port = atoi(argv[optind + 1]);
+  int bufsize = atoi(argv[optind + 2]);
 
   // Валидация аргументов
   if (port <= 0 || bufsize <= 0) {
@@ -27,6 +272,25 @@ int main(int argc, char *argv[]) {
     exit(1);
   }
 
+  // Источник данных: файл или стандартный ввод; без копирования
+  // передается только обычный файл
+  int in = 0;
+  if (path != NULL && (in = open(path, O_RDONLY)) < 0) {
+    perror(path);
+    exit(1);
+  }
+  struct stat st;
+  if (mode != SEND_COPY && (fstat(in, &st) < 0 || !S_ISREG(st.st_mode))) {
+    printf("Send mode %s needs a regular file\n", send_mode_names[mode]);
+    exit(1);
+  }
+#ifndef HAVE_MSG_ZEROCOPY
+  if (mode == SEND_ZEROCOPY) {
+    printf("MSG_ZEROCOPY is not available, using sendfile\n");
+    mode = SEND_SENDFILE;
+  }
+#endif
+
   int fd;
   int nread;
   char *buf = malloc(bufsize); // Динамический буфер
@@ -61,19 +325,42 @@ int main(int argc, char *argv[]) {
   }
 
   printf("Connected to server %s:%d\n", ip, port);
-  printf("Input message to send (Ctrl+D to exit):\n");
-  
+  if (path == NULL)
+    printf("Input message to send (Ctrl+D to exit):\n");
+
   // Чтение и отправка сообщений
-  while ((nread = read(0, buf, bufsize)) > 0) {
-    if (write(fd, buf, nread) < 0) {
-      perror("write");
-      break;
+  double start = NowSec();
+  long long total = -1;
+  unsigned zc_sends = 0, zc_copied = 0;
+  if (mode == SEND_COPY)
+    total = SendCopy(fd, in, buf, bufsize, path == NULL);
+  else if (mode == SEND_SENDFILE)
+    total = SendFile(fd, in, st.st_size, bufsize);
+#ifdef HAVE_MSG_ZEROCOPY
+  else
+    total = SendZerocopy(fd, in, st.st_size, bufsize, &zc_sends, &zc_copied);
+#endif
+
+  // Сервер закрывает соединение, когда прочитал все данные (copy ждет
+  // этого сам, читая ответ по ходу передачи)
+  if (mode != SEND_COPY) {
+    shutdown(fd, SHUT_WR);
+    while ((nread = read(fd, buf, bufsize)) > 0) {
     }
   }
+  double elapsed = NowSec() - start;
+  if (path != NULL && total >= 0)
+    printf("Sent %lld bytes in %.3f s: %.2f GB/s (%s, bufsize %d)\n", total, elapsed,
+           (double)total / elapsed / 1e9, send_mode_names[mode], bufsize);
+  // На loopback ядро не может отдать страницы без копии и сообщает об этом
+  if (zc_copied > 0)
+    printf("MSG_ZEROCOPY: kernel copied %u of %u sends\n", zc_copied, zc_sends);
 
   // Очистка ресурсов
   free(buf);
+  if (in != 0)
+    close(in);
   close(fd);
   printf("Connection closed\n");
-  return 0;
+  return total < 0;
 }
\ No newline at end of file
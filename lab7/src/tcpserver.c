@@ -1,42 +1,506 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np, splice и pipe2 при -std=c99
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 
+#include "log.h"
+#include "slab.h"
+#include "uring.h"
+
 #define SADDR struct sockaddr
 
-int main(int argc, char *argv[]) {
-  // Проверка аргументов командной строки
-  if (argc < 3) {
-    printf("Usage: %s <PORT> <BUFSIZE>\n", argv[0]);
-    exit(1);
+// Событий epoll за один вызов
+#define MAX_EVENTS 256
+// Пауза приема после ошибки accept, не связанной с клиентом (EMFILE, ENFILE)
+#define ACCEPT_RETRY_NS 100000000
+// Заявок в кольце io_uring и буферов приема (степень двойки)
+#define URING_ENTRIES 256
+#define URING_BUFFERS 256
+
+// Вид заявки io_uring в старших битах user_data, дескриптор - в младших
+#define TAG_ACCEPT 1ull
+#define TAG_RECV 2ull
+#define TAG_CLOSE 3ull
+#define USER_DATA(tag, fd) ((tag) << 32 | (uint32_t)(fd))
+
+static void PrintUsage(const char *name) {
+  printf("Usage: %s <PORT> <BUFSIZE> [--backend auto|epoll|uring] [--workers N] [--pin] "
+         "[--save DIR] [--recv copy|splice] [--echo] [--log-level info] [--log-sample N] [--log-sync]\n",
+         name);
+}
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Поднятие мягкого лимита открытых файлов до жесткого,
+ * чтобы сервер мог держать десятки тысяч простаивающих соединений
+ */
+static void RaiseFileLimit(void) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
   }
+}
 
-  // Парсинг аргументов
-  int port = atoi(argv[1]);
-  int bufsize = atoi(argv[2]);
+static int SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0)
+    return -1;
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
 
-  // Валидация аргументов
-  if (port <= 0 || bufsize <= 0) {
-    printf("Invalid port or buffer size\n");
-    exit(1);
+/**
+ * Запись о новом соединении; адрес клиента узнается, только если
+ * запись будет выведена
+ */
+static void LogConnection(int cfd) {
+  if (!LogEnabled(LOG_LEVEL_INFO))
+    return;
+  struct sockaddr_in cliaddr;
+  socklen_t clilen = sizeof(cliaddr);
+  char client_ip[INET_ADDRSTRLEN] = "?";
+  if (getpeername(cfd, (SADDR *)&cliaddr, &clilen) == 0)
+    inet_ntop(AF_INET, &cliaddr.sin_addr, client_ip, INET_ADDRSTRLEN);
+  LOG(LOG_LEVEL_INFO, "Connection established from %s:%d", client_ip, ntohs(cliaddr.sin_port));
+}
+
+/**
+ * Сохранение соединения на диск в файл DIR/conn-N.bin. С каналом (splice)
+ * данные идут сокет -> канал -> файл внутри ядра, минуя буфер сервера;
+ * без него - read в буфер BUFSIZE и write в файл
+ */
+struct SaveConn {
+  int file;
+  int pipe_rd;               // -1 - копирование через буфер
+  int pipe_wr;
+  long long bytes;
+};
+
+static unsigned long save_seq = 0;  // Номер следующего файла, общий для потоков
+
+static int OpenSave(struct SaveConn *sc, const char *dir, bool use_splice, int bufsize) {
+  char path[4096];
+  unsigned long seq = __atomic_fetch_add(&save_seq, 1, __ATOMIC_RELAXED);
+  snprintf(path, sizeof(path), "%s/conn-%lu.bin", dir, seq);
+  sc->bytes = 0;
+  sc->pipe_rd = sc->pipe_wr = -1;
+  if ((sc->file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    perror(path);
+    return -1;
+  }
+  if (use_splice) {
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK) < 0) {
+      perror("pipe");
+      close(sc->file);
+      sc->file = -1;
+      return -1;
+    }
+    // Канал вмещает порцию BUFSIZE (ядро округляет до целых страниц)
+    fcntl(fds[1], F_SETPIPE_SZ, bufsize);
+    sc->pipe_rd = fds[0];
+    sc->pipe_wr = fds[1];
+  }
+  return 0;
+}
+
+static void CloseSave(struct SaveConn *sc) {
+  LOG(LOG_LEVEL_INFO, "Saved %lld bytes", sc->bytes);
+  close(sc->file);
+  if (sc->pipe_rd >= 0) {
+    close(sc->pipe_rd);
+    close(sc->pipe_wr);
+  }
+  sc->file = -1;
+}
+
+/**
+ * Перенос в файл всех данных, которые сокет отдает сейчас
+ *
+ * @return 1 - данные кончились, соединение открыто; 0 - клиент закрыл
+ * соединение; -1 - ошибка
+ */
+static int SaveData(int fd, struct SaveConn *sc, char *buf, int bufsize) {
+  while (1) {
+    ssize_t n;
+    if (sc->pipe_wr >= 0) {
+      n = splice(fd, NULL, sc->pipe_wr, NULL, bufsize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      // Канал сразу опустошается в файл, так что следующий splice в него не блокируется
+      for (ssize_t left = n; left > 0;) {
+        ssize_t m = splice(sc->pipe_rd, NULL, sc->file, NULL, left, SPLICE_F_MOVE);
+        if (m <= 0) {
+          perror("splice");
+          return -1;
+        }
+        left -= m;
+      }
+    } else {
+      n = read(fd, buf, bufsize);
+      for (ssize_t off = 0; off < n;) {
+        ssize_t m = write(sc->file, buf + off, n - off);
+        if (m < 0) {
+          perror("write");
+          return -1;
+        }
+        off += m;
+      }
+    }
+    if (n == 0)
+      return 0;
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 1 : -1;
+    sc->bytes += n;
+  }
+}
+
+/**
+ * Эхо: ответ клиенту теми же байтами. Буфер соединения берется из пула
+ * только на время, пока в нем есть данные, так что простаивающие
+ * соединения памяти не держат. Пока ответ не отправлен целиком,
+ * новые данные не читаются: клиент, который не читает ответы,
+ * упирается в окно TCP, а не раздувает память сервера
+ */
+struct EchoConn {
+  char *buf;                 // NULL - буфер не нужен
+  int len;
+  int off;                   // Отправлено из buf
+  bool blocked;              // Ждем EPOLLOUT вместо EPOLLIN
+};
+
+#define ECHO_DRAINED 1
+#define ECHO_BLOCKED 2
+
+/**
+ * Отправка остатка ответа и эхо всех данных, которые сокет отдает сейчас
+ *
+ * @return ECHO_DRAINED - данные кончились, буфер возвращен в пул;
+ * ECHO_BLOCKED - сокет не принимает ответ, ждем возможности записи;
+ * 0 - клиент закрыл соединение; -1 - ошибка
+ */
+static int EchoData(int fd, struct EchoConn *ec, struct SlabPool *pool, int bufsize) {
+  while (1) {
+    while (ec->buf != NULL && ec->off < ec->len) {
+      ssize_t m = send(fd, ec->buf + ec->off, ec->len - ec->off, MSG_NOSIGNAL);
+      if (m < 0 && errno == EINTR)
+        continue;
+      if (m < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? ECHO_BLOCKED : -1;
+      ec->off += (int)m;
+    }
+    if (ec->buf == NULL && (ec->buf = SlabAlloc(pool)) == NULL) {
+      perror("slab");
+      return -1;
+    }
+    ssize_t n = read(fd, ec->buf, bufsize);
+    if (n > 0) {
+      LOG(LOG_LEVEL_DEBUG, "Echo %d bytes", (int)n);
+      ec->len = (int)n;
+      ec->off = 0;
+      continue;
+    }
+    SlabFree(pool, ec->buf);
+    ec->buf = NULL;
+    if (n == 0)
+      return 0;
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? ECHO_DRAINED : -1;
   }
+}
 
-  int lfd, cfd;
-  int nread;
+/**
+ * Состояние соединения по номеру дескриптора: для сохранения или эха
+ */
+struct ConnState {
+  struct SaveConn save;
+  struct EchoConn echo;
+};
+
+/**
+ * Обслуживание на epoll: неблокирующие сокеты, данные читаются,
+ * пока сокет их отдает. С save_dir данные каждого соединения
+ * сохраняются в отдельный файл, с echo - отправляются обратно.
+ * Если accept отказывает из-за нехватки дескрипторов, слушающий сокет
+ * снимается с EPOLLIN до закрытия соединения или на ACCEPT_RETRY_NS:
+ * иначе epoll_wait возвращался бы к нему сразу же
+ */
+static int ServeEpoll(int lfd, int bufsize, const char *save_dir, bool use_splice, bool echo) {
   char *buf = malloc(bufsize); // Динамический буфер
+  int epfd = epoll_create1(0);
+  if (buf == NULL || epfd < 0 || SetNonBlocking(lfd) < 0) {
+    perror("epoll");
+    free(buf);
+    return 1;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = lfd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+  // Состояние соединений по номеру дескриптора и буферы эха
+  struct ConnState *conns = NULL;
+  int conns_size = 0;
+  struct SlabPool pool;
+  SlabInit(&pool, bufsize);
+
+  bool accept_paused = false;
+  bool accept_failing = false;  // Ошибка уже в журнале, пока очередь не разобрана
+  uint64_t accept_resume_ns = 0;
+
+  struct epoll_event events[MAX_EVENTS];
+  while (1) {
+    int timeout_ms = -1;
+    if (accept_paused) {
+      uint64_t now = NowNs();
+      timeout_ms = now < accept_resume_ns ? (int)((accept_resume_ns - now + 999999) / 1000000) : 0;
+    }
+    int n = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      break;
+    }
+    bool closed = false;
+
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd;
+      if (fd == lfd) {
+        // Принятие всех ожидающих соединений
+        int cfd;
+        while ((cfd = accept(lfd, NULL, NULL)) >= 0) {
+          if ((save_dir != NULL || echo) && cfd >= conns_size) {
+            int size = cfd * 2 + 16;
+            struct ConnState *grown = realloc(conns, size * sizeof(struct ConnState));
+            if (grown == NULL) {
+              perror("realloc");
+              close(cfd);
+              continue;
+            }
+            conns = grown;
+            conns_size = size;
+          }
+          if (save_dir != NULL && OpenSave(&conns[cfd].save, save_dir, use_splice, bufsize) < 0) {
+            close(cfd);
+            continue;
+          }
+          if (echo)
+            memset(&conns[cfd].echo, 0, sizeof(struct EchoConn));
+          ev.events = EPOLLIN;
+          ev.data.fd = cfd;
+          if (SetNonBlocking(cfd) < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev) < 0) {
+            perror("accept");
+            if (save_dir != NULL)
+              CloseSave(&conns[cfd].save);
+            close(cfd);
+            continue;
+          }
+          LogConnection(cfd);
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          accept_failing = false;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+            errno != ECONNABORTED) {
+          if (!accept_failing)
+            LOG(LOG_LEVEL_WARN, "accept: %s", strerror(errno));
+          accept_failing = true;
+          ev.events = 0;
+          ev.data.fd = lfd;
+          epoll_ctl(epfd, EPOLL_CTL_MOD, lfd, &ev);
+          accept_paused = true;
+          accept_resume_ns = NowNs() + ACCEPT_RETRY_NS;
+        }
+        continue;
+      }
+
+      // Сохранение данных от клиента; файл закрывается до сокета, так что
+      // клиент, увидевший закрытие соединения, найдет файл целиком
+      if (save_dir != NULL) {
+        if (SaveData(fd, &conns[fd].save, buf, bufsize) == 1)
+          continue;
+        CloseSave(&conns[fd].save);
+        LOG(LOG_LEVEL_INFO, "Connection closed");
+        close(fd);
+        closed = true;
+        continue;
+      }
+
+      // Эхо; пока ответ не ушел, соединение ждет записи, а не чтения
+      if (echo) {
+        struct EchoConn *ec = &conns[fd].echo;
+        int res = EchoData(fd, ec, &pool, bufsize);
+        if (res > 0) {
+          bool blocked = res == ECHO_BLOCKED;
+          if (blocked != ec->blocked) {
+            ev.events = blocked ? EPOLLOUT : EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+            ec->blocked = blocked;
+          }
+          continue;
+        }
+        if (ec->buf != NULL)
+          SlabFree(&pool, ec->buf);
+        LOG(LOG_LEVEL_INFO, "Connection closed");
+        close(fd);
+        closed = true;
+        continue;
+      }
+
+      // Обработка данных от клиента
+      // Данные копируются в запись журнала, длиннее LOG_TEXT_MAX - обрезаются
+      int nread;
+      while ((nread = read(fd, buf, bufsize)) > 0) {
+        LOG(LOG_LEVEL_INFO, "Received %d bytes: %.*s", nread, nread, buf);
+      }
+      if (nread == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        continue;
+      if (nread == -1)
+        perror("read");
+      LOG(LOG_LEVEL_INFO, "Connection closed");
+      close(fd);  // Закрытый дескриптор сам удаляется из epoll
+      closed = true;
+    }
+
+    // Освободившийся дескриптор или конец паузы возвращают прием
+    if (accept_paused && (closed || NowNs() >= accept_resume_ns)) {
+      ev.events = EPOLLIN;
+      ev.data.fd = lfd;
+      epoll_ctl(epfd, EPOLL_CTL_MOD, lfd, &ev);
+      accept_paused = false;
+    }
+  }
+
+  free(buf);
+  free(conns);
+  SlabDestroy(&pool);
+  close(epfd);
+  return 1;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Обслуживание на io_uring: один многоразовый accept на слушающий сокет
+ * и по одному многоразовому recv на соединение. Заявки каждой итерации
+ * уходят в ядро одной пачкой вместе с ожиданием результатов
+ *
+ * @return -1, если кольцо буферов недоступно (нужен epoll), иначе 1 при ошибке
+ */
+static int ServeUring(struct Uring *ring, int lfd, int bufsize) {
+  struct UringBufRing br;
+  if (UringBufRingInit(ring, &br, 0, URING_BUFFERS, (unsigned)bufsize) < 0)
+    return -1;
+  UringAcceptMultishot(ring, lfd, USER_DATA(TAG_ACCEPT, lfd));
+
+  while (1) {
+    if (UringSubmitAndWait(ring, 1) < 0) {
+      perror("io_uring_enter");
+      break;
+    }
+
+    unsigned recycled = 0;
+    struct io_uring_cqe *cqe;
+    while ((cqe = UringPeekCqe(ring)) != NULL) {
+      uint64_t tag = cqe->user_data >> 32;
+      int fd = (int)(uint32_t)cqe->user_data;
+      int res = cqe->res;
+      unsigned flags = cqe->flags;
+      UringCqeSeen(ring);
+
+      if (tag == TAG_ACCEPT) {
+        if (res >= 0) {
+          LogConnection(res);
+          UringRecvMultishot(ring, res, &br, USER_DATA(TAG_RECV, res));
+        } else {
+          LOG(LOG_LEVEL_WARN, "accept: %s", strerror(-res));
+        }
+        // Ядро завершило многоразовую заявку: она подается заново
+        if (!(flags & IORING_CQE_F_MORE))
+          UringAcceptMultishot(ring, lfd, USER_DATA(TAG_ACCEPT, lfd));
+      } else if (tag == TAG_RECV) {
+        if (res > 0) {
+          // Данные копируются в запись журнала, длиннее LOG_TEXT_MAX - обрезаются
+          uint16_t bid = URING_CQE_BID(cqe);
+          LOG(LOG_LEVEL_INFO, "Received %d bytes: %.*s", res, res, UringBuf(&br, bid));
+          UringBufRecycle(&br, bid);
+          recycled++;
+          if (!(flags & IORING_CQE_F_MORE))
+            UringRecvMultishot(ring, fd, &br, USER_DATA(TAG_RECV, fd));
+        } else if (res == -ENOBUFS) {
+          // Буферы кончились; вернутся в кольцо до отправки этой заявки
+          UringRecvMultishot(ring, fd, &br, USER_DATA(TAG_RECV, fd));
+        } else {
+          if (res < 0)
+            LOG(LOG_LEVEL_WARN, "read: %s", strerror(-res));
+          LOG(LOG_LEVEL_INFO, "Connection closed");
+          UringClose(ring, fd, USER_DATA(TAG_CLOSE, fd));
+        }
+      }
+    }
+    if (recycled > 0)
+      UringBufPublish(&br);
+  }
+
+  UringBufRingDestroy(ring, &br);
+  return 1;
+}
+
+#endif
+
+/**
+ * Поток сервера: свой слушающий сокет на общем порту (SO_REUSEPORT)
+ * и свой цикл событий; ядро распределяет новые соединения между сокетами
+ */
+struct TcpWorker {
+  pthread_t thread;
+  int id;
+  int port;
+  int bufsize;
+  bool reuseport;
+  enum IoBackend backend;
+  const char *save_dir;      // NULL - данные только выводятся в журнал
+  bool use_splice;
+  bool echo;
+  int err;
+};
+
+static int OpenListener(int port, bool reuseport) {
+  int lfd;
   struct sockaddr_in servaddr;
-  struct sockaddr_in cliaddr;
 
   // Создание сокета
   if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
     perror("socket");
-    free(buf);
-    exit(1);
+    return -1;
+  }
+
+  // Быстрый перезапуск сервера на том же порту; с несколькими потоками -
+  // по слушающему сокету на поток
+  int opt_val = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+  if (reuseport && setsockopt(lfd, SOL_SOCKET, SO_REUSEPORT, &opt_val, sizeof(opt_val)) < 0) {
+    perror("SO_REUSEPORT");
+    close(lfd);
+    return -1;
   }
 
   // Настройка адреса сервера
@@ -48,52 +512,210 @@ int main(int argc, char *argv[]) {
   // Привязка сокета
   if (bind(lfd, (SADDR *)&servaddr, sizeof(servaddr)) < 0) {
     perror("bind");
-    free(buf);
     close(lfd);
-    exit(1);
+    return -1;
   }
 
-  // Начало прослушивания
-  if (listen(lfd, 5) < 0) {
+  // Начало прослушивания: очередь по максимуму системы для потока подключений
+  if (listen(lfd, SOMAXCONN) < 0) {
     perror("listen");
-    free(buf);
     close(lfd);
-    exit(1);
+    return -1;
   }
+  return lfd;
+}
 
-  printf("TCP Server listening on port %d\n", port);
-
-  // Основной цикл обработки соединений
-  while (1) {
-    socklen_t clilen = sizeof(cliaddr);
+static void *ServeWorker(void *arg) {
+  struct TcpWorker *worker = arg;
+  int lfd = OpenListener(worker->port, worker->reuseport);
+  if (lfd < 0) {
+    worker->err = 1;
+    return NULL;
+  }
 
-    // Принятие соединения
-    if ((cfd = accept(lfd, (SADDR *)&cliaddr, &clilen)) < 0) {
-      perror("accept");
-      continue; // Продолжаем работать при ошибке accept
+  // Основной цикл обработки соединений: io_uring, если он собран
+  // и разрешен ядром, иначе epoll; сохранение на диск и эхо работают на epoll
+  int err = -1;
+#ifdef HAVE_IO_URING
+  if (worker->save_dir == NULL && !worker->echo && worker->backend != IO_BACKEND_EPOLL) {
+    struct Uring ring;
+    if (UringInit(&ring, URING_ENTRIES) == 0) {
+      if (worker->id == 0) {
+        printf("TCP Server listening on port %d (io_uring)\n", worker->port);
+        fflush(stdout);
+      }
+      err = ServeUring(&ring, lfd, worker->bufsize);
+      UringDestroy(&ring);
     }
-    
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &cliaddr.sin_addr, client_ip, INET_ADDRSTRLEN);
-    printf("Connection established from %s:%d\n", client_ip, ntohs(cliaddr.sin_port));
-
-    // Обработка данных от клиента
-    while ((nread = read(cfd, buf, bufsize)) > 0) {
-      printf("Received %d bytes: ", nread);
-      write(1, buf, nread); // Вывод на stdout
-      printf("\n");
+  }
+#endif
+  if (err == -1 && worker->backend == IO_BACKEND_URING) {
+    printf("io_uring is not available\n");
+    close(lfd);
+    worker->err = 1;
+    return NULL;
+  }
+  if (err == -1) {
+    if (worker->id == 0) {
+      printf("TCP Server listening on port %d (epoll)\n", worker->port);
+      fflush(stdout);
     }
+    err = ServeEpoll(lfd, worker->bufsize, worker->save_dir, worker->use_splice, worker->echo);
+  }
+
+  close(lfd);
+  worker->err = err;
+  return NULL;
+}
 
-    if (nread == -1) {
-      perror("read");
+int main(int argc, char *argv[]) {
+  // Необязательные параметры после PORT и BUFSIZE
+  enum IoBackend backend = IO_BACKEND_AUTO;
+  enum LogLevel log_level = LOG_LEVEL_INFO;
+  unsigned int log_sample = 1;
+  bool log_sync = false;
+  int workers_count = 1;
+  bool pin = false;
+  const char *save_dir = NULL;
+  bool use_splice = false;
+  bool echo = false;
+  while (1) {
+    static struct option options[] = {
+      {"log-level", required_argument, 0, 0},
+      {"log-sample", required_argument, 0, 0},
+      {"log-sync", no_argument, 0, 0},
+      {"backend", required_argument, 0, 0},
+      {"workers", required_argument, 0, 0},
+      {"pin", no_argument, 0, 0},
+      {"save", required_argument, 0, 0},
+      {"recv", required_argument, 0, 0},
+      {"echo", no_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c != 0) {
+      PrintUsage(argv[0]);
+      exit(1);
+    }
+    if (option_index == 0 && !LogParseLevel(optarg, &log_level)) {
+      printf("Log level must be debug, info, warn, error or off\n");
+      exit(1);
+    }
+    if (option_index == 1) {
+      if (atoi(optarg) <= 0) {
+        printf("Log sample must be positive number\n");
+        exit(1);
+      }
+      log_sample = (unsigned int)atoi(optarg);
+    }
+    if (option_index == 2)
+      log_sync = true;
+    if (option_index == 3 && !IoBackendParse(optarg, &backend)) {
+      printf("Backend must be auto, epoll or uring\n");
+      exit(1);
+    }
+    if (option_index == 4) {
+      workers_count = atoi(optarg);
+      if (workers_count <= 0) {
+        printf("Workers must be positive number\n");
+        exit(1);
+      }
+    }
+    if (option_index == 5)
+      pin = true;
+    if (option_index == 6)
+      save_dir = optarg;
+    if (option_index == 7) {
+      if (strcmp(optarg, "copy") != 0 && strcmp(optarg, "splice") != 0) {
+        printf("Receive mode must be copy or splice\n");
+        exit(1);
+      }
+      use_splice = strcmp(optarg, "splice") == 0;
     }
+    if (option_index == 8)
+      echo = true;
+  }
 
-    printf("Connection closed\n");
-    close(cfd);
+  // Проверка аргументов командной строки
+  if (argc - optind < 2) {
+    PrintUsage(argv[0]);
+    exit(1);
   }
 
-  // Очистка ресурсов (никогда не выполнится из-за бесконечного цикла)
-  free(buf);
-  close(lfd);
-  return 0;
-}
\ No newline at end of file
+  // Парсинг аргументов
+  int port = atoi(argv[optind]);
+  int bufsize = atoi(argv[optind + 1]);
+
+  // Валидация аргументов
+  if (port <= 0 || bufsize <= 0) {
+    printf("Invalid port or buffer size\n");
+    exit(1);
+  }
+  if (save_dir != NULL && backend == IO_BACKEND_URING) {
+    printf("Saving to disk works with epoll backend only\n");
+    exit(1);
+  }
+  if (echo && (save_dir != NULL || backend == IO_BACKEND_URING)) {
+    printf("Echo works with epoll backend only and without --save\n");
+    exit(1);
+  }
+  if (use_splice && save_dir == NULL) {
+    printf("Receive mode splice needs --save DIR\n");
+    exit(1);
+  }
+
+  // Сообщения о запросах форматирует и выводит фоновый поток журнала
+  if (LogInit(log_level, log_sample, log_sync) != 0) {
+    printf("Can not start log writer\n");
+    exit(1);
+  }
+
+  RaiseFileLimit();
+
+  // Потоки со своими слушающими сокетами; с --pin i-й закреплен за ядром i по кругу
+  struct TcpWorker *workers = calloc(workers_count, sizeof(struct TcpWorker));
+  if (workers == NULL) {
+    printf("Can not allocate workers\n");
+    exit(1);
+  }
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 0; i < workers_count; i++) {
+    workers[i].id = i;
+    workers[i].port = port;
+    workers[i].bufsize = bufsize;
+    workers[i].reuseport = workers_count > 1;
+    workers[i].backend = backend;
+    workers[i].save_dir = save_dir;
+    workers[i].use_splice = use_splice;
+    workers[i].echo = echo;
+    if (workers_count == 1 && !pin) {
+      ServeWorker(&workers[i]);
+      break;
+    }
+    if (pthread_create(&workers[i].thread, NULL, ServeWorker, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(1);
+    }
+    if (pin && ncpu > 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i % ncpu, &cpus);
+      pthread_setaffinity_np(workers[i].thread, sizeof(cpus), &cpus);
+    }
+  }
+  int err = 0;
+  for (int i = 0; i < workers_count; i++) {
+    if (workers_count > 1 || pin)
+      pthread_join(workers[i].thread, NULL);
+    if (workers[i].err != 0)
+      err = workers[i].err;
+  }
+
+  // Очистка ресурсов (выполняется только при ошибке цикла)
+  free(workers);
+  LogShutdown();
+  return err;
+}
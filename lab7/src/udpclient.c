@@ -1,32 +1,328 @@
+#define _GNU_SOURCE  // recvmmsg и sendmmsg при -std=c99
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "rudp.h"
+
 #define SADDR struct sockaddr
 
+// Ожидание ответа, после которого датаграммы окна считаются потерянными
+#define REPLY_TIMEOUT_MS 100
+// Наибольшее число датаграмм за один sendmmsg/recvmmsg
+#define MAX_BATCH 1024
+
+static void PrintUsage(const char *name) {
+  printf("Usage: %s <IP> <PORT> <BUFSIZE> [--count N] [--batch N] [--window W] [--threads T]\n"
+         "       %s <IP> <PORT> <BUFSIZE> --reliable [--file PATH] [--loss P]\n",
+         name, name);
+}
+
+static double NowSec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Поток замера: свой сокет, значит, свой порт отправителя; с SO_REUSEPORT
+ * на сервере потоки клиента попадают в разные сокеты сервера
+ */
+struct BenchThread {
+  pthread_t thread;
+  struct sockaddr_in servaddr;
+  int bufsize;
+  int batch;
+  int window;
+  long count;
+  long received;
+  long lost;
+  int err;
+};
+
+/**
+ * Замер в одном потоке: до window датаграмм в полете, отправка и прием
+ * пачками до batch штук одним sendmmsg/recvmmsg
+ */
+static void *RunBench(void *arg) {
+  struct BenchThread *bench = arg;
+  int batch = bench->batch;
+  char *sendline = malloc(bench->bufsize);
+  char *recvbufs = malloc((size_t)batch * bench->bufsize);
+  struct mmsghdr *send_msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct mmsghdr *recv_msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct iovec *iovs = calloc(2 * (size_t)batch, sizeof(struct iovec));
+  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sendline == NULL || recvbufs == NULL || send_msgs == NULL || recv_msgs == NULL ||
+      iovs == NULL || sockfd < 0 ||
+      connect(sockfd, (SADDR *)&bench->servaddr, sizeof(bench->servaddr)) < 0) {
+    perror("bench socket");
+    bench->err = 1;
+  }
+
+  if (bench->err == 0) {
+    struct timeval tv = {0, REPLY_TIMEOUT_MS * 1000};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    // Окно целиком должно помещаться в буфер приема
+    int rcvbuf = bench->window * (bench->bufsize + 512);
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    for (int i = 0; i < bench->bufsize; i++)
+      sendline[i] = (char)('a' + i % 26);
+    // Все отправки берут одни данные, каждый ответ - свой буфер
+    for (int i = 0; i < batch; i++) {
+      iovs[i].iov_base = sendline;
+      iovs[i].iov_len = bench->bufsize;
+      send_msgs[i].msg_hdr.msg_iov = &iovs[i];
+      send_msgs[i].msg_hdr.msg_iovlen = 1;
+      iovs[batch + i].iov_base = recvbufs + (size_t)i * bench->bufsize;
+      iovs[batch + i].iov_len = bench->bufsize;
+      recv_msgs[i].msg_hdr.msg_iov = &iovs[batch + i];
+      recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+
+  long sent = 0, inflight = 0;
+  while (bench->err == 0 && bench->received + bench->lost < bench->count) {
+    // Заполнение окна
+    while (inflight < bench->window && sent < bench->count) {
+      long k = bench->window - inflight;
+      if (k > batch)
+        k = batch;
+      if (k > bench->count - sent)
+        k = bench->count - sent;
+      int m = sendmmsg(sockfd, send_msgs, (unsigned)k, 0);
+      if (m < 0) {
+        if (errno == EINTR)
+          continue;
+        perror("sendmmsg");
+        bench->err = 1;
+        break;
+      }
+      sent += m;
+      inflight += m;
+    }
+
+    // Ожидание хотя бы одного ответа, остальные из пачки - если уже пришли
+    int want = inflight < batch ? (int)inflight : batch;
+    int r = recvmmsg(sockfd, recv_msgs, want > 0 ? want : 1, MSG_WAITFORONE, NULL);
+    if (r > 0) {
+      // Опоздавшие ответы на уже списанные датаграммы не учитываются:
+      // иначе received + lost превысило бы отправленное, а окно - свой предел
+      if (r > inflight)
+        r = (int)inflight;
+      bench->received += r;
+      inflight -= r;
+    } else if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // Ответов нет: все, что в полете, потеряно
+      bench->lost += inflight;
+      inflight = 0;
+    } else if (r < 0 && errno != EINTR) {
+      perror("recvmmsg");
+      bench->err = 1;
+    }
+  }
+
+  if (sockfd >= 0)
+    close(sockfd);
+  free(sendline);
+  free(recvbufs);
+  free(send_msgs);
+  free(recv_msgs);
+  free(iovs);
+  return NULL;
+}
+
+/**
+ * Замер пропускной способности эхо-сервера в датаграммах в секунду:
+ * count датаграмм поровну на threads потоков
+ */
+static int Bench(const struct sockaddr_in *servaddr, int bufsize, long count, int batch,
+                 int window, int threads) {
+  struct BenchThread *benches = calloc(threads, sizeof(struct BenchThread));
+  if (benches == NULL) {
+    printf("Can not allocate threads\n");
+    return 1;
+  }
+  double start = NowSec();
+  for (int i = 0; i < threads; i++) {
+    benches[i].servaddr = *servaddr;
+    benches[i].bufsize = bufsize;
+    benches[i].batch = batch;
+    benches[i].window = window;
+    benches[i].count = count / threads + (i < count % threads ? 1 : 0);
+    if (pthread_create(&benches[i].thread, NULL, RunBench, &benches[i]) != 0) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+  long received = 0, lost = 0;
+  int err = 0;
+  for (int i = 0; i < threads; i++) {
+    pthread_join(benches[i].thread, NULL);
+    received += benches[i].received;
+    lost += benches[i].lost;
+    err |= benches[i].err;
+  }
+  double elapsed = NowSec() - start;
+
+  printf("udp: %ld datagrams of %d bytes, %d threads, batch %d, window %d, in %.3f s: "
+         "%.0f datagrams/s, %ld lost\n",
+         received, bufsize, threads, batch, window, elapsed, (double)received / elapsed, lost);
+  free(benches);
+  return err;
+}
+
+/**
+ * Чтение файла или стандартного ввода целиком
+ */
+static char *ReadAll(int in, size_t *len) {
+  size_t cap = 1 << 16;
+  char *data = malloc(cap);
+  *len = 0;
+  ssize_t r;
+  while (data != NULL && (r = read(in, data + *len, cap - *len)) > 0) {
+    *len += (size_t)r;
+    if (*len == cap) {
+      char *grown = realloc(data, cap * 2);
+      if (grown == NULL)
+        free(data);
+      data = grown;
+      cap *= 2;
+    }
+  }
+  return data;
+}
+
+/**
+ * Надежная отправка файла или стандартного ввода по UDP пакетами по
+ * BUFSIZE байт; loss - доля датаграмм, выбрасываемых имитатором потерь
+ */
+static int SendReliable(int sockfd, const struct sockaddr_in *servaddr, int bufsize,
+                        const char *path, double loss) {
+  int in = 0;
+  if (path != NULL && (in = open(path, O_RDONLY)) < 0) {
+    perror(path);
+    return 1;
+  }
+  size_t len;
+  char *data = ReadAll(in, &len);
+  if (in != 0)
+    close(in);
+  struct RudpSocket rs;
+  if (data == NULL || RudpInit(&rs, sockfd, bufsize) != 0) {
+    printf("Can not prepare reliable transfer (BUFSIZE must be at most %d)\n", RUDP_MAX_PAYLOAD);
+    free(data);
+    return 1;
+  }
+  RudpSetLoss(&rs, loss, (uint64_t)getpid());
+
+  struct RudpStats stats;
+  int err = RudpSend(&rs, servaddr, data, len, &stats);
+  free(data);
+  if (err != 0) {
+    printf("Reliable transfer failed: no acknowledgements from server\n");
+    return 1;
+  }
+  printf("Sent %lld bytes reliably in %.3f s: %.1f MB/s, %u packets, %u retransmits, "
+         "%u timeouts, %u dropped by loss shim, srtt %.3f ms\n",
+         stats.bytes, stats.seconds, (double)stats.bytes / stats.seconds / 1e6, stats.packets,
+         stats.retransmits, stats.timeouts, stats.dropped, stats.srtt_ms);
+  return 0;
+}
+
 int main(int argc, char **argv) {
+  // Необязательные параметры: с --count клиент замеряет скорость эхо,
+  // с --reliable надежно передает файл или стандартный ввод
+  long count = 0;
+  int batch = 1;
+  int window = 64;
+  int threads = 1;
+  bool reliable = false;
+  const char *path = NULL;
+  double loss = 0;
+  while (1) {
+    static struct option options[] = {
+      {"count", required_argument, 0, 0},
+      {"batch", required_argument, 0, 0},
+      {"window", required_argument, 0, 0},
+      {"threads", required_argument, 0, 0},
+      {"reliable", no_argument, 0, 0},
+      {"file", required_argument, 0, 0},
+      {"loss", required_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c != 0) {
+      PrintUsage(argv[0]);
+      exit(1);
+    }
+    switch (option_index) {
+    case 0:
+      count = atol(optarg);
+      break;
+    case 1:
+      batch = atoi(optarg);
+      break;
+    case 2:
+      window = atoi(optarg);
+      break;
+    case 3:
+      threads = atoi(optarg);
+      break;
+    case 4:
+      reliable = true;
+      break;
+    case 5:
+      path = optarg;
+      break;
+    default:
+      loss = atof(optarg);
+      break;
+    }
+  }
+
   // Проверка аргументов командной строки
-  if (argc != 4) {
-    printf("Usage: %s <IP> <PORT> <BUFSIZE>\n", argv[0]);
+  if (argc - optind != 3) {
+    PrintUsage(argv[0]);
     exit(1);
   }
 
   // Парсинг аргументов
-  char *ip = argv[1];
-  int port = atoi(argv[2]);
-  int bufsize = atoi(argv[3]);
+  char *ip = argv[optind];
+  int port = atoi(argv[optind + 1]);
+  int bufsize = atoi(argv[optind + 2]);
 
   // Валидация аргументов
   if (port <= 0 || bufsize <= 0) {
     printf("Invalid port or buffer size\n");
     exit(1);
   }
+  if (count < 0 || batch <= 0 || batch > MAX_BATCH || window <= 0 || threads <= 0) {
+    printf("Count must be non-negative, batch from 1 to %d, window and threads positive\n",
+           MAX_BATCH);
+    exit(1);
+  }
+  if (loss < 0 || loss >= 1) {
+    printf("Loss must be from 0 to 1\n");
+    exit(1);
+  }
 
   int sockfd, n;
   char *sendline = malloc(bufsize);
@@ -53,6 +349,20 @@ int main(int argc, char **argv) {
     exit(1);
   }
 
+  if (count > 0) {
+    free(sendline);
+    free(recvline);
+    close(sockfd);
+    return Bench(&servaddr, bufsize, count, batch, window, threads);
+  }
+  if (reliable) {
+    free(sendline);
+    free(recvline);
+    int err = SendReliable(sockfd, &servaddr, bufsize, path, loss);
+    close(sockfd);
+    return err;
+  }
+
   printf("UDP Client ready. Server: %s:%d\n", ip, port);
   printf("Enter strings to send (Ctrl+D to exit):\n");
 
@@ -1,43 +1,418 @@
+#define _GNU_SOURCE  // recvmmsg, sendmmsg и pthread_setaffinity_np при -std=c99
+
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include "log.h"
+#include "rudp.h"
+#include "uring.h"
+
 #define SADDR struct sockaddr
 
-int main(int argc, char *argv[]) {
-  // Проверка аргументов командной строки
-  if (argc < 3) {
-    printf("Usage: %s <PORT> <BUFSIZE>\n", argv[0]);
-    exit(1);
+// Заявок в кольце io_uring и буферов приема (степень двойки)
+#define URING_ENTRIES 256
+#define URING_BUFFERS 256
+// Наибольшее число датаграмм за один recvmmsg/sendmmsg
+#define MAX_BATCH 1024
+
+// Вид заявки io_uring в старших битах user_data, номер буфера - в младших
+#define TAG_RECV 1ull
+#define TAG_SEND 2ull
+#define USER_DATA(tag, id) ((tag) << 32 | (uint32_t)(id))
+
+static void PrintUsage(const char *name) {
+  printf("Usage: %s <PORT> <BUFSIZE> [--backend auto|epoll|uring] [--batch N] "
+         "[--threads N] [--log-level info] [--log-sample N] [--log-sync]\n"
+         "       %s <PORT> <BUFSIZE> --reliable [--loss P] [--save FILE]\n", name, name);
+}
+
+/**
+ * Запись о датаграмме; адрес форматируется, только если запись будет выведена
+ * Длина задается явно: нуль-терминатор в буфере не нужен
+ */
+static void LogRequest(const char *mesg, int n, const struct sockaddr_in *cliaddr) {
+  char ipadr[INET_ADDRSTRLEN];
+  LOG(LOG_LEVEL_INFO, "REQUEST: '%.*s' FROM %s:%d",
+      n, mesg,
+      inet_ntop(AF_INET, &cliaddr->sin_addr, ipadr, sizeof(ipadr)),
+      ntohs(cliaddr->sin_port));
+}
+
+/**
+ * Обслуживание на epoll: по готовности сокета датаграммы читаются
+ * и возвращаются, пока они есть
+ */
+static int ServeEpoll(int sockfd, int bufsize) {
+  char *mesg = malloc(bufsize);
+  int epfd = epoll_create1(0);
+  int flags = fcntl(sockfd, F_GETFL, 0);
+  if (mesg == NULL || epfd < 0 || flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    perror("epoll");
+    free(mesg);
+    return 1;
   }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = sockfd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev);
 
-  // Парсинг аргументов
-  int port = atoi(argv[1]);
-  int bufsize = atoi(argv[2]);
+  // Основной цикл обработки запросов
+  while (1) {
+    if (epoll_wait(epfd, &ev, 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      break;
+    }
 
-  // Валидация аргументов
-  if (port <= 0 || bufsize <= 0) {
-    printf("Invalid port or buffer size\n");
-    exit(1);
+    while (1) {
+      struct sockaddr_in cliaddr;
+      socklen_t len = sizeof(cliaddr);
+
+      // Получение сообщения от клиента
+      int n = recvfrom(sockfd, mesg, bufsize, 0, (SADDR *)&cliaddr, &len);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+          perror("recvfrom");
+        break;
+      }
+      LogRequest(mesg, n, &cliaddr);
+
+      // Отправка эхо-ответа; при переполненном буфере сокета датаграмма теряется
+      if (sendto(sockfd, mesg, n, 0, (SADDR *)&cliaddr, len) < 0 && errno != EAGAIN)
+        perror("sendto");
+    }
   }
 
-  int sockfd, n;
-  char *mesg = malloc(bufsize);
-  char ipadr[INET_ADDRSTRLEN];
+  free(mesg);
+  close(epfd);
+  return 1;
+}
+
+/**
+ * Пакетное обслуживание на epoll: recvmmsg забирает до batch датаграмм
+ * в заранее выделенные буферы, ответы на все уходят одним sendmmsg
+ */
+static int ServeBatch(int sockfd, int bufsize, int batch) {
+  char *bufs = malloc((size_t)batch * bufsize);
+  struct mmsghdr *recv_msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct mmsghdr *send_msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct iovec *recv_iovs = calloc(batch, sizeof(struct iovec));
+  struct iovec *send_iovs = calloc(batch, sizeof(struct iovec));
+  struct sockaddr_in *addrs = calloc(batch, sizeof(struct sockaddr_in));
+  int epfd = epoll_create1(0);
+  int flags = fcntl(sockfd, F_GETFL, 0);
+  bool ready = bufs != NULL && recv_msgs != NULL && send_msgs != NULL && recv_iovs != NULL &&
+               send_iovs != NULL && addrs != NULL && epfd >= 0 && flags >= 0 &&
+               fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) == 0;
+  if (!ready)
+    perror("batch");
+  for (int i = 0; ready && i < batch; i++) {
+    recv_iovs[i].iov_base = bufs + (size_t)i * bufsize;
+    recv_msgs[i].msg_hdr.msg_iov = &recv_iovs[i];
+    recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    recv_msgs[i].msg_hdr.msg_name = &addrs[i];
+    send_iovs[i].iov_base = recv_iovs[i].iov_base;
+    send_msgs[i].msg_hdr.msg_iov = &send_iovs[i];
+    send_msgs[i].msg_hdr.msg_iovlen = 1;
+    send_msgs[i].msg_hdr.msg_name = &addrs[i];
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = sockfd;
+  if (ready)
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev);
+
+  // Основной цикл обработки запросов
+  while (ready) {
+    if (epoll_wait(epfd, &ev, 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      break;
+    }
+
+    while (1) {
+      // Ядро перезаписывает длины: перед каждым приемом они восстанавливаются
+      for (int i = 0; i < batch; i++) {
+        recv_iovs[i].iov_len = bufsize;
+        recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      }
+
+      // Получение пачки сообщений
+      int n = recvmmsg(sockfd, recv_msgs, batch, MSG_DONTWAIT, NULL);
+      if (n <= 0) {
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+          perror("recvmmsg");
+        break;
+      }
+      for (int i = 0; i < n; i++) {
+        send_iovs[i].iov_len = recv_msgs[i].msg_len;
+        send_msgs[i].msg_hdr.msg_namelen = recv_msgs[i].msg_hdr.msg_namelen;
+        LogRequest(send_iovs[i].iov_base, (int)recv_msgs[i].msg_len, &addrs[i]);
+      }
+
+      // Отправка эхо-ответов; sendmmsg может отправить не все сразу,
+      // при переполненном буфере сокета остаток теряется
+      int sent = 0;
+      while (sent < n) {
+        int m = sendmmsg(sockfd, send_msgs + sent, n - sent, 0);
+        if (m < 0) {
+          if (errno == EINTR)
+            continue;
+          if (errno != EAGAIN)
+            perror("sendmmsg");
+          break;
+        }
+        sent += m;
+      }
+
+      // Неполная пачка: очередь сокета пуста
+      if (n < batch)
+        break;
+    }
+  }
+
+  if (epfd >= 0)
+    close(epfd);
+  free(bufs);
+  free(recv_msgs);
+  free(send_msgs);
+  free(recv_iovs);
+  free(send_iovs);
+  free(addrs);
+  return 1;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Ответ на датаграмму из буфера приема: живет до завершения sendmsg,
+ * после чего буфер возвращается в кольцо
+ */
+struct EchoSlot {
+  struct msghdr msg;
+  struct iovec iov;
+};
+
+/**
+ * Обслуживание на io_uring: многоразовый recvmsg кладет датаграммы с адресом
+ * отправителя в буферы кольца, эхо уходит sendmsg прямо из того же буфера.
+ * Заявки каждой итерации отправляются одной пачкой
+ *
+ * @return -1, если кольцо буферов недоступно (нужен epoll), иначе 1 при ошибке
+ */
+static int ServeUring(struct Uring *ring, int sockfd, int bufsize) {
+  // Буфер: заголовок recvmsg, адрес отправителя, данные
+  struct msghdr recv_msg;
+  memset(&recv_msg, 0, sizeof(recv_msg));
+  recv_msg.msg_namelen = sizeof(struct sockaddr_in);
+  size_t header = sizeof(struct io_uring_recvmsg_out) + recv_msg.msg_namelen;
+
+  struct UringBufRing br;
+  struct EchoSlot *slots = calloc(URING_BUFFERS, sizeof(struct EchoSlot));
+  if (slots == NULL ||
+      UringBufRingInit(ring, &br, 0, URING_BUFFERS, (unsigned)(header + bufsize)) < 0) {
+    free(slots);
+    return -1;
+  }
+  unsigned busy = 0;           // Буферы, ждущие завершения эха
+  bool recv_armed = true;
+  UringRecvmsgMultishot(ring, sockfd, &recv_msg, &br, USER_DATA(TAG_RECV, 0));
+
+  // Основной цикл обработки запросов
+  while (1) {
+    if (UringSubmitAndWait(ring, 1) < 0) {
+      perror("io_uring_enter");
+      break;
+    }
+
+    unsigned recycled = 0;
+    struct io_uring_cqe *cqe;
+    while ((cqe = UringPeekCqe(ring)) != NULL) {
+      uint64_t tag = cqe->user_data >> 32;
+      int res = cqe->res;
+      unsigned flags = cqe->flags;
+      uint16_t bid = tag == TAG_SEND ? (uint16_t)cqe->user_data : URING_CQE_BID(cqe);
+      UringCqeSeen(ring);
+
+      if (tag == TAG_SEND) {
+        if (res < 0)
+          LOG(LOG_LEVEL_WARN, "sendmsg: %s", strerror(-res));
+        UringBufRecycle(&br, bid);
+        busy--;
+        recycled++;
+        continue;
+      }
+
+      if (!(flags & IORING_CQE_F_MORE))
+        recv_armed = false;
+      if (res < 0) {
+        // ENOBUFS: все буферы заняты эхом, прием возобновится после отправки
+        if (res != -ENOBUFS)
+          LOG(LOG_LEVEL_WARN, "recvmsg: %s", strerror(-res));
+        continue;
+      }
+      if (!(flags & IORING_CQE_F_BUFFER))
+        continue;
+
+      char *buf = UringBuf(&br, bid);
+      struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)buf;
+      struct EchoSlot *slot = &slots[bid];
+      int n = (size_t)res > header ? (int)((size_t)res - header) : 0;
+      slot->iov.iov_base = buf + header;
+      slot->iov.iov_len = (size_t)n;
+      slot->msg.msg_name = buf + sizeof(struct io_uring_recvmsg_out);
+      slot->msg.msg_namelen = out->namelen < recv_msg.msg_namelen ? out->namelen
+                                                                   : recv_msg.msg_namelen;
+      slot->msg.msg_iov = &slot->iov;
+      slot->msg.msg_iovlen = 1;
+      LogRequest(slot->iov.iov_base, n, (const struct sockaddr_in *)slot->msg.msg_name);
+
+      // Отправка эхо-ответа из того же буфера
+      busy++;
+      if (UringSendmsg(ring, sockfd, &slot->msg, USER_DATA(TAG_SEND, bid)) < 0) {
+        UringBufRecycle(&br, bid);
+        busy--;
+        recycled++;
+      }
+    }
+
+    if (recycled > 0)
+      UringBufPublish(&br);
+    if (!recv_armed && busy < URING_BUFFERS) {
+      UringRecvmsgMultishot(ring, sockfd, &recv_msg, &br, USER_DATA(TAG_RECV, 0));
+      recv_armed = true;
+    }
+  }
+
+  UringBufRingDestroy(ring, &br);
+  free(slots);
+  return 1;
+}
+
+#endif
+
+/**
+ * Файл для данных надежной передачи; открывается с первыми данными,
+ * чтобы ожидание следующей передачи не стирало предыдущую
+ */
+struct ReliableOutput {
+  const char *path;          // NULL - данные только подсчитываются
+  int fd;
+};
+
+static int DeliverReliable(void *ctx, const char *data, size_t len) {
+  struct ReliableOutput *out = ctx;
+  if (out->path == NULL)
+    return 0;
+  if (out->fd < 0 && (out->fd = open(out->path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    perror(out->path);
+    return -1;
+  }
+  for (size_t off = 0; off < len;) {
+    ssize_t w = write(out->fd, data + off, len - off);
+    if (w < 0) {
+      perror("write");
+      return -1;
+    }
+    off += (size_t)w;
+  }
+  return 0;
+}
+
+/**
+ * Надежный прием: передачи принимаются одна за другой, каждая
+ * записывается в save_path поверх предыдущей
+ */
+static int ServeReliable(int sockfd, int bufsize, double loss, const char *save_path) {
+  struct RudpSocket rs;
+  if (RudpInit(&rs, sockfd, bufsize) != 0) {
+    printf("BUFSIZE must be at most %d for reliable mode\n", RUDP_MAX_PAYLOAD);
+    return 1;
+  }
+  RudpSetLoss(&rs, loss, (uint64_t)getpid() * 7919);
+
+  // Основной цикл обработки передач
+  while (1) {
+    struct ReliableOutput out = {save_path, -1};
+    struct sockaddr_in cliaddr;
+    memset(&cliaddr, 0, sizeof(cliaddr));
+    struct RudpStats stats;
+    int err = RudpRecv(&rs, DeliverReliable, &out, &cliaddr, &stats);
+    if (out.fd >= 0)
+      close(out.fd);
+
+    // До первого пакета адрес отправителя неизвестен
+    if (err != 0 && stats.packets == 0) {
+      LOG(LOG_LEVEL_WARN, "Reliable receive failed before the first packet");
+      continue;
+    }
+    char ipadr[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &cliaddr.sin_addr, ipadr, sizeof(ipadr));
+    if (err != 0) {
+      LOG(LOG_LEVEL_WARN, "Reliable transfer from %s:%d failed after %lld bytes",
+          ipadr, ntohs(cliaddr.sin_port), stats.bytes);
+      continue;
+    }
+    LOG(LOG_LEVEL_INFO, "Received %lld bytes reliably from %s:%d in %.3f s: %.1f MB/s, "
+        "%u packets, %u duplicates, %u dropped by loss shim",
+        stats.bytes, ipadr, ntohs(cliaddr.sin_port), stats.seconds,
+        stats.seconds > 0 ? (double)stats.bytes / stats.seconds / 1e6 : 0.0,
+        stats.packets, stats.duplicates, stats.dropped);
+  }
+  return 1;
+}
+
+/**
+ * Поток сервера: свой сокет на общем порту (SO_REUSEPORT), ядро
+ * распределяет датаграммы между сокетами по адресу отправителя
+ */
+struct UdpWorker {
+  pthread_t thread;
+  int id;
+  int port;
+  int bufsize;
+  int batch;                 // 1 - по одной датаграмме за вызов
+  bool reuseport;
+  enum IoBackend backend;
+  bool reliable;
+  double loss;               // Имитатор потерь надежного режима
+  const char *save_path;
+  int err;
+};
+
+static int OpenSocket(int port, bool reuseport) {
+  int sockfd;
   struct sockaddr_in servaddr;
-  struct sockaddr_in cliaddr;
 
   // Создание UDP сокета
   if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
     perror("socket problem");
-    free(mesg);
-    exit(1);
+    return -1;
+  }
+
+  // Несколько сокетов на одном порту, по одному на поток
+  int opt_val = 1;
+  if (reuseport && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt_val, sizeof(opt_val)) < 0) {
+    perror("SO_REUSEPORT");
+    close(sockfd);
+    return -1;
   }
 
   // Настройка адреса сервера
@@ -49,40 +424,215 @@ int main(int argc, char *argv[]) {
   // Привязка сокета
   if (bind(sockfd, (SADDR *)&servaddr, sizeof(servaddr)) < 0) {
     perror("bind problem");
-    free(mesg);
     close(sockfd);
-    exit(1);
+    return -1;
   }
+  return sockfd;
+}
 
-  printf("UDP SERVER starts on port %d...\n", port);
+static void *ServeWorker(void *arg) {
+  struct UdpWorker *worker = arg;
+  int sockfd = OpenSocket(worker->port, worker->reuseport);
+  if (sockfd < 0) {
+    worker->err = 1;
+    return NULL;
+  }
 
-  // Основной цикл обработки запросов
-  while (1) {
-    socklen_t len = sizeof(cliaddr);
+  if (worker->reliable) {
+    printf("UDP SERVER starts on port %d (reliable)...\n", worker->port);
+    fflush(stdout);
+    worker->err = ServeReliable(sockfd, worker->bufsize, worker->loss, worker->save_path);
+    close(sockfd);
+    return NULL;
+  }
 
-    // Получение сообщения от клиента
-    if ((n = recvfrom(sockfd, mesg, bufsize, 0, (SADDR *)&cliaddr, &len)) < 0) {
-      perror("recvfrom");
-      continue; // Продолжаем работать при ошибке
+  // Пакетный режим работает на epoll; иначе io_uring, если он собран
+  // и разрешен ядром, иначе epoll
+  int err = -1;
+  const char *mode = "epoll";
+#ifdef HAVE_IO_URING
+  if (worker->batch == 1 && worker->backend != IO_BACKEND_EPOLL) {
+    struct Uring ring;
+    if (UringInit(&ring, URING_ENTRIES) == 0) {
+      if (worker->id == 0) {
+        printf("UDP SERVER starts on port %d (io_uring)...\n", worker->port);
+        fflush(stdout);
+      }
+      err = ServeUring(&ring, sockfd, worker->bufsize);
+      UringDestroy(&ring);
+    }
+  }
+#endif
+  if (err == -1 && worker->backend == IO_BACKEND_URING) {
+    printf("io_uring is not available\n");
+    close(sockfd);
+    worker->err = 1;
+    return NULL;
+  }
+  if (err == -1) {
+    if (worker->batch > 1)
+      mode = "epoll, recvmmsg";
+    if (worker->id == 0) {
+      printf("UDP SERVER starts on port %d (%s)...\n", worker->port, mode);
+      fflush(stdout);
     }
-    
-    mesg[n] = 0; // Добавление нуль-терминатора
+    err = worker->batch > 1 ? ServeBatch(sockfd, worker->bufsize, worker->batch)
+                            : ServeEpoll(sockfd, worker->bufsize);
+  }
 
-    // Вывод информации о запросе
-    printf("REQUEST: '%s' FROM %s:%d\n", 
-           mesg,
-           inet_ntop(AF_INET, &cliaddr.sin_addr, ipadr, sizeof(ipadr)),
-           ntohs(cliaddr.sin_port));
+  close(sockfd);
+  worker->err = err;
+  return NULL;
+}
 
-    // Отправка эхо-ответа
-    if (sendto(sockfd, mesg, n, 0, (SADDR *)&cliaddr, len) < 0) {
-      perror("sendto");
-      continue; // Продолжаем работать при ошибке
+int main(int argc, char *argv[]) {
+  // Необязательные параметры после PORT и BUFSIZE
+  enum IoBackend backend = IO_BACKEND_AUTO;
+  enum LogLevel log_level = LOG_LEVEL_INFO;
+  unsigned int log_sample = 1;
+  bool log_sync = false;
+  int batch = 1;
+  int threads = 1;
+  bool reliable = false;
+  double loss = 0;
+  const char *save_path = NULL;
+  while (1) {
+    static struct option options[] = {
+      {"log-level", required_argument, 0, 0},
+      {"log-sample", required_argument, 0, 0},
+      {"log-sync", no_argument, 0, 0},
+      {"backend", required_argument, 0, 0},
+      {"batch", required_argument, 0, 0},
+      {"threads", required_argument, 0, 0},
+      {"reliable", no_argument, 0, 0},
+      {"loss", required_argument, 0, 0},
+      {"save", required_argument, 0, 0},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", options, &option_index);
+    if (c == -1)
+      break;
+    if (c != 0) {
+      PrintUsage(argv[0]);
+      exit(1);
+    }
+    if (option_index == 0 && !LogParseLevel(optarg, &log_level)) {
+      printf("Log level must be debug, info, warn, error or off\n");
+      exit(1);
+    }
+    if (option_index == 1) {
+      if (atoi(optarg) <= 0) {
+        printf("Log sample must be positive number\n");
+        exit(1);
+      }
+      log_sample = (unsigned int)atoi(optarg);
+    }
+    if (option_index == 2)
+      log_sync = true;
+    if (option_index == 3 && !IoBackendParse(optarg, &backend)) {
+      printf("Backend must be auto, epoll or uring\n");
+      exit(1);
+    }
+    if (option_index == 4) {
+      batch = atoi(optarg);
+      if (batch <= 0 || batch > MAX_BATCH) {
+        printf("Batch must be a number from 1 to %d\n", MAX_BATCH);
+        exit(1);
+      }
     }
+    if (option_index == 5) {
+      threads = atoi(optarg);
+      if (threads <= 0) {
+        printf("Threads must be positive number\n");
+        exit(1);
+      }
+    }
+    if (option_index == 6)
+      reliable = true;
+    if (option_index == 7) {
+      loss = atof(optarg);
+      if (loss < 0 || loss >= 1) {
+        printf("Loss must be from 0 to 1\n");
+        exit(1);
+      }
+    }
+    if (option_index == 8)
+      save_path = optarg;
   }
 
-  // Очистка ресурсов (никогда не выполнится из-за бесконечного цикла)
-  free(mesg);
-  close(sockfd);
-  return 0;
-}
\ No newline at end of file
+  // Проверка аргументов командной строки
+  if (argc - optind < 2) {
+    PrintUsage(argv[0]);
+    exit(1);
+  }
+
+  // Парсинг аргументов
+  int port = atoi(argv[optind]);
+  int bufsize = atoi(argv[optind + 1]);
+
+  // Валидация аргументов
+  if (port <= 0 || bufsize <= 0) {
+    printf("Invalid port or buffer size\n");
+    exit(1);
+  }
+  if (batch > 1 && backend == IO_BACKEND_URING) {
+    printf("Batch mode works with epoll backend only\n");
+    exit(1);
+  }
+  if (reliable && (batch > 1 || threads > 1 || backend == IO_BACKEND_URING)) {
+    printf("Reliable mode works in one thread without --batch and io_uring\n");
+    exit(1);
+  }
+
+  // Сообщения о запросах форматирует и выводит фоновый поток журнала
+  if (LogInit(log_level, log_sample, log_sync) != 0) {
+    printf("Can not start log writer\n");
+    exit(1);
+  }
+
+  // Потоки с сокетами на общем порту, i-й закреплен за ядром i по кругу
+  struct UdpWorker *workers = calloc(threads, sizeof(struct UdpWorker));
+  if (workers == NULL) {
+    printf("Can not allocate workers\n");
+    exit(1);
+  }
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 0; i < threads; i++) {
+    workers[i].id = i;
+    workers[i].port = port;
+    workers[i].bufsize = bufsize;
+    workers[i].batch = batch;
+    workers[i].reuseport = threads > 1;
+    workers[i].backend = backend;
+    workers[i].reliable = reliable;
+    workers[i].loss = loss;
+    workers[i].save_path = save_path;
+    if (threads == 1) {
+      ServeWorker(&workers[i]);
+      break;
+    }
+    if (pthread_create(&workers[i].thread, NULL, ServeWorker, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(1);
+    }
+    if (ncpu > 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i % ncpu, &cpus);
+      pthread_setaffinity_np(workers[i].thread, sizeof(cpus), &cpus);
+    }
+  }
+  int err = 0;
+  for (int i = 0; i < threads; i++) {
+    if (threads > 1)
+      pthread_join(workers[i].thread, NULL);
+    if (workers[i].err != 0)
+      err = workers[i].err;
+  }
+
+  // Очистка ресурсов (выполняется только при ошибке цикла)
+  free(workers);
+  LogShutdown();
+  return err;
+}
@@ -0,0 +1,350 @@
+/**
+ * uring.c - Кольца io_uring на системных вызовах: настройка, пачки заявок,
+ * кольцо буферов приема
+ */
+
+#define _DEFAULT_SOURCE  // syscall и MAP_POPULATE при -std=c99
+
+#include "uring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+bool IoBackendParse(const char *name, enum IoBackend *backend) {
+  if (strcmp(name, "auto") == 0)
+    *backend = IO_BACKEND_AUTO;
+  else if (strcmp(name, "epoll") == 0)
+    *backend = IO_BACKEND_EPOLL;
+  else if (strcmp(name, "uring") == 0)
+    *backend = IO_BACKEND_URING;
+  else
+    return false;
+  return true;
+}
+
+#ifdef HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int SysSetup(unsigned entries, struct io_uring_params *params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int SysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int SysRegister(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * Создание кольца на entries заявок
+ * Очередь результатов вчетверо длиннее: многоразовые заявки дают
+ * по нескольку результатов на одну заявку
+ *
+ * @return 0 при успехе, -1 если io_uring недоступен
+ */
+int UringInit(struct Uring *ring, unsigned entries) {
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = entries * 4;
+#ifdef IORING_SETUP_COOP_TASKRUN
+  // Заявки подает один поток: ядру не нужно прерывать его ради завершений
+  params.flags |= IORING_SETUP_COOP_TASKRUN;
+#endif
+#ifdef IORING_SETUP_SINGLE_ISSUER
+  params.flags |= IORING_SETUP_SINGLE_ISSUER;
+#endif
+  int fd = SysSetup(entries, &params);
+  if (fd < 0 && errno == EINVAL) {
+    // Старое ядро не знает новых флагов
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    fd = SysSetup(entries, &params);
+  }
+  if (fd < 0)
+    return -1;
+  ring->fd = fd;
+
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap && ring->cq_ring_size > ring->sq_ring_size)
+    ring->sq_ring_size = ring->cq_ring_size;
+
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED) {
+    ring->sq_ring = NULL;
+    UringDestroy(ring);
+    return -1;
+  }
+  if (single_mmap) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED) {
+      ring->cq_ring = NULL;
+      UringDestroy(ring);
+      return -1;
+    }
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    UringDestroy(ring);
+    return -1;
+  }
+
+  char *sq = ring->sq_ring;
+  char *cq = ring->cq_ring;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_entries = *(unsigned *)(sq + params.sq_off.ring_entries);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->sq_local_tail = *ring->sq_tail;
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+  // Заявки берутся по порядку, поэтому индексы массива постоянны
+  for (unsigned i = 0; i < ring->sq_entries; i++)
+    ring->sq_array[i] = i;
+  return 0;
+}
+
+void UringDestroy(struct Uring *ring) {
+  if (ring->sqes != NULL)
+    munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring)
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  if (ring->sq_ring != NULL)
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  if (ring->fd >= 0)
+    close(ring->fd);
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+/**
+ * Публикация накопленных заявок и ожидание wait_nr результатов
+ * одним вызовом io_uring_enter
+ *
+ * @return количество принятых ядром заявок или -1 при ошибке
+ */
+int UringSubmitAndWait(struct Uring *ring, unsigned wait_nr) {
+  unsigned to_submit = ring->sq_local_tail - *ring->sq_tail;
+  __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+  if (to_submit == 0 && wait_nr == 0)
+    return 0;
+
+  unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    int ret = SysEnter(ring->fd, to_submit, wait_nr, flags);
+    if (ret >= 0)
+      return ret;
+    if (errno == EINTR)
+      continue;
+    // Очередь результатов переполнена: их нужно разобрать перед новыми заявками
+    if (errno == EBUSY || errno == EAGAIN)
+      return 0;
+    return -1;
+  }
+}
+
+/**
+ * Свободная заявка; если очередь полна, накопленное отправляется без ожидания
+ */
+static struct io_uring_sqe *GetSqe(struct Uring *ring) {
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  if (ring->sq_local_tail - head >= ring->sq_entries) {
+    if (UringSubmitAndWait(ring, 0) < 0)
+      return NULL;
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries)
+      return NULL;
+  }
+  struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+  ring->sq_local_tail++;
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+/**
+ * Следующий готовый результат или NULL; после обработки - UringCqeSeen
+ */
+struct io_uring_cqe *UringPeekCqe(struct Uring *ring) {
+  unsigned head = *ring->cq_head;
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    return NULL;
+  return &ring->cqes[head & ring->cq_mask];
+}
+
+void UringCqeSeen(struct Uring *ring) {
+  __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Регистрация кольца буферов приема в группе bgid
+ *
+ * @return 0 при успехе, -1 при ошибке (ядро без provided buffer ring)
+ */
+int UringBufRingInit(struct Uring *ring, struct UringBufRing *br, uint16_t bgid,
+                     unsigned entries, unsigned buf_size) {
+  memset(br, 0, sizeof(*br));
+  // Кольцо должно начинаться с границы страницы
+  size_t ring_size = entries * sizeof(struct io_uring_buf);
+  void *mem = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return -1;
+  br->base = malloc((size_t)entries * buf_size);
+  if (br->base == NULL) {
+    munmap(mem, ring_size);
+    return -1;
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)mem;
+  reg.ring_entries = entries;
+  reg.bgid = bgid;
+  if (SysRegister(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    free(br->base);
+    munmap(mem, ring_size);
+    br->base = NULL;
+    return -1;
+  }
+
+  br->ring = mem;
+  br->entries = entries;
+  br->buf_size = buf_size;
+  br->bgid = bgid;
+  for (unsigned i = 0; i < entries; i++)
+    UringBufRecycle(br, (uint16_t)i);
+  UringBufPublish(br);
+  return 0;
+}
+
+void UringBufRingDestroy(struct Uring *ring, struct UringBufRing *br) {
+  if (br->ring == NULL)
+    return;
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.bgid = br->bgid;
+  SysRegister(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+  munmap(br->ring, br->entries * sizeof(struct io_uring_buf));
+  free(br->base);
+  memset(br, 0, sizeof(*br));
+}
+
+char *UringBuf(const struct UringBufRing *br, uint16_t bid) {
+  return br->base + (size_t)bid * br->buf_size;
+}
+
+/**
+ * Возврат буфера в кольцо; ядро увидит его после UringBufPublish
+ */
+void UringBufRecycle(struct UringBufRing *br, uint16_t bid) {
+  struct io_uring_buf *buf = &br->ring->bufs[br->tail & (br->entries - 1)];
+  buf->addr = (uint64_t)(uintptr_t)UringBuf(br, bid);
+  buf->len = br->buf_size;
+  buf->bid = bid;
+  br->tail++;
+}
+
+void UringBufPublish(struct UringBufRing *br) {
+  __atomic_store_n(&br->ring->tail, br->tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * Многоразовый accept: один результат на каждое новое соединение,
+ * пока в CQE стоит IORING_CQE_F_MORE
+ */
+int UringAcceptMultishot(struct Uring *ring, int fd, uint64_t user_data) {
+  struct io_uring_sqe *sqe = GetSqe(ring);
+  if (sqe == NULL)
+    return -1;
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->user_data = user_data;
+  return 0;
+}
+
+/**
+ * Многоразовый recv в буферы кольца br
+ */
+int UringRecvMultishot(struct Uring *ring, int fd, const struct UringBufRing *br,
+                       uint64_t user_data) {
+  struct io_uring_sqe *sqe = GetSqe(ring);
+  if (sqe == NULL)
+    return -1;
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = br->bgid;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = user_data;
+  return 0;
+}
+
+/**
+ * Многоразовый recvmsg: буфер начинается с io_uring_recvmsg_out,
+ * за ним адрес отправителя (msg->msg_namelen байт) и данные
+ */
+int UringRecvmsgMultishot(struct Uring *ring, int fd, struct msghdr *msg,
+                          const struct UringBufRing *br, uint64_t user_data) {
+  struct io_uring_sqe *sqe = GetSqe(ring);
+  if (sqe == NULL)
+    return -1;
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)msg;
+  sqe->len = 1;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = br->bgid;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = user_data;
+  return 0;
+}
+
+/**
+ * sendmsg; msg и его буферы должны жить до результата заявки
+ */
+int UringSendmsg(struct Uring *ring, int fd, const struct msghdr *msg, uint64_t user_data) {
+  struct io_uring_sqe *sqe = GetSqe(ring);
+  if (sqe == NULL)
+    return -1;
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)msg;
+  sqe->len = 1;
+  sqe->user_data = user_data;
+  return 0;
+}
+
+int UringClose(struct Uring *ring, int fd, uint64_t user_data) {
+  struct io_uring_sqe *sqe = GetSqe(ring);
+  if (sqe == NULL)
+    return -1;
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = fd;
+  sqe->user_data = user_data;
+  return 0;
+}
+
+#endif
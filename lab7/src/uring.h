@@ -0,0 +1,108 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/socket.h>
+
+/**
+ * Тонкая обертка над io_uring на системных вызовах (без liburing)
+ *
+ * Поддержка определяется при компиляции: нужен заголовок linux/io_uring.h
+ * с многоразовыми (multishot) accept и recv. Без него HAVE_IO_URING
+ * не определяется и серверы собираются только с epoll. Ядро тоже может
+ * не поддерживать io_uring (или запрещать его): тогда UringInit
+ * возвращает -1 и серверы переходят на epoll во время работы.
+ *
+ * Заявки (SQE) копятся в очереди и уходят в ядро одной пачкой в
+ * UringSubmitAndWait; готовые результаты (CQE) читаются из общей памяти
+ * без системных вызовов. Данные сокетов ядро кладет в буферы из
+ * зарегистрированного кольца (provided buffer ring), номер буфера приходит
+ * в CQE, после обработки буфер возвращается в кольцо.
+ */
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_ACCEPT_MULTISHOT) && defined(IORING_RECV_MULTISHOT)
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+/**
+ * Слой ввода-вывода сервера: auto - io_uring, если он есть, иначе epoll
+ */
+enum IoBackend {
+  IO_BACKEND_AUTO,
+  IO_BACKEND_EPOLL,
+  IO_BACKEND_URING
+};
+
+bool IoBackendParse(const char *name, enum IoBackend *backend);
+
+#ifdef HAVE_IO_URING
+
+struct Uring {
+  int fd;
+  // Очередь заявок
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_array;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned sq_local_tail;    // Заполненные, но еще не опубликованные заявки
+  struct io_uring_sqe *sqes;
+  // Очередь результатов
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  // Отображения общей памяти
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+};
+
+/**
+ * Кольцо буферов для приема: entries буферов по buf_size байт
+ */
+struct UringBufRing {
+  struct io_uring_buf_ring *ring;
+  char *base;                // Память буферов
+  unsigned entries;          // Степень двойки
+  unsigned buf_size;
+  uint16_t bgid;             // Номер группы буферов в заявках
+  uint16_t tail;             // Локальный хвост до публикации
+};
+
+// Номер буфера из флагов CQE
+#define URING_CQE_BID(cqe) ((uint16_t)((cqe)->flags >> IORING_CQE_BUFFER_SHIFT))
+
+int UringInit(struct Uring *ring, unsigned entries);
+void UringDestroy(struct Uring *ring);
+int UringSubmitAndWait(struct Uring *ring, unsigned wait_nr);
+struct io_uring_cqe *UringPeekCqe(struct Uring *ring);
+void UringCqeSeen(struct Uring *ring);
+
+int UringBufRingInit(struct Uring *ring, struct UringBufRing *br, uint16_t bgid,
+                     unsigned entries, unsigned buf_size);
+void UringBufRingDestroy(struct Uring *ring, struct UringBufRing *br);
+char *UringBuf(const struct UringBufRing *br, uint16_t bid);
+void UringBufRecycle(struct UringBufRing *br, uint16_t bid);
+void UringBufPublish(struct UringBufRing *br);
+
+int UringAcceptMultishot(struct Uring *ring, int fd, uint64_t user_data);
+int UringRecvMultishot(struct Uring *ring, int fd, const struct UringBufRing *br,
+                       uint64_t user_data);
+int UringRecvmsgMultishot(struct Uring *ring, int fd, struct msghdr *msg,
+                          const struct UringBufRing *br, uint64_t user_data);
+int UringSendmsg(struct Uring *ring, int fd, const struct msghdr *msg, uint64_t user_data);
+int UringClose(struct Uring *ring, int fd, uint64_t user_data);
+
+#endif
+
+#endif
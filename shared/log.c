@@ -0,0 +1,515 @@
+/**
+ * log.c - Асинхронный журнал: кольцевые буферы потоков и фоновый писатель
+ */
+
+#define _POSIX_C_SOURCE 200809L  // localtime_r, strnlen, posix_memalign при -std=c99
+
+#include "log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+// Длина строки журнала вместе с префиксом
+#define LOG_LINE_MAX 1024
+// Пауза фонового потока, когда все буферы пусты
+#define LOG_IDLE_NS 1000000
+
+enum LogLevel log_min_level = LOG_LEVEL_INFO;
+
+static const char *level_names[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+
+/**
+ * Запись журнала в двоичном виде; форматируется фоновым потоком
+ */
+struct LogRecord {
+  const char *fmt;             // Строка формата (литерал)
+  uint64_t time_ns;            // CLOCK_REALTIME в момент записи
+  uint64_t args[LOG_MAX_ARGS]; // Аргументы; для %s - смещение строки в text
+  uint8_t level;
+  uint8_t argc;                // Сохраненных аргументов
+  char text[LOG_TEXT_MAX];     // Копии строк %s, каждая с нулем на конце
+};
+
+/**
+ * Кольцевой буфер одного потока: head двигает только владелец,
+ * tail - только фоновый поток; индексы растут без заворачивания
+ */
+struct LogRing {
+  size_t head __attribute__((aligned(64)));
+  uint64_t dropped;            // Отброшено из-за полного буфера
+  bool active;                 // Владелец пишет запись; ждет LogShutdown
+  size_t tail __attribute__((aligned(64)));
+  uint64_t dropped_reported;   // Сколько отброшенных уже попало в вывод
+  int thread;                  // Номер потока в префиксе строки
+  struct LogRing *next;        // Список всех буферов
+  struct LogRecord records[LOG_RING_SIZE];
+};
+
+static struct LogRing *rings = NULL;
+static int threads_num = 0;
+static unsigned int log_sample = 1;
+static bool log_async = false;
+static bool writer_stop = false;
+static pthread_t writer;
+
+static __thread struct LogRing *local_ring = NULL;
+static __thread int local_thread = -1;
+static __thread unsigned int sample_counter = 0;
+
+// Класс аргумента спецификации формата
+enum ArgKind {
+  ARG_INT,
+  ARG_LONG,
+  ARG_DOUBLE,
+  ARG_STRING,
+  ARG_POINTER,
+  ARG_PERCENT,  // %% - аргумента нет
+  ARG_BAD       // Неподдерживаемая спецификация
+};
+
+struct FormatSpec {
+  char text[24];        // Спецификация с '%' для snprintf
+  int stars;            // Количество '*' (ширина и точность берутся из аргументов)
+  bool star_precision;  // Точность задана '*'
+  int precision;        // Явная точность, -1 - не задана
+  enum ArgKind kind;
+};
+
+/**
+ * Разбор спецификации преобразования; p указывает на '%'
+ *
+ * @return указатель на символ после спецификации
+ */
+static const char *ParseSpec(const char *p, struct FormatSpec *spec) {
+  const char *start = p++;
+  spec->stars = 0;
+  spec->star_precision = false;
+  spec->precision = -1;
+  spec->kind = ARG_BAD;
+  if (*p == '%') {
+    spec->kind = ARG_PERCENT;
+    return p + 1;
+  }
+
+  while (*p != '\0' && strchr("-+ #0", *p) != NULL)
+    p++;
+  if (*p == '*') {
+    spec->stars++;
+    p++;
+  } else {
+    while (*p >= '0' && *p <= '9')
+      p++;
+  }
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      spec->stars++;
+      spec->star_precision = true;
+      p++;
+    } else {
+      spec->precision = 0;
+      while (*p >= '0' && *p <= '9')
+        spec->precision = spec->precision * 10 + (*p++ - '0');
+    }
+  }
+
+  bool wide = false;  // l, ll, j, z, t: 64-битный аргумент
+  bool bad = false;   // L: long double
+  while (*p != '\0' && strchr("hlLjzt", *p) != NULL) {
+    if (*p == 'L')
+      bad = true;
+    else if (*p != 'h')
+      wide = true;
+    p++;
+  }
+
+  enum ArgKind kind = ARG_BAD;
+  switch (*p) {
+  case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+    kind = wide ? ARG_LONG : ARG_INT;
+    break;
+  case 'c':
+    kind = wide ? ARG_BAD : ARG_INT;
+    break;
+  case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+    kind = ARG_DOUBLE;
+    break;
+  case 's':
+    kind = wide ? ARG_BAD : ARG_STRING;
+    break;
+  case 'p':
+    kind = ARG_POINTER;
+    break;
+  default:
+    break;
+  }
+  if (*p != '\0')
+    p++;
+
+  size_t len = (size_t)(p - start);
+  if (bad || len >= sizeof(spec->text))
+    return p;
+  memcpy(spec->text, start, len);
+  spec->text[len] = '\0';
+  spec->kind = kind;
+  return p;
+}
+
+/**
+ * Сохранение аргументов в запись по строке формата
+ * На неподдерживаемой спецификации или при нехватке места разбор
+ * останавливается: остаток формата фоновый поток выведет как есть
+ */
+static void CaptureArgs(struct LogRecord *rec, const char *fmt, va_list ap) {
+  size_t text_len = 0;
+  int argc = 0;
+  const char *p = fmt;
+  while (*p != '\0') {
+    if (*p != '%') {
+      p++;
+      continue;
+    }
+    struct FormatSpec spec;
+    p = ParseSpec(p, &spec);
+    if (spec.kind == ARG_PERCENT)
+      continue;
+    if (spec.kind == ARG_BAD || argc + spec.stars + 1 > LOG_MAX_ARGS)
+      break;
+
+    int star = 0;
+    for (int s = 0; s < spec.stars; s++) {
+      star = va_arg(ap, int);
+      rec->args[argc++] = (uint64_t)(int64_t)star;
+    }
+    switch (spec.kind) {
+    case ARG_INT:
+      rec->args[argc++] = (uint64_t)(int64_t)va_arg(ap, int);
+      break;
+    case ARG_LONG:
+      rec->args[argc++] = (uint64_t)va_arg(ap, long long);
+      break;
+    case ARG_DOUBLE: {
+      double value = va_arg(ap, double);
+      memcpy(&rec->args[argc++], &value, sizeof(value));
+      break;
+    }
+    case ARG_POINTER:
+      rec->args[argc++] = (uint64_t)(uintptr_t)va_arg(ap, void *);
+      break;
+    default: {  // ARG_STRING
+      const char *s = va_arg(ap, const char *);
+      if (s == NULL)
+        s = "(null)";
+      if (text_len >= LOG_TEXT_MAX) {
+        // Места нет: ссылка на завершающий ноль последней строки
+        rec->args[argc++] = LOG_TEXT_MAX - 1;
+        break;
+      }
+      size_t room = LOG_TEXT_MAX - 1 - text_len;
+      int precision = spec.star_precision ? star : spec.precision;
+      if (precision >= 0 && (size_t)precision < room)
+        room = (size_t)precision;
+      size_t len = strnlen(s, room);
+      memcpy(rec->text + text_len, s, len);
+      rec->text[text_len + len] = '\0';
+      rec->args[argc++] = text_len;
+      text_len += len + 1;
+      break;
+    }
+    }
+  }
+  rec->argc = (uint8_t)argc;
+}
+
+/**
+ * Префикс строки: время с микросекундами, уровень и номер потока
+ */
+static size_t FormatPrefix(char *line, size_t cap, uint64_t time_ns, enum LogLevel level,
+                           int thread) {
+  // Дата пересчитывается раз в секунду: localtime_r заметно дороже snprintf
+  static __thread time_t cached_sec = -1;
+  static __thread char cached_date[32];
+  time_t sec = (time_t)(time_ns / 1000000000ull);
+  if (sec != cached_sec) {
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    strftime(cached_date, sizeof(cached_date), "%Y-%m-%d %H:%M:%S", &tm);
+    cached_sec = sec;
+  }
+  int n = snprintf(line, cap, "%s.%06u %-5s [t%d] ", cached_date,
+                   (unsigned int)(time_ns % 1000000000ull / 1000), level_names[level], thread);
+  return n < 0 ? 0 : ((size_t)n < cap ? (size_t)n : cap - 1);
+}
+
+static void Append(char *line, size_t cap, size_t *len, const char *s, size_t n) {
+  if (n > cap - 1 - *len)
+    n = cap - 1 - *len;
+  memcpy(line + *len, s, n);
+  *len += n;
+  line[*len] = '\0';
+}
+
+#define FORMAT_VALUE(value)                                                            \
+  (spec.stars == 0   ? snprintf(out, room, spec.text, value)                           \
+   : spec.stars == 1 ? snprintf(out, room, spec.text, (int)star[0], value)             \
+                     : snprintf(out, room, spec.text, (int)star[0], (int)star[1], value))
+
+/**
+ * Текст записи по строке формата и сохраненным аргументам
+ */
+static size_t FormatRecord(char *line, size_t cap, size_t len, const struct LogRecord *rec) {
+  int argi = 0;
+  const char *p = rec->fmt;
+  while (*p != '\0' && len < cap - 1) {
+    if (*p != '%') {
+      const char *percent = strchr(p, '%');
+      size_t n = percent != NULL ? (size_t)(percent - p) : strlen(p);
+      Append(line, cap, &len, p, n);
+      p += n;
+      continue;
+    }
+    struct FormatSpec spec;
+    const char *next = ParseSpec(p, &spec);
+    if (spec.kind == ARG_PERCENT) {
+      Append(line, cap, &len, "%", 1);
+      p = next;
+      continue;
+    }
+    if (spec.kind == ARG_BAD || argi + spec.stars + 1 > rec->argc) {
+      Append(line, cap, &len, p, strlen(p));
+      break;
+    }
+
+    int64_t star[2] = {0, 0};
+    for (int s = 0; s < spec.stars; s++)
+      star[s] = (int64_t)rec->args[argi++];
+    uint64_t value = rec->args[argi++];
+    char *out = line + len;
+    size_t room = cap - len;
+    int n;
+    switch (spec.kind) {
+    case ARG_INT:
+      n = FORMAT_VALUE((int)(int64_t)value);
+      break;
+    case ARG_LONG:
+      n = FORMAT_VALUE((long long)value);
+      break;
+    case ARG_DOUBLE: {
+      double d;
+      memcpy(&d, &value, sizeof(d));
+      n = FORMAT_VALUE(d);
+      break;
+    }
+    case ARG_POINTER:
+      n = FORMAT_VALUE((void *)(uintptr_t)value);
+      break;
+    default:
+      n = FORMAT_VALUE(rec->text + value);
+      break;
+    }
+    if (n > 0)
+      len += (size_t)n < room ? (size_t)n : room - 1;
+    p = next;
+  }
+  return len;
+}
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int LocalThread(void) {
+  if (local_thread < 0)
+    local_thread = __atomic_fetch_add(&threads_num, 1, __ATOMIC_RELAXED);
+  return local_thread;
+}
+
+/**
+ * Буфер вызывающего потока; создается при первой записи
+ * и добавляется в общий список без блокировок
+ */
+static struct LogRing *LocalRing(void) {
+  if (local_ring != NULL)
+    return local_ring;
+  void *mem = NULL;
+  if (posix_memalign(&mem, 64, sizeof(struct LogRing)) != 0)
+    return NULL;
+  struct LogRing *ring = mem;
+  memset(ring, 0, sizeof(*ring));
+  ring->thread = LocalThread();
+  ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, true, __ATOMIC_SEQ_CST,
+                                      __ATOMIC_RELAXED)) {
+  }
+  local_ring = ring;
+  return ring;
+}
+
+void LogWrite(enum LogLevel level, const char *fmt, ...) {
+  if (!LogEnabled(level))
+    return;
+  // Выборка: из сообщений ниже WARN выводится каждое log_sample-е
+  unsigned int sample = __atomic_load_n(&log_sample, __ATOMIC_RELAXED);
+  if (level < LOG_LEVEL_WARN && sample > 1 && sample_counter++ % sample != 0)
+    return;
+
+  va_list ap;
+  va_start(ap, fmt);
+  struct LogRing *ring = NULL;
+  if (__atomic_load_n(&log_async, __ATOMIC_ACQUIRE))
+    ring = LocalRing();
+  if (ring != NULL) {
+    // Повторная проверка после объявления записи: либо LogShutdown дождется
+    // ее публикации, либо запись уйдет синхронно
+    __atomic_store_n(&ring->active, true, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&log_async, __ATOMIC_SEQ_CST)) {
+      __atomic_store_n(&ring->active, false, __ATOMIC_RELAXED);
+      ring = NULL;
+    }
+  }
+
+  if (ring == NULL) {
+    // Синхронный режим: форматирование здесь же, одна запись в поток stdio
+    char line[LOG_LINE_MAX];
+    size_t len = FormatPrefix(line, sizeof(line) - 1, NowNs(), level, LocalThread());
+    int n = vsnprintf(line + len, sizeof(line) - 1 - len, fmt, ap);
+    if (n > 0)
+      len += (size_t)n < sizeof(line) - 1 - len ? (size_t)n : sizeof(line) - 2 - len;
+    line[len++] = '\n';
+    fwrite(line, 1, len, level >= LOG_LEVEL_WARN ? stderr : stdout);
+    va_end(ap);
+    return;
+  }
+
+  size_t head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == LOG_RING_SIZE) {
+    __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->active, false, __ATOMIC_RELEASE);
+    va_end(ap);
+    return;
+  }
+  struct LogRecord *rec = &ring->records[head & (LOG_RING_SIZE - 1)];
+  rec->fmt = fmt;
+  rec->time_ns = NowNs();
+  rec->level = (uint8_t)level;
+  CaptureArgs(rec, fmt, ap);
+  va_end(ap);
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->active, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Вывод всех накопленных записей всех потоков
+ *
+ * @return количество выведенных строк
+ */
+static size_t DrainRings(void) {
+  size_t lines = 0;
+  char line[LOG_LINE_MAX];
+  for (struct LogRing *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring != NULL;
+       ring = ring->next) {
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    size_t tail = ring->tail;
+    for (; tail != head; tail++) {
+      const struct LogRecord *rec = &ring->records[tail & (LOG_RING_SIZE - 1)];
+      enum LogLevel level = (enum LogLevel)rec->level;
+      size_t len = FormatPrefix(line, sizeof(line) - 1, rec->time_ns, level, ring->thread);
+      len = FormatRecord(line, sizeof(line) - 1, len, rec);
+      line[len++] = '\n';
+      fwrite(line, 1, len, level >= LOG_LEVEL_WARN ? stderr : stdout);
+      lines++;
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+    uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    if (dropped != ring->dropped_reported) {
+      size_t len = FormatPrefix(line, sizeof(line), NowNs(), LOG_LEVEL_WARN, ring->thread);
+      fprintf(stderr, "%.*s%llu log records dropped: buffer full\n", (int)len, line,
+              (unsigned long long)(dropped - ring->dropped_reported));
+      ring->dropped_reported = dropped;
+      lines++;
+    }
+  }
+  return lines;
+}
+
+/**
+ * Фоновый поток: разбирает буферы, пока они не опустеют, затем спит LOG_IDLE_NS
+ */
+static void *WriterMain(void *args) {
+  (void)args;
+  while (true) {
+    bool stop = __atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE);
+    size_t lines = DrainRings();
+    if (lines > 0) {
+      fflush(stdout);
+      fflush(stderr);
+    }
+    if (stop)
+      break;
+    if (lines == 0) {
+      struct timespec pause = {0, LOG_IDLE_NS};
+      nanosleep(&pause, NULL);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Настройка журнала
+ *
+ * @param level - минимальный выводимый уровень
+ * @param sample - выводить каждое sample-е сообщение ниже WARN (0 и 1 - все)
+ * @param sync - форматировать в вызывающем потоке, без фонового писателя
+ * @return 0 при успехе, -1 если не удалось запустить фоновый поток
+ */
+int LogInit(enum LogLevel level, unsigned int sample, bool sync) {
+  __atomic_store_n(&log_min_level, level, __ATOMIC_RELAXED);
+  __atomic_store_n(&log_sample, sample > 1 ? sample : 1, __ATOMIC_RELAXED);
+  if (sync || level == LOG_LEVEL_OFF || __atomic_load_n(&log_async, __ATOMIC_RELAXED))
+    return 0;
+
+  __atomic_store_n(&writer_stop, false, __ATOMIC_RELAXED);
+  if (pthread_create(&writer, NULL, WriterMain, NULL) != 0)
+    return -1;
+  __atomic_store_n(&log_async, true, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * Вывод оставшихся записей и остановка фонового потока
+ * Последующие записи форматируются синхронно; начатые до этого
+ * дописываются в буферы, и фоновый поток выводит их перед выходом.
+ * Буферы потоков не освобождаются: их владельцы могут быть еще живы
+ */
+void LogShutdown(void) {
+  if (!__atomic_load_n(&log_async, __ATOMIC_RELAXED))
+    return;
+  __atomic_store_n(&log_async, false, __ATOMIC_SEQ_CST);
+  for (struct LogRing *ring = __atomic_load_n(&rings, __ATOMIC_SEQ_CST); ring != NULL;
+       ring = ring->next) {
+    while (__atomic_load_n(&ring->active, __ATOMIC_ACQUIRE))
+      sched_yield();
+  }
+  __atomic_store_n(&writer_stop, true, __ATOMIC_RELEASE);
+  pthread_join(writer, NULL);
+}
+
+bool LogParseLevel(const char *name, enum LogLevel *level) {
+  for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_OFF; i++) {
+    if (strcasecmp(name, level_names[i]) == 0) {
+      *level = (enum LogLevel)i;
+      return true;
+    }
+  }
+  return false;
+}
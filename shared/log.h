@@ -0,0 +1,63 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Асинхронный журнал
+ *
+ * Поток, пишущий в журнал, не форматирует текст и не трогает stdio:
+ * в его собственный кольцевой буфер (один писатель и один читатель, без
+ * блокировок) кладется запись с указателем на строку формата, временем
+ * и аргументами в двоичном виде. Фоновый поток забирает записи из буферов
+ * всех потоков, форматирует их и пишет в stdout (WARN и ERROR - в stderr).
+ * Если буфер потока полон, запись отбрасывается и учитывается в счетчике:
+ * горячий путь никогда не ждет вывода. Записи разных потоков могут
+ * выводиться не строго по времени.
+ *
+ * Ограничения формата:
+ *   строка формата должна жить до конца программы (литерал);
+ *   не больше LOG_MAX_ARGS аргументов (включая '*' ширины и точности);
+ *   строки %s копируются в запись, всего не больше LOG_TEXT_MAX - 1 байт,
+ *   длиннее - обрезаются; %n и long double не поддерживаются.
+ *
+ * До LogInit (и в режиме sync) записи форматируются сразу в вызывающем
+ * потоке под блокировкой stdio - так, как работал прежний printf.
+ */
+
+enum LogLevel {
+  LOG_LEVEL_DEBUG,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_ERROR,
+  LOG_LEVEL_OFF
+};
+
+#define LOG_MAX_ARGS 12
+#define LOG_TEXT_MAX 256
+#define LOG_RING_SIZE 1024  // Записей в буфере потока, степень двойки
+
+// Минимальный выводимый уровень; читается без блокировок
+extern enum LogLevel log_min_level;
+
+static inline bool LogEnabled(enum LogLevel level) {
+  return level >= __atomic_load_n(&log_min_level, __ATOMIC_RELAXED);
+}
+
+/**
+ * Запись в журнал; аргументы не вычисляются, если уровень выключен
+ */
+#define LOG(level, ...)                   \
+  do {                                    \
+    if (LogEnabled(level))                \
+      LogWrite(level, __VA_ARGS__);       \
+  } while (0)
+
+int LogInit(enum LogLevel level, unsigned int sample, bool sync);
+void LogShutdown(void);
+bool LogParseLevel(const char *name, enum LogLevel *level);
+void LogWrite(enum LogLevel level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#endif